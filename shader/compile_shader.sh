@@ -1,2 +1,8 @@
 glslc shader.vert -o vert.spv
+glslc shader_bindless.vert -o vert_bindless.spv
+glslc shader_instanced.vert -o vert_instanced.spv
 glslc shader.frag -o frag.spv
+glslc shader_textured.frag -o frag_textured.spv
+glslc cull.comp -o cull.spv
+glslc post.comp -o post.spv
+python3 pack_shaders.py shaders.spvpack vert.spv vert_bindless.spv vert_instanced.spv frag.spv frag_textured.spv cull.spv post.spv
@@ -0,0 +1,54 @@
+#!/usr/bin/env python3
+# Packs SPIR-V files into one archive that ShaderModuleCache maps with a single mmap.
+#
+# layout, all little endian:
+#   header  uint32 magic "SPVA", uint32 version, uint32 entry count, uint32 reserved
+#   index   per entry uint32 name offset, name size, code offset, code size (offsets from the start of the file)
+#   names   the file names, not terminated
+#   code    every shader 16-byte aligned
+import struct
+import sys
+from pathlib import Path
+
+MAGIC = 0x41565053
+VERSION = 1
+SPIRV_MAGIC = 0x07230203
+
+
+def align(value, alignment):
+    return (value + alignment - 1) // alignment * alignment
+
+
+def main():
+    if len(sys.argv) < 3:
+        print(f"Usage: {sys.argv[0]} <archive> <shader.spv>...", file=sys.stderr)
+        return 1
+
+    shaders = []
+    for path in map(Path, sys.argv[2:]):
+        code = path.read_bytes()
+        if len(code) % 4 != 0 or len(code) < 20 or struct.unpack_from("<I", code)[0] != SPIRV_MAGIC:
+            print(f"{path} is not little endian SPIR-V", file=sys.stderr)
+            return 1
+        shaders.append((path.name.encode(), code))
+
+    names_offset = 16 + 16 * len(shaders)
+    code_offset = align(names_offset + sum(len(name) for name, _ in shaders), 16)
+
+    index = bytearray()
+    names = bytearray()
+    blobs = bytearray()
+    for name, code in shaders:
+        index += struct.pack("<4I", names_offset + len(names), len(name), code_offset + len(blobs), len(code))
+        names += name
+        blobs += code
+        blobs += bytes(align(len(blobs), 16) - len(blobs))
+
+    header = struct.pack("<4I", MAGIC, VERSION, len(shaders), 0)
+    padding = bytes(code_offset - names_offset - len(names))
+    Path(sys.argv[1]).write_bytes(header + index + names + padding + blobs)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
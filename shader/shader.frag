@@ -5,6 +5,9 @@ layout(location = 0) in vec3 fragColor;
 
 layout(location = 0) out vec4 outColor;
 
+// set per material pipeline
+layout(constant_id = 0) const float Brightness = 1.0;
+
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    outColor = vec4(fragColor * Brightness, 1.0);
 }
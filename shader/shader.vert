@@ -1,21 +1,19 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(location = 0) out vec3 fragColor;
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+// per object, xy offset and z scale
+layout(location = 2) in vec4 inTransform;
 
-vec2 positions[3] = vec2[](
-vec2(0.0, -0.5),
-vec2(0.5, 0.5),
-vec2(-0.5, 0.5)
-);
+// FrameUniforms in src/VulkanApplication.h, bound with a dynamic offset into the frame allocator
+layout(set = 0, binding = 0) uniform FrameUniforms {
+    mat4 viewProjection;
+} frame;
 
-vec3 colors[3] = vec3[](
-vec3(1.0, 0.0, 0.0),
-vec3(0.0, 1.0, 0.0),
-vec3(0.0, 0.0, 1.0)
-);
+layout(location = 0) out vec3 fragColor;
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
+    gl_Position = frame.viewProjection * vec4(inPosition * inTransform.z + inTransform.xy, 0.0, 1.0);
+    fragColor = inColor;
 }
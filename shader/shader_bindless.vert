@@ -0,0 +1,45 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : enable
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+// std430 layout of SceneObject in src/VulkanApplication.h
+struct SceneObject {
+    vec4 sphere;
+    // xy offset and z scale
+    vec4 transform;
+};
+
+// FrameUniforms in src/VulkanApplication.h, bound with a dynamic offset into the frame allocator
+layout(set = 0, binding = 0) uniform FrameUniforms {
+    mat4 viewProjection;
+    // read by shader_textured.frag
+    uvec4 textures[4];
+    uint textureCount;
+    uint textureSampler;
+} frame;
+
+// binding 0 of the bindless table, every storage buffer of the renderer
+layout(set = 1, binding = 0) readonly buffer SceneObjects {
+    SceneObject objects[];
+} storageBuffers[];
+
+layout(push_constant) uniform PushConstants {
+    uint objectBuffer;
+} pushConstants;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragObject;
+
+void main() {
+    // draws select their object with firstInstance, which gl_InstanceIndex includes
+    vec4 transform = storageBuffers[pushConstants.objectBuffer].objects[gl_InstanceIndex].transform;
+    gl_Position = frame.viewProjection * vec4(inPosition * transform.z + transform.xy, 0.0, 1.0);
+    fragColor = inColor;
+    // the triangle spans [-0.5, 0.5], one repeat of the texture
+    fragTexCoord = inPosition + 0.5;
+    fragObject = gl_InstanceIndex;
+}
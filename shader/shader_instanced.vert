@@ -0,0 +1,20 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+// InstanceData in src/InstanceBatch.h, per instance
+layout(location = 2) in vec4 inTransform;
+layout(location = 3) in vec4 inInstanceColor;
+
+// FrameUniforms in src/VulkanApplication.h, bound with a dynamic offset into the frame allocator
+layout(set = 0, binding = 0) uniform FrameUniforms {
+    mat4 viewProjection;
+} frame;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    gl_Position = frame.viewProjection * vec4(inPosition * inTransform.z + inTransform.xy, 0.0, 1.0);
+    fragColor = inColor * inInstanceColor.rgb;
+}
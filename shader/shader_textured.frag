@@ -0,0 +1,33 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : enable
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragObject;
+
+layout(location = 0) out vec4 outColor;
+
+// FrameUniforms in src/VulkanApplication.h, the handles change as TextureStreamer swaps in other mip levels
+layout(set = 0, binding = 0) uniform FrameUniforms {
+    mat4 viewProjection;
+    // MAX_SCENE_TEXTURES handles, four to an element
+    uvec4 textures[4];
+    uint textureCount;
+    uint textureSampler;
+} frame;
+
+// bindings 1 and 2 of the bindless table
+layout(set = 1, binding = 1) uniform texture2D sampledImages[];
+layout(set = 1, binding = 2) uniform sampler samplers[];
+
+// set per material pipeline
+layout(constant_id = 0) const float Brightness = 1.0;
+
+void main() {
+    // object i samples texture i % textureCount, the table enables non-uniform indexing
+    uint slot = fragObject % frame.textureCount;
+    uint handle = frame.textures[slot / 4][slot % 4];
+    vec3 texel = texture(sampler2D(sampledImages[nonuniformEXT(handle)], samplers[frame.textureSampler]), fragTexCoord).rgb;
+    outColor = vec4(texel * fragColor * Brightness, 1.0);
+}
@@ -0,0 +1,247 @@
+#include "BindlessTable.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace {
+    constexpr VkDescriptorType BindingTypes[] = {
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+            VK_DESCRIPTOR_TYPE_SAMPLER};
+
+    const char *ResourceTypeName(const BindlessTable::ResourceType type) {
+        switch (type) {
+            case BindlessTable::ResourceType::StorageBuffer:
+                return "storage buffer";
+            case BindlessTable::ResourceType::SampledImage:
+                return "sampled image";
+            default:
+                return "sampler";
+        }
+    }
+}
+
+VkPhysicalDeviceDescriptorIndexingFeatures BindlessTable::RequiredFeatures() {
+    VkPhysicalDeviceDescriptorIndexingFeatures features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    // handles may differ between the invocations of a draw, e.g. when they come from per instance data
+    features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+    // resources are added and removed while earlier frames that do not use them are still executing
+    features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    // most of the array is never written
+    features.descriptorBindingPartiallyBound = VK_TRUE;
+    features.runtimeDescriptorArray = VK_TRUE;
+    return features;
+}
+
+bool BindlessTable::IsSupported(const VkPhysicalDeviceFeatures &supportedCore, const VkPhysicalDeviceDescriptorIndexingFeatures &supported) {
+    return supportedCore.shaderStorageBufferArrayDynamicIndexing && supportedCore.shaderSampledImageArrayDynamicIndexing &&
+           supported.shaderSampledImageArrayNonUniformIndexing && supported.shaderStorageBufferArrayNonUniformIndexing &&
+           supported.descriptorBindingSampledImageUpdateAfterBind && supported.descriptorBindingStorageBufferUpdateAfterBind &&
+           supported.descriptorBindingUpdateUnusedWhilePending && supported.descriptorBindingPartiallyBound &&
+           supported.runtimeDescriptorArray;
+}
+
+BindlessTable::BindlessTable(VkPhysicalDevice physicalDevice, VkDevice device, FrameScheduler &scheduler, const Capacity capacity)
+    : m_device(device), m_scheduler(scheduler) {
+    VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+    indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+            .pNext = &indexingProperties,
+            .properties = {}};
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+    // every binding is visible to every stage, so the per stage limits apply to the whole array
+    m_slots[static_cast<size_t>(ResourceType::StorageBuffer)].capacity = std::min({capacity.storageBuffers,
+            indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers, indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers});
+    m_slots[static_cast<size_t>(ResourceType::SampledImage)].capacity = std::min({capacity.sampledImages,
+            indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages, indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages});
+    m_slots[static_cast<size_t>(ResourceType::Sampler)].capacity = std::min({capacity.samplers,
+            indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers, indexingProperties.maxDescriptorSetUpdateAfterBindSamplers});
+
+    // the three arrays together also count against the per stage limit on all update-after-bind resources,
+    // which is lower than their sum on some devices; they shrink in proportion then
+    uint64_t total = 0;
+    for (const auto &slots : m_slots) {
+        total += slots.capacity;
+    }
+    const auto limit = indexingProperties.maxPerStageUpdateAfterBindResources;
+    if (total > limit) {
+        for (auto &slots : m_slots) {
+            slots.capacity = static_cast<uint32_t>(slots.capacity * static_cast<uint64_t>(limit) / total);
+        }
+    }
+
+    CreateDescriptors();
+}
+
+BindlessTable::~BindlessTable() {
+    vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
+}
+
+BindlessTable::Handle BindlessTable::AddStorageBuffer(VkBuffer buffer, const VkDeviceSize offset, const VkDeviceSize range) {
+    const VkDescriptorBufferInfo bufferInfo{.buffer = buffer, .offset = offset, .range = range};
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto handle = m_slots[static_cast<size_t>(ResourceType::StorageBuffer)].Allocate();
+    Write(ResourceType::StorageBuffer, handle, &bufferInfo, nullptr);
+    return handle;
+}
+
+BindlessTable::Handle BindlessTable::AddSampledImage(VkImageView imageView, const VkImageLayout layout) {
+    const VkDescriptorImageInfo imageInfo{.sampler = VK_NULL_HANDLE, .imageView = imageView, .imageLayout = layout};
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto handle = m_slots[static_cast<size_t>(ResourceType::SampledImage)].Allocate();
+    Write(ResourceType::SampledImage, handle, nullptr, &imageInfo);
+    return handle;
+}
+
+BindlessTable::Handle BindlessTable::AddSampler(VkSampler sampler) {
+    const VkDescriptorImageInfo imageInfo{.sampler = sampler, .imageView = VK_NULL_HANDLE, .imageLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto handle = m_slots[static_cast<size_t>(ResourceType::Sampler)].Allocate();
+    Write(ResourceType::Sampler, handle, nullptr, &imageInfo);
+    return handle;
+}
+
+void BindlessTable::Remove(const ResourceType type, const Handle handle) {
+    if (handle == InvalidHandle) return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_slots[static_cast<size_t>(type)].retired;
+    }
+
+    // the descriptor is left as it is, partially bound arrays allow stale elements that no shader reads
+    m_scheduler.DeferDeletion(FrameScheduler::Queue::Graphics, [this, type, handle] {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto &slots = m_slots[static_cast<size_t>(type)];
+        --slots.retired;
+        slots.free.push_back(handle);
+    });
+}
+
+void BindlessTable::Bind(VkCommandBuffer commandBuffer, const VkPipelineBindPoint bindPoint, VkPipelineLayout layout, const uint32_t firstSet) const {
+    vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, firstSet, 1, &m_descriptorSet, 0, nullptr);
+}
+
+BindlessTable::Capacity BindlessTable::GetCapacity() const {
+    return {
+            .storageBuffers = m_slots[static_cast<size_t>(ResourceType::StorageBuffer)].capacity,
+            .sampledImages = m_slots[static_cast<size_t>(ResourceType::SampledImage)].capacity,
+            .samplers = m_slots[static_cast<size_t>(ResourceType::Sampler)].capacity};
+}
+
+BindlessTable::Stats BindlessTable::GetStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return {
+            .storageBuffers = m_slots[static_cast<size_t>(ResourceType::StorageBuffer)].GetUsed(),
+            .sampledImages = m_slots[static_cast<size_t>(ResourceType::SampledImage)].GetUsed(),
+            .samplers = m_slots[static_cast<size_t>(ResourceType::Sampler)].GetUsed(),
+            .descriptorWrites = m_descriptorWrites};
+}
+
+BindlessTable::Handle BindlessTable::Slots::Allocate() {
+    if (!free.empty()) {
+        const auto handle = free.back();
+        free.pop_back();
+        return handle;
+    }
+    if (highWater < capacity) {
+        return highWater++;
+    }
+    return InvalidHandle;
+}
+
+uint32_t BindlessTable::Slots::GetUsed() const {
+    return highWater - static_cast<uint32_t>(free.size()) - retired;
+}
+
+void BindlessTable::CreateDescriptors() {
+    VkDescriptorSetLayoutBinding bindings[3];
+    VkDescriptorBindingFlags bindingFlags[3];
+    VkDescriptorPoolSize poolSizes[3];
+    for (uint32_t i = 0; i < 3; ++i) {
+        bindings[i] = {
+                .binding = i,
+                .descriptorType = BindingTypes[i],
+                .descriptorCount = m_slots[i].capacity,
+                .stageFlags = VK_SHADER_STAGE_ALL,
+                .pImmutableSamplers = nullptr};
+        bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                          VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+        poolSizes[i] = {.type = BindingTypes[i], .descriptorCount = m_slots[i].capacity};
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+            .pNext = nullptr,
+            .bindingCount = 3,
+            .pBindingFlags = bindingFlags};
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = &bindingFlagsCreateInfo,
+            .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+            .bindingCount = 3,
+            .pBindings = bindings};
+
+    if (vkCreateDescriptorSetLayout(m_device, &descriptorSetLayoutCreateInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create bindless descriptor set layout!");
+    }
+
+    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+            .maxSets = 1,
+            .poolSizeCount = 3,
+            .pPoolSizes = poolSizes};
+
+    if (vkCreateDescriptorPool(m_device, &descriptorPoolCreateInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create bindless descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .descriptorPool = m_descriptorPool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &m_descriptorSetLayout};
+
+    if (vkAllocateDescriptorSets(m_device, &descriptorSetAllocateInfo, &m_descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate bindless descriptor set!");
+    }
+}
+
+// called with m_mutex held, descriptor writes to one set have to be externally synchronized
+void BindlessTable::Write(const ResourceType type, const Handle handle, const VkDescriptorBufferInfo *bufferInfo, const VkDescriptorImageInfo *imageInfo) {
+    if (handle == InvalidHandle) {
+        throw std::runtime_error(std::string("Bindless table is out of ") + ResourceTypeName(type) + " slots!");
+    }
+
+    const auto binding = static_cast<uint32_t>(type);
+    VkWriteDescriptorSet write{
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext = nullptr,
+            .dstSet = m_descriptorSet,
+            .dstBinding = binding,
+            .dstArrayElement = handle,
+            .descriptorCount = 1,
+            .descriptorType = BindingTypes[binding],
+            .pImageInfo = imageInfo,
+            .pBufferInfo = bufferInfo,
+            .pTexelBufferView = nullptr};
+
+    vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+    ++m_descriptorWrites;
+}
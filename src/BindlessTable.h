@@ -0,0 +1,103 @@
+#ifndef VULKANLEARNING_BINDLESSTABLE_H
+#define VULKANLEARNING_BINDLESSTABLE_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "FrameScheduler.h"
+
+// One update-after-bind descriptor set holding every storage buffer, sampled image and sampler of the
+// renderer in large partially bound arrays (VK_EXT_descriptor_indexing, core in Vulkan 1.2). Resources are
+// written once when they are added, shaders index the arrays with the handle they get through a push
+// constant or a buffer, so a frame binds the set once instead of binding descriptors per draw.
+// Safe to use from any thread, except Remove(), which belongs to the render thread like the scheduler.
+class BindlessTable
+{
+public:
+	using Handle = uint32_t;
+	static constexpr Handle InvalidHandle = ~0u;
+
+	// array element of the set's three bindings, in this order
+	enum class ResourceType : uint32_t
+	{
+		StorageBuffer,
+		SampledImage,
+		Sampler
+	};
+
+	// wanted array sizes, the device limits may make them smaller
+	struct Capacity
+	{
+		uint32_t storageBuffers = 16384;
+		uint32_t sampledImages = 16384;
+		uint32_t samplers = 256;
+	};
+
+	struct Stats
+	{
+		uint32_t storageBuffers = 0;
+		uint32_t sampledImages = 0;
+		uint32_t samplers = 0;
+		// descriptors written since the table was created
+		uint64_t descriptorWrites = 0;
+	};
+
+	// the descriptor indexing features the table relies on, to be enabled in VkDeviceCreateInfo's pNext chain
+	[[nodiscard]] static VkPhysicalDeviceDescriptorIndexingFeatures RequiredFeatures();
+	// supportedCore also has to allow dynamically indexing storage buffer and sampled image arrays
+	[[nodiscard]] static bool IsSupported(const VkPhysicalDeviceFeatures& supportedCore, const VkPhysicalDeviceDescriptorIndexingFeatures& supported);
+
+	// removed slots are handed out again through scheduler's deferred deletion
+	BindlessTable(VkPhysicalDevice physicalDevice, VkDevice device, FrameScheduler& scheduler, Capacity capacity);
+	~BindlessTable();
+
+	BindlessTable(const BindlessTable&) = delete;
+	BindlessTable& operator=(const BindlessTable&) = delete;
+
+	Handle AddStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+	Handle AddSampledImage(VkImageView imageView, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	Handle AddSampler(VkSampler sampler);
+	// the slot is handed out again once everything submitted to the graphics queue so far has finished
+	void Remove(ResourceType type, Handle handle);
+
+	// binds the set at set index firstSet of layout, where layout has GetLayout()
+	void Bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t firstSet) const;
+
+	[[nodiscard]] VkDescriptorSetLayout GetLayout() const { return m_descriptorSetLayout; }
+	[[nodiscard]] VkDescriptorSet GetSet() const { return m_descriptorSet; }
+	[[nodiscard]] Capacity GetCapacity() const;
+	[[nodiscard]] Stats GetStats() const;
+
+private:
+	// free list allocator of the array elements of one binding
+	struct Slots
+	{
+		uint32_t capacity = 0;
+		// elements below it have been handed out at least once
+		uint32_t highWater = 0;
+		std::vector<Handle> free;
+		// removed, waiting for the frames that may read them
+		uint32_t retired = 0;
+
+		Handle Allocate();
+		[[nodiscard]] uint32_t GetUsed() const;
+	};
+
+	void CreateDescriptors();
+	void Write(ResourceType type, Handle handle, const VkDescriptorBufferInfo* bufferInfo, const VkDescriptorImageInfo* imageInfo);
+
+	VkDevice m_device;
+	FrameScheduler& m_scheduler;
+
+	VkDescriptorSetLayout m_descriptorSetLayout{};
+	VkDescriptorPool m_descriptorPool{};
+	VkDescriptorSet m_descriptorSet{};
+
+	mutable std::mutex m_mutex;
+	Slots m_slots[3];
+	uint64_t m_descriptorWrites = 0;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "CpuProfiler.h"
+
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+    constexpr size_t RingSize = 1 << 16;
+
+    // every field is written between two stores of sequence, an odd value marks a write in progress
+    // and 2 * (index + 1) a finished one, which lets readers skip slots that are being overwritten
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<const char *> name{nullptr};
+        std::atomic<int64_t> beginNs{0};
+        std::atomic<int64_t> endNs{0};
+        std::atomic<uint32_t> threadId{0};
+    };
+
+    std::array<Slot, RingSize> Ring;
+    std::atomic<uint64_t> WriteIndex{0};
+    std::atomic<uint32_t> NextThreadId{0};
+
+    uint32_t CurrentThreadId() {
+        thread_local const uint32_t threadId = NextThreadId.fetch_add(1, std::memory_order_relaxed);
+        return threadId;
+    }
+}
+
+void CpuProfiler::Record(const char *name, const int64_t beginNs, const int64_t endNs) {
+    const auto index = WriteIndex.fetch_add(1, std::memory_order_relaxed);
+    auto &slot = Ring[index % RingSize];
+
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.beginNs.store(beginNs, std::memory_order_relaxed);
+    slot.endNs.store(endNs, std::memory_order_relaxed);
+    slot.threadId.store(CurrentThreadId(), std::memory_order_relaxed);
+
+    slot.sequence.store(2 * (index + 1), std::memory_order_release);
+}
+
+std::chrono::steady_clock::time_point CpuProfiler::GetEpoch() {
+    static const auto epoch = std::chrono::steady_clock::now();
+    return epoch;
+}
+
+int64_t CpuProfiler::NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - GetEpoch()).count();
+}
+
+std::vector<CpuProfiler::Event> CpuProfiler::Snapshot() {
+    const auto end = WriteIndex.load(std::memory_order_acquire);
+    const auto begin = end > RingSize ? end - RingSize : 0;
+
+    std::vector<Event> events;
+    events.reserve(end - begin);
+
+    for (auto index = begin; index < end; ++index) {
+        const auto &slot = Ring[index % RingSize];
+
+        const auto sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * (index + 1)) continue;
+
+        Event event{
+                .name = slot.name.load(std::memory_order_relaxed),
+                .beginNs = slot.beginNs.load(std::memory_order_relaxed),
+                .endNs = slot.endNs.load(std::memory_order_relaxed),
+                .threadId = slot.threadId.load(std::memory_order_relaxed)};
+
+        // a writer lapping the ring while we copied would have bumped the sequence
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) continue;
+
+        events.push_back(event);
+    }
+
+    return events;
+}
+
+void CpuProfiler::WriteTraceEvents(std::ostream &out, const int pid, bool leadingComma) {
+    for (const auto &event : Snapshot()) {
+        if (leadingComma) out << ",\n";
+        leadingComma = true;
+
+        // zone names are identifiers and literals, nothing that needs escaping
+        out << "{\"name\":\"" << event.name << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":" << pid
+            << ",\"tid\":" << 100 + event.threadId
+            << ",\"ts\":" << static_cast<double>(event.beginNs) / 1e3
+            << ",\"dur\":" << static_cast<double>(event.endNs - event.beginNs) / 1e3 << "}";
+    }
+}
+
+void CpuProfiler::WriteChromeTrace(const std::string &path) {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open trace file!");
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    WriteTraceEvents(file, 1, false);
+    file << "\n]}\n";
+}
@@ -0,0 +1,72 @@
+#ifndef VULKANLEARNING_CPUPROFILER_H
+#define VULKANLEARNING_CPUPROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Scoped CPU zones recorded into a fixed size lock-free ring, the oldest zones are overwritten first.
+// Zones are only recorded when built with VULKANLEARNING_PROFILE defined, otherwise the macros below
+// expand to nothing and the ring stays empty.
+class CpuProfiler
+{
+public:
+	struct Event
+	{
+		const char* name;
+		// nanoseconds since GetEpoch()
+		int64_t beginNs;
+		int64_t endNs;
+		uint32_t threadId;
+	};
+
+	class ScopedZone
+	{
+	public:
+		explicit ScopedZone(const char* name) : m_name(name), m_beginNs(NowNs()) {}
+		~ScopedZone() { Record(m_name, m_beginNs, NowNs()); }
+
+		ScopedZone(const ScopedZone&) = delete;
+		ScopedZone& operator=(const ScopedZone&) = delete;
+
+	private:
+		const char* m_name;
+		int64_t m_beginNs;
+	};
+
+	static constexpr bool IsCompiledIn()
+	{
+#ifdef VULKANLEARNING_PROFILE
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	// name must outlive the profiler, string literals and __func__ do
+	static void Record(const char* name, int64_t beginNs, int64_t endNs);
+
+	// time origin shared with the GPU trace so that both line up
+	static std::chrono::steady_clock::time_point GetEpoch();
+	static int64_t NowNs();
+
+	// zones fully written at the time of the call, oldest first
+	static std::vector<Event> Snapshot();
+	// Chrome trace events without the surrounding object, one tid per recording thread
+	static void WriteTraceEvents(std::ostream& out, int pid, bool leadingComma);
+	static void WriteChromeTrace(const std::string& path);
+};
+
+#ifdef VULKANLEARNING_PROFILE
+#define VULKANLEARNING_PROFILE_CONCAT_INNER(a, b) a##b
+#define VULKANLEARNING_PROFILE_CONCAT(a, b) VULKANLEARNING_PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) const CpuProfiler::ScopedZone VULKANLEARNING_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+#else
+#define PROFILE_SCOPE(name) do {} while (false)
+#define PROFILE_FUNCTION() do {} while (false)
+#endif
+
+#endif
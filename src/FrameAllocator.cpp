@@ -0,0 +1,135 @@
+#include "FrameAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+FrameAllocator::FrameAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VulkanAllocator &allocator, const size_t framesInFlight,
+                               const VkDeviceSize frameSize, const VkDeviceSize bindingRange)
+    : m_device(device), m_allocator(allocator), m_frameSize(frameSize), m_bindingRange(bindingRange) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    // every allocation starts on an offset that is valid for both bindings
+    m_alignment = std::max(properties.limits.minUniformBufferOffsetAlignment, properties.limits.minStorageBufferOffsetAlignment);
+    m_bindingRange = std::min<VkDeviceSize>(m_bindingRange, properties.limits.maxUniformBufferRange);
+    m_frameSize = (m_frameSize + m_alignment - 1) / m_alignment * m_alignment;
+
+    // a dynamic offset plus the binding range must stay inside the buffer, hence the tail after the last region
+    m_buffer = m_allocator.CreateBuffer(m_frameSize * framesInFlight + m_bindingRange,
+                                        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                        MemoryUsage::CpuToGpu, m_allocation);
+
+    CreateDescriptors();
+}
+
+FrameAllocator::~FrameAllocator() {
+    vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
+    m_allocator.DestroyBuffer(m_buffer, m_allocation);
+}
+
+void FrameAllocator::BeginFrame(const size_t frame) {
+    m_peakBytes = std::max(m_peakBytes, std::min(m_head.load() - m_frameBegin, m_frameSize));
+
+    m_frameBegin = m_frameSize * frame;
+    m_head = m_frameBegin;
+}
+
+FrameAllocator::Allocation FrameAllocator::Allocate(const VkDeviceSize size) {
+    if (size > m_bindingRange) {
+        throw std::runtime_error("Frame allocation is larger than the binding range!");
+    }
+
+    // sizes are rounded up so that the head always stays aligned and a single fetch_add is enough
+    const auto alignedSize = (size + m_alignment - 1) / m_alignment * m_alignment;
+    const auto offset = m_head.fetch_add(alignedSize);
+    if (offset + alignedSize > m_frameBegin + m_frameSize) {
+        throw std::runtime_error("Frame allocator is out of memory!");
+    }
+
+    ++m_allocations;
+    return {
+            .data = static_cast<char *>(m_allocation.mapped) + offset,
+            .offset = static_cast<uint32_t>(offset)};
+}
+
+FrameAllocator::Stats FrameAllocator::GetStats() const {
+    return {
+            .frameSize = m_frameSize,
+            .peakBytes = std::max(m_peakBytes, std::min(m_head.load() - m_frameBegin, m_frameSize)),
+            .allocations = m_allocations.load()};
+}
+
+void FrameAllocator::CreateDescriptors() {
+    VkDescriptorSetLayoutBinding bindings[] = {
+            {
+                    .binding = 0,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                    .descriptorCount = 1,
+                    .stageFlags = VK_SHADER_STAGE_ALL,
+                    .pImmutableSamplers = nullptr},
+            {
+                    .binding = 1,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+                    .descriptorCount = 1,
+                    .stageFlags = VK_SHADER_STAGE_ALL,
+                    .pImmutableSamplers = nullptr}};
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .bindingCount = 2,
+            .pBindings = bindings};
+
+    if (vkCreateDescriptorSetLayout(m_device, &descriptorSetLayoutCreateInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create frame descriptor set layout!");
+    }
+
+    VkDescriptorPoolSize poolSizes[] = {
+            {.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, .descriptorCount = 1},
+            {.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, .descriptorCount = 1}};
+
+    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .maxSets = 1,
+            .poolSizeCount = 2,
+            .pPoolSizes = poolSizes};
+
+    if (vkCreateDescriptorPool(m_device, &descriptorPoolCreateInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create frame descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .descriptorPool = m_descriptorPool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &m_descriptorSetLayout};
+
+    if (vkAllocateDescriptorSets(m_device, &descriptorSetAllocateInfo, &m_descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate frame descriptor set!");
+    }
+
+    // written once, every frame and allocation only changes the dynamic offsets
+    VkDescriptorBufferInfo bufferInfo{.buffer = m_buffer, .offset = 0, .range = m_bindingRange};
+
+    VkWriteDescriptorSet writes[2];
+    for (uint32_t binding = 0; binding < 2; ++binding) {
+        writes[binding] = {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext = nullptr,
+                .dstSet = m_descriptorSet,
+                .dstBinding = binding,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = bindings[binding].descriptorType,
+                .pImageInfo = nullptr,
+                .pBufferInfo = &bufferInfo,
+                .pTexelBufferView = nullptr};
+    }
+
+    vkUpdateDescriptorSets(m_device, 2, writes, 0, nullptr);
+}
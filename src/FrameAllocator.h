@@ -0,0 +1,81 @@
+#ifndef VULKANLEARNING_FRAMEALLOCATOR_H
+#define VULKANLEARNING_FRAMEALLOCATOR_H
+
+#include "VulkanAllocator.h"
+
+#include <atomic>
+#include <cstring>
+
+// Linear allocator for uniform and storage data that only lives for one frame. One persistently mapped buffer
+// is split into a region per frame in flight; allocating is an atomic bump of the region's head, and the region
+// is reset as a whole once the frame that last used it has completed, so nothing is allocated,
+// mapped or written to a descriptor per frame. The descriptor set binds the buffer as a dynamic uniform buffer
+// (binding 0) and a dynamic storage buffer (binding 1), an allocation is selected by its dynamic offset.
+class FrameAllocator
+{
+public:
+	struct Allocation
+	{
+		void* data = nullptr;
+		// dynamic offset of the set's binding that reads the allocation
+		uint32_t offset = 0;
+	};
+
+	struct Stats
+	{
+		VkDeviceSize frameSize = 0;
+		// most bytes a single frame used
+		VkDeviceSize peakBytes = 0;
+		uint64_t allocations = 0;
+	};
+
+	// bindingRange is the window a shader sees from an allocation's offset, so no allocation may be larger
+	FrameAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VulkanAllocator& allocator, size_t framesInFlight,
+	               VkDeviceSize frameSize, VkDeviceSize bindingRange);
+	~FrameAllocator();
+
+	FrameAllocator(const FrameAllocator&) = delete;
+	FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+	// the caller has waited for the frame that used this region before
+	void BeginFrame(size_t frame);
+	// safe to call from the recording threads, throws when the frame's region is used up
+	Allocation Allocate(VkDeviceSize size);
+
+	template<typename T>
+	Allocation Push(const T& value)
+	{
+		const auto allocation = Allocate(sizeof(T));
+		std::memcpy(allocation.data, &value, sizeof(T));
+		return allocation;
+	}
+
+	[[nodiscard]] VkDescriptorSetLayout GetLayout() const { return m_descriptorSetLayout; }
+	[[nodiscard]] VkDescriptorSet GetSet() const { return m_descriptorSet; }
+	[[nodiscard]] VkDeviceSize GetAlignment() const { return m_alignment; }
+	[[nodiscard]] Stats GetStats() const;
+
+private:
+	void CreateDescriptors();
+
+	VkDevice m_device;
+	VulkanAllocator& m_allocator;
+
+	VkBuffer m_buffer{};
+	VulkanAllocation m_allocation;
+	VkDeviceSize m_frameSize;
+	VkDeviceSize m_bindingRange;
+	VkDeviceSize m_alignment = 1;
+
+	VkDescriptorSetLayout m_descriptorSetLayout{};
+	VkDescriptorPool m_descriptorPool{};
+	VkDescriptorSet m_descriptorSet{};
+
+	// buffer offsets of the current frame's region
+	VkDeviceSize m_frameBegin = 0;
+	std::atomic<VkDeviceSize> m_head{0};
+	std::atomic<uint64_t> m_allocations{0};
+	VkDeviceSize m_peakBytes = 0;
+};
+
+#endif
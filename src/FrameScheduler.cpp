@@ -0,0 +1,185 @@
+#include "FrameScheduler.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+FrameScheduler::FrameScheduler(VkDevice device, const bool core, const size_t framesInFlight)
+    : m_device(device), m_frameValues(framesInFlight) {
+    if (framesInFlight == 0 || framesInFlight > MaxFramesInFlight) {
+        throw std::runtime_error("Failed to create frame scheduler, frames in flight out of range!");
+    }
+    m_getSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+            vkGetDeviceProcAddr(m_device, core ? "vkGetSemaphoreCounterValue" : "vkGetSemaphoreCounterValueKHR"));
+    m_waitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(
+            vkGetDeviceProcAddr(m_device, core ? "vkWaitSemaphores" : "vkWaitSemaphoresKHR"));
+    if (m_getSemaphoreCounterValue == nullptr || m_waitSemaphores == nullptr) {
+        throw std::runtime_error("Failed to load the timeline semaphore functions!");
+    }
+
+    VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .pNext = nullptr,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0};
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &semaphoreTypeCreateInfo,
+            .flags = 0};
+
+    for (auto &timeline : m_timelines) {
+        if (vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &timeline.semaphore) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create timeline semaphore!");
+        }
+    }
+}
+
+FrameScheduler::~FrameScheduler() {
+    CollectDeletions(true);
+
+    for (const auto &timeline : m_timelines) {
+        vkDestroySemaphore(m_device, timeline.semaphore, nullptr);
+    }
+}
+
+uint64_t FrameScheduler::Submit(const Queue queue, VkQueue vkQueue, const Submission &submission) {
+    auto &timeline = m_timelines[static_cast<size_t>(queue)];
+    const auto value = timeline.submitted + 1;
+
+    // binary semaphores first, their values are ignored
+    auto waitSemaphores = submission.binaryWaitSemaphores;
+    auto waitStages = submission.binaryWaitStages;
+    std::vector<uint64_t> waitValues(waitSemaphores.size(), 0);
+    for (const auto &wait : submission.timelineWaits) {
+        // nothing to wait for on a timeline that has not been signaled, or on the queue's own earlier work
+        if (wait.value == 0 || wait.queue == queue) continue;
+
+        waitSemaphores.push_back(m_timelines[static_cast<size_t>(wait.queue)].semaphore);
+        waitStages.push_back(wait.stageMask);
+        waitValues.push_back(wait.value);
+    }
+
+    auto signalSemaphores = submission.binarySignalSemaphores;
+    std::vector<uint64_t> signalValues(signalSemaphores.size(), 0);
+    signalSemaphores.push_back(timeline.semaphore);
+    signalValues.push_back(value);
+
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .pNext = nullptr,
+            .waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size()),
+            .pWaitSemaphoreValues = waitValues.data(),
+            .signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size()),
+            .pSignalSemaphoreValues = signalValues.data()};
+
+    VkSubmitInfo submitInfo{
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = &timelineSubmitInfo,
+            .waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size()),
+            .pWaitSemaphores = waitSemaphores.data(),
+            .pWaitDstStageMask = waitStages.data(),
+            .commandBufferCount = static_cast<uint32_t>(submission.commandBuffers.size()),
+            .pCommandBuffers = submission.commandBuffers.data(),
+            .signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size()),
+            .pSignalSemaphores = signalSemaphores.data()};
+
+    if (vkQueueSubmit(vkQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to submit to the queue!");
+    }
+
+    timeline.submitted = value;
+    return value;
+}
+
+uint64_t FrameScheduler::GetSubmittedValue(const Queue queue) const {
+    return m_timelines[static_cast<size_t>(queue)].submitted;
+}
+
+uint64_t FrameScheduler::GetCompletedValue(const Queue queue) const {
+    const auto &timeline = m_timelines[static_cast<size_t>(queue)];
+
+    uint64_t value = 0;
+    if (m_getSemaphoreCounterValue(m_device, timeline.semaphore, &value) == VK_SUCCESS) {
+        timeline.completed = std::max(timeline.completed, value);
+    }
+    return timeline.completed;
+}
+
+bool FrameScheduler::IsComplete(const Queue queue, const uint64_t value) const {
+    // the cached value answers most questions without asking the driver
+    return value <= m_timelines[static_cast<size_t>(queue)].completed || value <= GetCompletedValue(queue);
+}
+
+void FrameScheduler::Wait(const Queue queue, const uint64_t value) const {
+    if (IsComplete(queue, value)) return;
+
+    const auto &timeline = m_timelines[static_cast<size_t>(queue)];
+
+    VkSemaphoreWaitInfo waitInfo{
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .semaphoreCount = 1,
+            .pSemaphores = &timeline.semaphore,
+            .pValues = &value};
+
+    if (m_waitSemaphores(m_device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to wait for timeline semaphore!");
+    }
+    timeline.completed = std::max(timeline.completed, value);
+}
+
+void FrameScheduler::BeginFrame(const size_t slot) {
+    if (!IsFrameComplete(slot)) {
+        ++m_blockedFrames;
+        for (size_t queue = 0; queue < m_timelines.size(); ++queue) {
+            Wait(static_cast<Queue>(queue), m_frameValues[slot][queue]);
+        }
+    }
+
+    CollectDeletions(false);
+}
+
+uint64_t FrameScheduler::SubmitFrame(const size_t slot, const Queue queue, VkQueue vkQueue, const Submission &submission) {
+    const auto value = Submit(queue, vkQueue, submission);
+    m_frameValues[slot][static_cast<size_t>(queue)] = value;
+    if (queue == Queue::Graphics) {
+        ++m_frames;
+    }
+    return value;
+}
+
+bool FrameScheduler::IsFrameComplete(const size_t slot) const {
+    for (size_t queue = 0; queue < m_timelines.size(); ++queue) {
+        if (!IsComplete(static_cast<Queue>(queue), m_frameValues[slot][queue])) return false;
+    }
+    return true;
+}
+
+void FrameScheduler::DeferDeletion(const Queue queue, std::function<void()> deletion) {
+    m_deletions.push_back({.queue = queue, .value = GetSubmittedValue(queue), .deletion = std::move(deletion)});
+}
+
+void FrameScheduler::CollectDeletions(const bool all) {
+    // a deletion may defer further ones, so the list is not iterated while they run
+    std::vector<Deletion> ready;
+    const auto due = std::stable_partition(m_deletions.begin(), m_deletions.end(), [this, all](const Deletion &deletion) {
+        return !all && !IsComplete(deletion.queue, deletion.value);
+    });
+    std::move(due, m_deletions.end(), std::back_inserter(ready));
+    m_deletions.erase(due, m_deletions.end());
+
+    for (auto &deletion : ready) {
+        deletion.deletion();
+    }
+    m_deletionCount += ready.size();
+}
+
+FrameScheduler::Stats FrameScheduler::GetStats() const {
+    return {
+            .frames = m_frames,
+            .blockedFrames = m_blockedFrames,
+            .deletions = m_deletionCount,
+            .pendingDeletions = m_deletions.size()};
+}
@@ -0,0 +1,115 @@
+#ifndef VULKANLEARNING_FRAMESCHEDULER_H
+#define VULKANLEARNING_FRAMESCHEDULER_H
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Orders the work of the renderer with one timeline semaphore per queue (Vulkan 1.2 or VK_KHR_timeline_semaphore).
+// Every submission to a queue signals the next value of its timeline, so a single value says whether a frame, an
+// upload or anything submitted before it has finished. Frame slots, cross-queue waits and deferred deletion all
+// key off these values, nothing has to be reset between uses the way fences and binary semaphores have to be.
+// Only swap chain acquire and present still take binary semaphores, which Submission passes through.
+// Used from the render thread only.
+class FrameScheduler
+{
+public:
+	enum class Queue : uint32_t
+	{
+		Graphics,
+		Transfer,
+		Compute,
+		Count
+	};
+
+	struct TimelineWait
+	{
+		Queue queue;
+		uint64_t value;
+		VkPipelineStageFlags stageMask;
+	};
+
+	struct Submission
+	{
+		std::vector<VkCommandBuffer> commandBuffers;
+		std::vector<TimelineWait> timelineWaits;
+		std::vector<VkSemaphore> binaryWaitSemaphores;
+		std::vector<VkPipelineStageFlags> binaryWaitStages;
+		std::vector<VkSemaphore> binarySignalSemaphores;
+	};
+
+	struct Stats
+	{
+		uint64_t frames = 0;
+		// frames whose slot was still busy on the GPU when the CPU got to it
+		uint64_t blockedFrames = 0;
+		uint64_t deletions = 0;
+		size_t pendingDeletions = 0;
+	};
+
+	// more slots only add latency and memory, the CPU is never that far ahead of the GPU
+	static constexpr size_t MaxFramesInFlight = 8;
+
+	// core selects the Vulkan 1.2 entry points over the extension's
+	FrameScheduler(VkDevice device, bool core, size_t framesInFlight);
+	// runs the deletions that are left, the device has to be idle
+	~FrameScheduler();
+
+	FrameScheduler(const FrameScheduler&) = delete;
+	FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+	// signals the next value of queue's timeline after the submission's work and returns it
+	uint64_t Submit(Queue queue, VkQueue vkQueue, const Submission& submission);
+
+	[[nodiscard]] uint64_t GetSubmittedValue(Queue queue) const;
+	[[nodiscard]] uint64_t GetCompletedValue(Queue queue) const;
+	[[nodiscard]] bool IsComplete(Queue queue, uint64_t value) const;
+	void Wait(Queue queue, uint64_t value) const;
+
+	// blocks until the frame that last used slot has finished on every queue, then runs the deletions that became safe
+	void BeginFrame(size_t slot);
+	// submits work of the frame of slot, a frame may submit to several queues and is counted by its graphics submission
+	uint64_t SubmitFrame(size_t slot, Queue queue, VkQueue vkQueue, const Submission& submission);
+	[[nodiscard]] bool IsFrameComplete(size_t slot) const;
+
+	// runs deletion once everything submitted to queue so far has finished
+	void DeferDeletion(Queue queue, std::function<void()> deletion);
+	// all runs every deletion without looking at the timelines, for an idle device
+	void CollectDeletions(bool all);
+
+	[[nodiscard]] Stats GetStats() const;
+
+private:
+	struct Timeline
+	{
+		VkSemaphore semaphore = VK_NULL_HANDLE;
+		uint64_t submitted = 0;
+		// cache of the last counter value read, only ever grows
+		mutable uint64_t completed = 0;
+	};
+
+	struct Deletion
+	{
+		Queue queue;
+		uint64_t value;
+		std::function<void()> deletion;
+	};
+
+	VkDevice m_device;
+	PFN_vkGetSemaphoreCounterValueKHR m_getSemaphoreCounterValue = nullptr;
+	PFN_vkWaitSemaphoresKHR m_waitSemaphores = nullptr;
+
+	std::array<Timeline, static_cast<size_t>(Queue::Count)> m_timelines;
+	// per queue timeline value of the last frame submitted from each slot
+	std::vector<std::array<uint64_t, static_cast<size_t>(Queue::Count)>> m_frameValues;
+	// in the order they were deferred, so the values of one queue are ascending
+	std::vector<Deletion> m_deletions;
+
+	uint64_t m_frames = 0;
+	uint64_t m_blockedFrames = 0;
+	uint64_t m_deletionCount = 0;
+};
+
+#endif
@@ -0,0 +1,250 @@
+#include "GpuCulling.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "../tools/LoadShader.h"
+
+namespace {
+    constexpr uint32_t CullWorkgroupSize = 64;
+
+    // matches the push constant block in shader/cull.comp
+    struct CullPushConstants
+    {
+        float planes[6][4];
+        uint32_t objectCount;
+        uint32_t indexCount;
+        uint32_t compact;
+    };
+}
+
+GpuCulling::GpuCulling(VkDevice device, VulkanAllocator &allocator, ShaderModuleCache &shaderModules, VkPipelineCache pipelineCache,
+                       VkBuffer objectBuffer, const uint32_t objectCount, const uint32_t indexCount, const size_t framesInFlight, const DrawSupport drawSupport)
+    : m_device(device), m_allocator(allocator), m_objectCount(objectCount), m_indexCount(indexCount), m_drawSupport(drawSupport) {
+    // every frame in flight gets its own output so that culling the next frame never overwrites draws still being read
+    m_frames.resize(framesInFlight);
+    for (auto &frame : m_frames) {
+        frame.drawBuffer = m_allocator.CreateBuffer(sizeof(VkDrawIndexedIndirectCommand) * std::max(m_objectCount, 1u),
+                                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                                    MemoryUsage::GpuOnly, frame.drawAllocation);
+        frame.countBuffer = m_allocator.CreateBuffer(sizeof(uint32_t),
+                                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                     MemoryUsage::GpuOnly, frame.countAllocation);
+    }
+
+    CreateDescriptors(objectBuffer);
+    CreatePipeline(shaderModules, pipelineCache);
+}
+
+GpuCulling::~GpuCulling() {
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
+
+    for (auto &frame : m_frames) {
+        m_allocator.DestroyBuffer(frame.countBuffer, frame.countAllocation);
+        m_allocator.DestroyBuffer(frame.drawBuffer, frame.drawAllocation);
+    }
+}
+
+void GpuCulling::RecordCulling(VkCommandBuffer commandBuffer, const size_t frame, const float (&planes)[6][4]) const {
+    const auto &buffers = m_frames[frame];
+
+    if (IsCompacting()) {
+        vkCmdFillBuffer(commandBuffer, buffers.countBuffer, 0, sizeof(uint32_t), 0);
+
+        VkBufferMemoryBarrier countResetBarrier{
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                .pNext = nullptr,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .buffer = buffers.countBuffer,
+                .offset = 0,
+                .size = VK_WHOLE_SIZE};
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                             0, nullptr, 1, &countResetBarrier, 0, nullptr);
+    }
+
+    CullPushConstants pushConstants{
+            .planes = {},
+            .objectCount = m_objectCount,
+            .indexCount = m_indexCount,
+            .compact = IsCompacting() ? 1u : 0u};
+    std::copy(&planes[0][0], &planes[0][0] + 6 * 4, &pushConstants.planes[0][0]);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &buffers.descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, (m_objectCount + CullWorkgroupSize - 1) / CullWorkgroupSize, 1, 1);
+
+    VkBufferMemoryBarrier indirectBarriers[] = {
+            {
+                    .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                    .pNext = nullptr,
+                    .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                    .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .buffer = buffers.drawBuffer,
+                    .offset = 0,
+                    .size = VK_WHOLE_SIZE},
+            {
+                    .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                    .pNext = nullptr,
+                    .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                    .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .buffer = buffers.countBuffer,
+                    .offset = 0,
+                    .size = VK_WHOLE_SIZE}};
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0,
+                         0, nullptr, IsCompacting() ? 2 : 1, indirectBarriers, 0, nullptr);
+}
+
+void GpuCulling::RecordDraws(VkCommandBuffer commandBuffer, const size_t frame) const {
+    const auto &buffers = m_frames[frame];
+    constexpr auto stride = static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand));
+
+    if (IsCompacting()) {
+        m_drawSupport.drawIndexedIndirectCount(commandBuffer, buffers.drawBuffer, 0, buffers.countBuffer, 0, m_objectCount, stride);
+        return;
+    }
+
+    // without a GPU written count every object keeps its slot and culled ones have an instance count of zero
+    const auto maxBatch = m_drawSupport.multiDrawIndirect ? std::max(m_drawSupport.maxDrawIndirectCount, 1u) : 1u;
+    for (uint32_t first = 0; first < m_objectCount; first += maxBatch) {
+        const auto count = std::min(maxBatch, m_objectCount - first);
+        vkCmdDrawIndexedIndirect(commandBuffer, buffers.drawBuffer, static_cast<VkDeviceSize>(first) * stride, count, stride);
+    }
+}
+
+void GpuCulling::CreateDescriptors(VkBuffer objectBuffer) {
+    VkDescriptorSetLayoutBinding bindings[3];
+    for (uint32_t i = 0; i < 3; ++i) {
+        bindings[i] = {
+                .binding = i,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = nullptr};
+    }
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .bindingCount = 3,
+            .pBindings = bindings};
+
+    if (vkCreateDescriptorSetLayout(m_device, &descriptorSetLayoutCreateInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create culling descriptor set layout!");
+    }
+
+    const auto frameCount = static_cast<uint32_t>(m_frames.size());
+
+    VkDescriptorPoolSize poolSize{
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 3 * frameCount};
+
+    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .maxSets = frameCount,
+            .poolSizeCount = 1,
+            .pPoolSizes = &poolSize};
+
+    if (vkCreateDescriptorPool(m_device, &descriptorPoolCreateInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create culling descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> setLayouts(frameCount, m_descriptorSetLayout);
+    std::vector<VkDescriptorSet> descriptorSets(frameCount);
+
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .descriptorPool = m_descriptorPool,
+            .descriptorSetCount = frameCount,
+            .pSetLayouts = setLayouts.data()};
+
+    if (vkAllocateDescriptorSets(m_device, &descriptorSetAllocateInfo, descriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate culling descriptor sets!");
+    }
+
+    for (size_t i = 0; i < m_frames.size(); ++i) {
+        auto &frame = m_frames[i];
+        frame.descriptorSet = descriptorSets[i];
+
+        VkDescriptorBufferInfo bufferInfos[] = {
+                {.buffer = objectBuffer, .offset = 0, .range = VK_WHOLE_SIZE},
+                {.buffer = frame.drawBuffer, .offset = 0, .range = VK_WHOLE_SIZE},
+                {.buffer = frame.countBuffer, .offset = 0, .range = VK_WHOLE_SIZE}};
+
+        VkWriteDescriptorSet writes[3];
+        for (uint32_t binding = 0; binding < 3; ++binding) {
+            writes[binding] = {
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .pNext = nullptr,
+                    .dstSet = frame.descriptorSet,
+                    .dstBinding = binding,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .pImageInfo = nullptr,
+                    .pBufferInfo = &bufferInfos[binding],
+                    .pTexelBufferView = nullptr};
+        }
+
+        vkUpdateDescriptorSets(m_device, 3, writes, 0, nullptr);
+    }
+}
+
+void GpuCulling::CreatePipeline(ShaderModuleCache &shaderModules, VkPipelineCache pipelineCache) {
+    VkPushConstantRange pushConstantRange{
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(CullPushConstants)};
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .setLayoutCount = 1,
+            .pSetLayouts = &m_descriptorSetLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange};
+
+    if (vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create culling pipeline layout!");
+    }
+
+    const auto shaderModule = shaderModules.Load("cull.spv");
+
+    VkComputePipelineCreateInfo computePipelineCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .stage = {
+                    .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .pNext = nullptr,
+                    .flags = 0,
+                    .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .module = shaderModule,
+                    .pName = "main",
+                    .pSpecializationInfo = nullptr},
+            .layout = m_pipelineLayout,
+            .basePipelineHandle = VK_NULL_HANDLE,
+            .basePipelineIndex = -1};
+
+    if (vkCreateComputePipelines(m_device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &m_pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create culling pipeline!");
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef VULKANLEARNING_GPUCULLING_H
+#define VULKANLEARNING_GPUCULLING_H
+
+#include "VulkanAllocator.h"
+#include "ShaderModuleCache.h"
+
+#include <vector>
+
+// GPU-driven draw submission: a compute pass tests every object's bounding sphere against the frustum
+// and writes the surviving draws into an indirect buffer, so the CPU records the same few commands
+// however many objects the scene has.
+class GpuCulling
+{
+public:
+	struct DrawSupport
+	{
+		// vkCmdDrawIndexedIndirectCount(KHR), nullptr without VK_KHR_draw_indirect_count
+		PFN_vkCmdDrawIndexedIndirectCountKHR drawIndexedIndirectCount = nullptr;
+		bool multiDrawIndirect = false;
+		uint32_t maxDrawIndirectCount = 1;
+	};
+
+	// objectBuffer holds objectCount SceneObjects, every object is drawn as indexCount indices
+	// with firstInstance set to its index
+	GpuCulling(VkDevice device, VulkanAllocator& allocator, ShaderModuleCache& shaderModules, VkPipelineCache pipelineCache,
+	           VkBuffer objectBuffer, uint32_t objectCount, uint32_t indexCount, size_t framesInFlight, DrawSupport drawSupport);
+	~GpuCulling();
+
+	GpuCulling(const GpuCulling&) = delete;
+	GpuCulling& operator=(const GpuCulling&) = delete;
+
+	// recorded outside of a render pass, planes are normalized (a, b, c, d) with a*x + b*y + c*z + d >= 0 inside
+	void RecordCulling(VkCommandBuffer commandBuffer, size_t frame, const float (&planes)[6][4]) const;
+	void RecordDraws(VkCommandBuffer commandBuffer, size_t frame) const;
+
+	[[nodiscard]] bool IsCompacting() const { return m_drawSupport.drawIndexedIndirectCount != nullptr; }
+
+private:
+	struct FrameBuffers
+	{
+		VkBuffer drawBuffer{};
+		VulkanAllocation drawAllocation;
+		VkBuffer countBuffer{};
+		VulkanAllocation countAllocation;
+		VkDescriptorSet descriptorSet{};
+	};
+
+	void CreateDescriptors(VkBuffer objectBuffer);
+	void CreatePipeline(ShaderModuleCache& shaderModules, VkPipelineCache pipelineCache);
+
+	VkDevice m_device;
+	VulkanAllocator& m_allocator;
+	uint32_t m_objectCount;
+	uint32_t m_indexCount;
+	DrawSupport m_drawSupport;
+
+	VkDescriptorSetLayout m_descriptorSetLayout{};
+	VkDescriptorPool m_descriptorPool{};
+	VkPipelineLayout m_pipelineLayout{};
+	VkPipeline m_pipeline{};
+
+	std::vector<FrameBuffers> m_frames;
+};
+
+#endif
@@ -0,0 +1,319 @@
+#include "GpuProfiler.h"
+
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+    constexpr uint32_t MaxPassesPerFrame = 16;
+    // rolling window the min/avg/p99 numbers are computed over
+    constexpr size_t HistorySize = 512;
+    // keeps a long run from growing the trace without bound
+    constexpr size_t MaxTraceEvents = 1 << 20;
+    constexpr uint32_t NoQuery = UINT32_MAX;
+
+    constexpr VkQueryPipelineStatisticFlags StatisticFlags =
+            VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+    void WriteJsonString(std::ostream &out, const std::string &value) {
+        out << '"';
+        for (const auto c : value) {
+            if (c == '"' || c == '\\') out << '\\';
+            out << c;
+        }
+        out << '"';
+    }
+}
+
+GpuProfiler::GpuProfiler(VkPhysicalDevice physicalDevice, VkDevice device, const uint32_t queueFamilyIndex, const size_t framesInFlight,
+                         const bool statistics, const bool inheritedQueries)
+    : m_device(device), m_inheritedQueries(inheritedQueries), m_frames(framesInFlight), m_startTime(CpuProfiler::GetEpoch()) {
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+    const auto validBits = queueFamilies[queueFamilyIndex].timestampValidBits;
+    if (validBits == 0) {
+        std::cerr << "Queue family does not support timestamps, GPU profiling is disabled" << std::endl;
+        return;
+    }
+    m_timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    m_timestampPeriodNs = properties.limits.timestampPeriod;
+
+    const auto frameCount = static_cast<uint32_t>(framesInFlight);
+
+    VkQueryPoolCreateInfo createInfo{
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = frameCount * MaxPassesPerFrame * 2,
+            .pipelineStatistics = 0};
+
+    if (vkCreateQueryPool(m_device, &createInfo, nullptr, &m_timestampPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create timestamp query pool!");
+    }
+
+    if (statistics) {
+        createInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        createInfo.queryCount = frameCount * MaxPassesPerFrame;
+        createInfo.pipelineStatistics = StatisticFlags;
+
+        if (vkCreateQueryPool(m_device, &createInfo, nullptr, &m_statisticsPool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipeline statistics query pool!");
+        }
+        m_statisticFlags = StatisticFlags;
+    }
+}
+
+GpuProfiler::~GpuProfiler() {
+    vkDestroyQueryPool(m_device, m_statisticsPool, nullptr);
+    vkDestroyQueryPool(m_device, m_timestampPool, nullptr);
+}
+
+void GpuProfiler::CollectFrame(const size_t frame) {
+    auto &slot = m_frames[frame];
+    if (!IsEnabled() || !slot.submitted) return;
+    slot.submitted = false;
+
+    const auto firstTimestamp = static_cast<uint32_t>(frame) * MaxPassesPerFrame * 2;
+    const auto timestampCount = static_cast<uint32_t>(slot.passes.size()) * 2;
+
+    // value and availability pairs, nothing waits so a frame that is somehow not finished is just skipped
+    std::vector<uint64_t> timestamps(timestampCount * 2);
+    const auto result = vkGetQueryPoolResults(m_device, m_timestampPool, firstTimestamp, timestampCount,
+                                              timestamps.size() * sizeof(uint64_t), timestamps.data(), 2 * sizeof(uint64_t),
+                                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VK_SUCCESS) return;
+
+    const auto statisticCount = GetStatisticNames().size();
+    std::vector<uint64_t> statistics;
+    if (slot.statisticsQueryCount > 0) {
+        statistics.resize(slot.statisticsQueryCount * (statisticCount + 1));
+        const auto statisticsResult = vkGetQueryPoolResults(m_device, m_statisticsPool, static_cast<uint32_t>(frame) * MaxPassesPerFrame,
+                                                            slot.statisticsQueryCount, statistics.size() * sizeof(uint64_t), statistics.data(),
+                                                            (statisticCount + 1) * sizeof(uint64_t),
+                                                            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (statisticsResult != VK_SUCCESS) statistics.clear();
+    }
+
+    const auto timestampAt = [&timestamps](uint32_t query) { return timestamps[query * 2]; };
+    const auto timestampAvailable = [&timestamps](uint32_t query) { return timestamps[query * 2 + 1] != 0; };
+
+    for (const auto &pass : slot.passes) {
+        const auto begin = pass.timestampQuery - firstTimestamp;
+        if (!timestampAvailable(begin) || !timestampAvailable(begin + 1)) continue;
+
+        const auto ticks = (timestampAt(begin + 1) - timestampAt(begin)) & m_timestampMask;
+        const auto durationMs = static_cast<double>(ticks) * m_timestampPeriodNs / 1e6;
+
+        auto &history = FindHistory(pass.name);
+        history.samples.push_back(durationMs);
+        if (history.samples.size() > HistorySize) {
+            history.samples.pop_front();
+        }
+
+        if (pass.statisticsQuery != NoQuery && !statistics.empty()) {
+            const auto base = (pass.statisticsQuery - static_cast<uint32_t>(frame) * MaxPassesPerFrame) * (statisticCount + 1);
+            if (statistics[base + statisticCount] != 0) {
+                history.statisticsTotal.resize(statisticCount, 0.0);
+                for (size_t i = 0; i < statisticCount; ++i) {
+                    history.statisticsTotal[i] += static_cast<double>(statistics[base + i]);
+                }
+                ++history.statisticsFrames;
+            }
+        }
+
+        const auto beginUs = static_cast<double>(timestampAt(begin)) * m_timestampPeriodNs / 1e3;
+        if (!m_hasClockOffset) {
+            m_gpuToCpuOffsetUs = ToMicroseconds(slot.submitTime) - beginUs;
+            m_hasClockOffset = true;
+        }
+        AddTraceEvent(pass.name, beginUs + m_gpuToCpuOffsetUs, durationMs * 1e3, true);
+    }
+}
+
+void GpuProfiler::BeginFrame(VkCommandBuffer commandBuffer, const size_t frame) {
+    if (!IsEnabled()) return;
+
+    m_recordingFrame = frame;
+    auto &slot = m_frames[frame];
+    slot.passes.clear();
+    slot.statisticsQueryCount = 0;
+
+    vkCmdResetQueryPool(commandBuffer, m_timestampPool, static_cast<uint32_t>(frame) * MaxPassesPerFrame * 2, MaxPassesPerFrame * 2);
+    if (m_statisticsPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, m_statisticsPool, static_cast<uint32_t>(frame) * MaxPassesPerFrame, MaxPassesPerFrame);
+    }
+
+    BeginPass(commandBuffer, "frame");
+}
+
+uint32_t GpuProfiler::BeginPass(VkCommandBuffer commandBuffer, const char *name, const bool executesSecondaries) {
+    if (!IsEnabled()) return NoQuery;
+
+    auto &slot = m_frames[m_recordingFrame];
+    if (slot.passes.size() >= MaxPassesPerFrame) return NoQuery;
+
+    const auto pass = static_cast<uint32_t>(slot.passes.size());
+    PassRecord record{
+            .name = name,
+            .timestampQuery = (static_cast<uint32_t>(m_recordingFrame) * MaxPassesPerFrame + pass) * 2,
+            .statisticsQuery = NoQuery};
+
+    // the frame pass would overlap every other statistics query, which is not allowed
+    const auto wantsStatistics = m_statisticsPool != VK_NULL_HANDLE && pass != 0 && (!executesSecondaries || m_inheritedQueries);
+    if (wantsStatistics) {
+        record.statisticsQuery = static_cast<uint32_t>(m_recordingFrame) * MaxPassesPerFrame + slot.statisticsQueryCount++;
+        vkCmdBeginQuery(commandBuffer, m_statisticsPool, record.statisticsQuery, 0);
+    }
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampPool, record.timestampQuery);
+
+    slot.passes.push_back(record);
+    return pass;
+}
+
+void GpuProfiler::EndPass(VkCommandBuffer commandBuffer, const uint32_t pass) {
+    if (!IsEnabled() || pass == NoQuery) return;
+
+    const auto &record = m_frames[m_recordingFrame].passes[pass];
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampPool, record.timestampQuery + 1);
+    if (record.statisticsQuery != NoQuery) {
+        vkCmdEndQuery(commandBuffer, m_statisticsPool, record.statisticsQuery);
+    }
+}
+
+void GpuProfiler::EndFrame(VkCommandBuffer commandBuffer) {
+    if (!IsEnabled()) return;
+
+    EndPass(commandBuffer, 0);
+
+    auto &slot = m_frames[m_recordingFrame];
+    slot.submitted = true;
+    slot.submitTime = std::chrono::steady_clock::now();
+}
+
+VkQueryPipelineStatisticFlags GpuProfiler::GetInheritedStatistics() const {
+    return m_inheritedQueries ? m_statisticFlags : 0;
+}
+
+const std::vector<const char *> &GpuProfiler::GetStatisticNames() {
+    // in bit order of StatisticFlags, which is the order the results come back in
+    static const std::vector<const char *> names = {
+            "input assembly vertices",
+            "vertex shader invocations",
+            "clipping primitives",
+            "fragment shader invocations",
+            "compute shader invocations"};
+    return names;
+}
+
+void GpuProfiler::AddCpuEvent(const char *name, const std::chrono::steady_clock::time_point begin, const std::chrono::steady_clock::time_point end) {
+    const auto beginUs = ToMicroseconds(begin);
+    AddTraceEvent(name, beginUs, ToMicroseconds(end) - beginUs, false);
+}
+
+std::vector<GpuProfiler::PassStats> GpuProfiler::GetStats() const {
+    std::vector<PassStats> stats;
+    stats.reserve(m_history.size());
+
+    for (const auto &history : m_history) {
+        if (history.samples.empty()) continue;
+
+        std::vector<double> samples(history.samples.begin(), history.samples.end());
+        std::sort(samples.begin(), samples.end());
+
+        PassStats pass{
+                .name = history.name,
+                .minMs = samples.front(),
+                .avgMs = 0.0,
+                .p99Ms = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)],
+                .sampleCount = samples.size(),
+                .statistics = {}};
+
+        for (const auto sample : samples) {
+            pass.avgMs += sample;
+        }
+        pass.avgMs /= static_cast<double>(samples.size());
+
+        if (history.statisticsFrames > 0) {
+            for (const auto total : history.statisticsTotal) {
+                pass.statistics.push_back(total / static_cast<double>(history.statisticsFrames));
+            }
+        }
+
+        stats.push_back(std::move(pass));
+    }
+
+    return stats;
+}
+
+void GpuProfiler::PrintStats(std::ostream &out) const {
+    const auto &statisticNames = GetStatisticNames();
+
+    for (const auto &pass : GetStats()) {
+        out << "GPU " << pass.name << ": min " << pass.minMs << " ms, avg " << pass.avgMs << " ms, p99 " << pass.p99Ms
+            << " ms over the last " << pass.sampleCount << " frames" << std::endl;
+
+        for (size_t i = 0; i < pass.statistics.size(); ++i) {
+            if (pass.statistics[i] > 0.0) {
+                out << "    " << statisticNames[i] << ": " << pass.statistics[i] << " per frame" << std::endl;
+            }
+        }
+    }
+}
+
+void GpuProfiler::WriteChromeTrace(const std::string &path) const {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open trace file!");
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+         << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n"
+         << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+
+    for (const auto &event : m_traceEvents) {
+        file << ",\n{\"name\":";
+        WriteJsonString(file, event.name);
+        file << ",\"cat\":\"" << (event.gpu ? "gpu" : "cpu") << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (event.gpu ? 2 : 1)
+             << ",\"ts\":" << event.beginUs << ",\"dur\":" << event.durationUs << "}";
+    }
+
+    // the instrumented CPU zones share the time origin, so they line up with the GPU passes
+    CpuProfiler::WriteTraceEvents(file, 1, true);
+
+    file << "\n]}\n";
+}
+
+GpuProfiler::PassHistory &GpuProfiler::FindHistory(const char *name) {
+    const auto it = std::find_if(m_history.begin(), m_history.end(), [name](const auto &history) { return history.name == name; });
+    if (it != m_history.end()) return *it;
+
+    m_history.push_back({.name = name, .samples = {}, .statisticsTotal = {}, .statisticsFrames = 0});
+    return m_history.back();
+}
+
+void GpuProfiler::AddTraceEvent(const char *name, const double beginUs, const double durationUs, const bool gpu) {
+    if (m_traceEvents.size() >= MaxTraceEvents) return;
+
+    m_traceEvents.push_back({.name = name, .beginUs = beginUs, .durationUs = durationUs, .gpu = gpu});
+}
+
+double GpuProfiler::ToMicroseconds(const std::chrono::steady_clock::time_point time) const {
+    return std::chrono::duration<double, std::micro>(time - m_startTime).count();
+}
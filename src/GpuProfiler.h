@@ -0,0 +1,119 @@
+#ifndef VULKANLEARNING_GPUPROFILER_H
+#define VULKANLEARNING_GPUPROFILER_H
+
+#include <vulkan/vulkan.h>
+#include <chrono>
+#include <deque>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Timestamp and pipeline statistics queries around the passes of every frame.
+// A frame's results are read back when its slot comes around again, after the frame has completed,
+// so reading them never stalls the CPU; statistics lag behind by the number of frames in flight.
+class GpuProfiler
+{
+public:
+	struct PassStats
+	{
+		std::string name;
+		double minMs = 0.0;
+		double avgMs = 0.0;
+		double p99Ms = 0.0;
+		size_t sampleCount = 0;
+		// average per frame of every counter in GetStatisticNames(), empty if the pass had no statistics
+		std::vector<double> statistics;
+	};
+
+	// statistics needs the pipelineStatisticsQuery feature, inheritedQueries lets statistics cover
+	// passes that execute secondary command buffers
+	GpuProfiler(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, size_t framesInFlight,
+	            bool statistics, bool inheritedQueries);
+	~GpuProfiler();
+
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	// false if the queue family cannot write timestamps, every other call is then a no-op
+	[[nodiscard]] bool IsEnabled() const { return m_timestampPool != VK_NULL_HANDLE; }
+
+	// reads back the previous use of this frame slot, call once its previous frame has completed
+	void CollectFrame(size_t frame);
+
+	// BeginFrame() and EndFrame() bracket the whole primary command buffer and record the "frame" pass,
+	// passes in between are recorded outside of render pass instances
+	void BeginFrame(VkCommandBuffer commandBuffer, size_t frame);
+	uint32_t BeginPass(VkCommandBuffer commandBuffer, const char* name, bool executesSecondaries = false);
+	void EndPass(VkCommandBuffer commandBuffer, uint32_t pass);
+	void EndFrame(VkCommandBuffer commandBuffer);
+
+	// pipelineStatistics for the inheritance info of secondaries executed inside a pass
+	[[nodiscard]] VkQueryPipelineStatisticFlags GetInheritedStatistics() const;
+	[[nodiscard]] static const std::vector<const char*>& GetStatisticNames();
+
+	// records a CPU span in the trace, timed with std::chrono::steady_clock
+	void AddCpuEvent(const char* name, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end);
+
+	[[nodiscard]] std::vector<PassStats> GetStats() const;
+	void PrintStats(std::ostream& out) const;
+	// Chrome trace event format, open with chrome://tracing or ui.perfetto.dev
+	void WriteChromeTrace(const std::string& path) const;
+
+private:
+	struct PassRecord
+	{
+		const char* name;
+		uint32_t timestampQuery;
+		// UINT32_MAX when the pass has no statistics query
+		uint32_t statisticsQuery;
+	};
+
+	struct FrameSlot
+	{
+		std::vector<PassRecord> passes;
+		uint32_t statisticsQueryCount = 0;
+		bool submitted = false;
+		std::chrono::steady_clock::time_point submitTime;
+	};
+
+	struct PassHistory
+	{
+		std::string name;
+		std::deque<double> samples;
+		std::vector<double> statisticsTotal;
+		uint64_t statisticsFrames = 0;
+	};
+
+	struct TraceEvent
+	{
+		std::string name;
+		double beginUs;
+		double durationUs;
+		bool gpu;
+	};
+
+	PassHistory& FindHistory(const char* name);
+	void AddTraceEvent(const char* name, double beginUs, double durationUs, bool gpu);
+	[[nodiscard]] double ToMicroseconds(std::chrono::steady_clock::time_point time) const;
+
+	VkDevice m_device;
+	VkQueryPool m_timestampPool{};
+	VkQueryPool m_statisticsPool{};
+	VkQueryPipelineStatisticFlags m_statisticFlags = 0;
+	bool m_inheritedQueries;
+	double m_timestampPeriodNs = 1.0;
+	uint64_t m_timestampMask = ~0ull;
+
+	std::vector<FrameSlot> m_frames;
+	size_t m_recordingFrame = 0;
+
+	std::vector<PassHistory> m_history;
+
+	std::chrono::steady_clock::time_point m_startTime;
+	// GPU timestamps are put on the CPU timeline by lining the first collected frame up with its submission
+	bool m_hasClockOffset = false;
+	double m_gpuToCpuOffsetUs = 0.0;
+	std::vector<TraceEvent> m_traceEvents;
+};
+
+#endif
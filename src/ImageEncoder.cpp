@@ -0,0 +1,180 @@
+#include "ImageEncoder.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+    constexpr std::array<uint32_t, 256> CrcTable = [] {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            auto crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 1) != 0 ? 0xedb88320u ^ (crc >> 1) : crc >> 1;
+            }
+            table[i] = crc;
+        }
+        return table;
+    }();
+
+    // the largest block deflate can store
+    constexpr size_t MaxStoredBlock = 65535;
+
+    void PutBigEndian(std::vector<uint8_t> &out, const uint32_t value) {
+        out.push_back(static_cast<uint8_t>(value >> 24));
+        out.push_back(static_cast<uint8_t>(value >> 16));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    // a chunk's CRC covers its type and data, not its length
+    void PutChunk(std::vector<uint8_t> &out, const char (&type)[5], const std::vector<uint8_t> &data) {
+        PutBigEndian(out, static_cast<uint32_t>(data.size()));
+
+        const auto crcStart = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+
+        auto crc = 0xffffffffu;
+        for (auto i = crcStart; i < out.size(); ++i) {
+            crc = CrcTable[(crc ^ out[i]) & 0xff] ^ (crc >> 8);
+        }
+        PutBigEndian(out, crc ^ 0xffffffffu);
+    }
+
+    bool EndsWith(const std::string &path, const char *suffix) {
+        const std::string end(suffix);
+        if (path.size() < end.size()) return false;
+
+        for (size_t i = 0; i < end.size(); ++i) {
+            auto c = path[path.size() - end.size() + i];
+            if (c >= 'A' && c <= 'Z') {
+                c = static_cast<char>(c - 'A' + 'a');
+            }
+            if (c != end[i]) return false;
+        }
+        return true;
+    }
+}
+
+ImageEncoder::Format ImageEncoder::FormatOf(const std::string &path) {
+    if (EndsWith(path, ".png")) return Format::Png;
+    if (EndsWith(path, ".ppm")) return Format::Ppm;
+    return Format::Raw;
+}
+
+void ImageEncoder::Write(const std::string &path, const uint8_t *rgba, const uint32_t width, const uint32_t height) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open image file " + path + "!");
+    }
+
+    switch (FormatOf(path)) {
+        case Format::Png: {
+            const auto png = EncodePng(rgba, width, height);
+            file.write(reinterpret_cast<const char *>(png.data()), static_cast<std::streamsize>(png.size()));
+            break;
+        }
+        case Format::Ppm: {
+            const auto ppm = EncodePpm(rgba, width, height);
+            file.write(reinterpret_cast<const char *>(ppm.data()), static_cast<std::streamsize>(ppm.size()));
+            break;
+        }
+        case Format::Raw:
+            file.write(reinterpret_cast<const char *>(rgba), static_cast<std::streamsize>(static_cast<size_t>(width) * height * 4));
+            break;
+    }
+
+    if (!file) {
+        throw std::runtime_error("Failed to write image file " + path + "!");
+    }
+}
+
+std::vector<uint8_t> ImageEncoder::EncodePng(const uint8_t *rgba, const uint32_t width, const uint32_t height) {
+    const auto rowSize = static_cast<size_t>(width) * 4;
+    // every row starts with its filter type, 0 leaves the pixels as they are
+    const auto rawSize = (rowSize + 1) * height;
+    const auto blockCount = std::max<size_t>((rawSize + MaxStoredBlock - 1) / MaxStoredBlock, 1);
+
+    // zlib stream: header, stored deflate blocks, Adler-32 of the uncompressed data
+    std::vector<uint8_t> zlib;
+    zlib.reserve(2 + rawSize + blockCount * 5 + 4);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+
+    uint32_t adlerA = 1;
+    uint32_t adlerB = 0;
+    size_t row = 0;
+    // bytes of the current row already written, the filter byte included
+    size_t rowOffset = 0;
+    for (size_t remaining = rawSize, block = 0; block < blockCount; ++block) {
+        const auto blockSize = std::min(remaining, MaxStoredBlock);
+        remaining -= blockSize;
+
+        zlib.push_back(remaining == 0 ? 1 : 0);
+        zlib.push_back(static_cast<uint8_t>(blockSize));
+        zlib.push_back(static_cast<uint8_t>(blockSize >> 8));
+        zlib.push_back(static_cast<uint8_t>(~blockSize));
+        zlib.push_back(static_cast<uint8_t>(~blockSize >> 8));
+
+        // blocks do not follow the rows, a row may be split across two of them
+        for (size_t written = 0; written < blockSize;) {
+            if (rowOffset == 0) {
+                zlib.push_back(0);
+                adlerB = (adlerB + adlerA) % 65521;
+                ++rowOffset;
+                ++written;
+                continue;
+            }
+
+            const auto count = std::min(blockSize - written, rowSize + 1 - rowOffset);
+            const auto *const source = rgba + row * rowSize + (rowOffset - 1);
+            zlib.insert(zlib.end(), source, source + count);
+            // the sums stay below 2^32 for 5552 bytes between the reductions, as zlib's own loop does
+            for (size_t i = 0; i < count; i += 5552) {
+                const auto end = std::min(count, i + 5552);
+                for (auto j = i; j < end; ++j) {
+                    adlerA += source[j];
+                    adlerB += adlerA;
+                }
+                adlerA %= 65521;
+                adlerB %= 65521;
+            }
+
+            rowOffset += count;
+            written += count;
+            if (rowOffset == rowSize + 1) {
+                rowOffset = 0;
+                ++row;
+            }
+        }
+    }
+    PutBigEndian(zlib, adlerB << 16 | adlerA);
+
+    std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    png.reserve(png.size() + 3 * 12 + 13 + zlib.size());
+
+    std::vector<uint8_t> header;
+    PutBigEndian(header, width);
+    PutBigEndian(header, height);
+    // 8 bits per channel, RGBA, deflate, adaptive filtering, no interlacing
+    header.insert(header.end(), {8, 6, 0, 0, 0});
+
+    PutChunk(png, "IHDR", header);
+    PutChunk(png, "IDAT", zlib);
+    PutChunk(png, "IEND", {});
+    return png;
+}
+
+std::vector<uint8_t> ImageEncoder::EncodePpm(const uint8_t *rgba, const uint32_t width, const uint32_t height) {
+    const auto header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    const auto pixelCount = static_cast<size_t>(width) * height;
+
+    std::vector<uint8_t> ppm(header.begin(), header.end());
+    ppm.reserve(header.size() + pixelCount * 3);
+    for (size_t i = 0; i < pixelCount; ++i) {
+        ppm.insert(ppm.end(), rgba + i * 4, rgba + i * 4 + 3);
+    }
+    return ppm;
+}
@@ -0,0 +1,31 @@
+#ifndef VULKANLEARNING_IMAGEENCODER_H
+#define VULKANLEARNING_IMAGEENCODER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Writes read back RGBA8 frames to files, the format follows the extension: .png, .ppm (the alpha channel is
+// dropped) or raw RGBA rows for anything else. Stateless, any number of threads may encode at the same time.
+// PNG is written with stored deflate blocks: the tree has no zlib, and without compression encoding stays a
+// single pass over the pixels that keeps up with the GPU.
+class ImageEncoder
+{
+public:
+	enum class Format : uint32_t
+	{
+		Png,
+		Ppm,
+		Raw
+	};
+
+	[[nodiscard]] static Format FormatOf(const std::string& path);
+
+	// rgba holds width * height tightly packed pixels
+	static void Write(const std::string& path, const uint8_t* rgba, uint32_t width, uint32_t height);
+
+	[[nodiscard]] static std::vector<uint8_t> EncodePng(const uint8_t* rgba, uint32_t width, uint32_t height);
+	[[nodiscard]] static std::vector<uint8_t> EncodePpm(const uint8_t* rgba, uint32_t width, uint32_t height);
+};
+
+#endif
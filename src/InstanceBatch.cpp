@@ -0,0 +1,91 @@
+#include "InstanceBatch.h"
+
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define VULKANLEARNING_INSTANCE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+InstanceBatch::InstanceBatch(const size_t count)
+    : m_count(count) {
+    const auto padded = (count + Lanes - 1) / Lanes * Lanes;
+    m_x.resize(padded);
+    m_y.resize(padded);
+    m_scale.resize(padded);
+    m_r.resize(padded);
+    m_g.resize(padded);
+    m_b.resize(padded);
+}
+
+void InstanceBatch::Set(const size_t index, const float x, const float y, const float scale, const float (&color)[3]) {
+    m_x[index] = x;
+    m_y[index] = y;
+    m_scale[index] = scale;
+    m_r[index] = color[0];
+    m_g[index] = color[1];
+    m_b[index] = color[2];
+}
+
+bool InstanceBatch::IsVectorized() {
+#ifdef VULKANLEARNING_INSTANCE_SSE
+    return true;
+#else
+    return false;
+#endif
+}
+
+void InstanceBatch::Update(const float angle, const float brightness, const size_t first, const size_t count, InstanceData *destination) const {
+    const auto cosAngle = std::cos(angle);
+    const auto sinAngle = std::sin(angle);
+
+#ifdef VULKANLEARNING_INSTANCE_SSE
+    const auto cosLanes = _mm_set1_ps(cosAngle);
+    const auto sinLanes = _mm_set1_ps(sinAngle);
+    const auto brightnessLanes = _mm_set1_ps(brightness);
+
+    // unaligned loads and stores, neither the vectors nor the mapped destination promise 16 byte alignment
+    size_t i = 0;
+    for (; i + Lanes <= count; i += Lanes) {
+        const auto source = first + i;
+        const auto x = _mm_loadu_ps(&m_x[source]);
+        const auto y = _mm_loadu_ps(&m_y[source]);
+
+        auto transform0 = _mm_sub_ps(_mm_mul_ps(x, cosLanes), _mm_mul_ps(y, sinLanes));
+        auto transform1 = _mm_add_ps(_mm_mul_ps(x, sinLanes), _mm_mul_ps(y, cosLanes));
+        auto transform2 = _mm_loadu_ps(&m_scale[source]);
+        auto transform3 = _mm_setzero_ps();
+        // from one register per component to one register per instance
+        _MM_TRANSPOSE4_PS(transform0, transform1, transform2, transform3);
+
+        auto color0 = _mm_mul_ps(_mm_loadu_ps(&m_r[source]), brightnessLanes);
+        auto color1 = _mm_mul_ps(_mm_loadu_ps(&m_g[source]), brightnessLanes);
+        auto color2 = _mm_mul_ps(_mm_loadu_ps(&m_b[source]), brightnessLanes);
+        auto color3 = _mm_set1_ps(1.0f);
+        _MM_TRANSPOSE4_PS(color0, color1, color2, color3);
+
+        _mm_storeu_ps(destination[i].transform, transform0);
+        _mm_storeu_ps(destination[i].color, color0);
+        _mm_storeu_ps(destination[i + 1].transform, transform1);
+        _mm_storeu_ps(destination[i + 1].color, color1);
+        _mm_storeu_ps(destination[i + 2].transform, transform2);
+        _mm_storeu_ps(destination[i + 2].color, color2);
+        _mm_storeu_ps(destination[i + 3].transform, transform3);
+        _mm_storeu_ps(destination[i + 3].color, color3);
+    }
+
+    UpdateScalar(cosAngle, sinAngle, brightness, first + i, count - i, destination + i);
+#else
+    UpdateScalar(cosAngle, sinAngle, brightness, first, count, destination);
+#endif
+}
+
+void InstanceBatch::UpdateScalar(const float cosAngle, const float sinAngle, const float brightness, const size_t first, const size_t count,
+                                 InstanceData *destination) const {
+    for (size_t i = 0; i < count; ++i) {
+        const auto source = first + i;
+        destination[i] = {
+                .transform = {m_x[source] * cosAngle - m_y[source] * sinAngle, m_x[source] * sinAngle + m_y[source] * cosAngle, m_scale[source], 0.0f},
+                .color = {m_r[source] * brightness, m_g[source] * brightness, m_b[source] * brightness, 1.0f}};
+    }
+}
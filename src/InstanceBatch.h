@@ -0,0 +1,48 @@
+#ifndef VULKANLEARNING_INSTANCEBATCH_H
+#define VULKANLEARNING_INSTANCEBATCH_H
+
+#include <cstddef>
+#include <vector>
+
+// layout of the instance rate vertex binding of the instanced scene pipeline
+struct InstanceData
+{
+	// xy offset, z scale
+	float transform[4];
+	// rgb multiplied with the vertex color, a unused
+	float color[4];
+};
+
+// Per instance state of the instanced scene path, kept as a structure of arrays so that the per frame update
+// works on four instances per SSE instruction; only the final store interleaves them into InstanceData.
+// The arrays are padded to a multiple of Lanes, so the vector loop never needs a masked tail on the inputs.
+class InstanceBatch
+{
+public:
+	static constexpr size_t Lanes = 4;
+
+	explicit InstanceBatch(size_t count);
+
+	void Set(size_t index, float x, float y, float scale, const float (&color)[3]);
+
+	// rotates every instance around the origin by angle, scales its color by brightness and writes instances
+	// [first, first + count) to destination[0, count); disjoint ranges may be written from several threads
+	void Update(float angle, float brightness, size_t first, size_t count, InstanceData* destination) const;
+
+	[[nodiscard]] size_t GetCount() const { return m_count; }
+	// whether Update() runs the SSE path or the scalar fallback
+	[[nodiscard]] static bool IsVectorized();
+
+private:
+	void UpdateScalar(float cosAngle, float sinAngle, float brightness, size_t first, size_t count, InstanceData* destination) const;
+
+	size_t m_count;
+	std::vector<float> m_x;
+	std::vector<float> m_y;
+	std::vector<float> m_scale;
+	std::vector<float> m_r;
+	std::vector<float> m_g;
+	std::vector<float> m_b;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#include "PipelineCompiler.h"
+
+#include <algorithm>
+#include <iostream>
+
+PipelineCompiler::PipelineCompiler(PipelineRegistry &registry, size_t threadCount)
+    : m_registry(registry) {
+    if (threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    m_threadPool = std::make_unique<ThreadPool>(threadCount);
+}
+
+PipelineCompiler::~PipelineCompiler() {
+    m_stopping = true;
+    m_threadPool.reset();
+}
+
+PipelineCompiler::Handle PipelineCompiler::Request(GraphicsPipelineDesc desc) {
+    if (m_entries.empty()) {
+        m_firstRequestTime = std::chrono::steady_clock::now();
+    }
+
+    auto &entry = m_entries.emplace_back();
+    entry.desc = std::move(desc);
+
+    // the future is not needed, Compile() reports a failure through the entry itself
+    m_threadPool->Submit([this, &entry] { Compile(entry); });
+
+    return static_cast<Handle>(m_entries.size() - 1);
+}
+
+VkPipeline PipelineCompiler::Get(const Handle handle) const {
+    return m_entries[handle].pipeline.load(std::memory_order_acquire);
+}
+
+PipelineCompiler::Stats PipelineCompiler::GetStats() const {
+    Stats stats{.requested = m_entries.size()};
+
+    std::chrono::steady_clock::time_point lastFinishTime = m_firstRequestTime;
+    for (const auto &entry : m_entries) {
+        if (!entry.done.load(std::memory_order_acquire)) continue;
+
+        if (entry.pipeline.load() != VK_NULL_HANDLE) {
+            ++stats.compiled;
+        } else {
+            ++stats.failed;
+        }
+        stats.compileMs += entry.compileMs;
+        lastFinishTime = std::max(lastFinishTime, entry.finishTime);
+    }
+    stats.wallMs = std::chrono::duration<double, std::milli>(lastFinishTime - m_firstRequestTime).count();
+
+    return stats;
+}
+
+void PipelineCompiler::Compile(Entry &entry) {
+    if (!m_stopping) {
+        const auto start = std::chrono::steady_clock::now();
+        // an exception would only end up in the dropped future, the pipeline stays null and counts as failed
+        try {
+            entry.pipeline.store(m_registry.GetOrCreate(entry.desc), std::memory_order_release);
+        }
+        catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+        }
+        entry.finishTime = std::chrono::steady_clock::now();
+        entry.compileMs = std::chrono::duration<double, std::milli>(entry.finishTime - start).count();
+    }
+
+    entry.done.store(true, std::memory_order_release);
+}
@@ -0,0 +1,71 @@
+#ifndef VULKANLEARNING_PIPELINECOMPILER_H
+#define VULKANLEARNING_PIPELINECOMPILER_H
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "../tools/ThreadPool.h"
+#include "PipelineRegistry.h"
+
+// Compiles graphics pipelines on worker threads through a PipelineRegistry. Request() returns a handle at
+// once and Get() stays VK_NULL_HANDLE until the pipeline is ready, so the caller keeps drawing with a
+// fallback instead of waiting. Requests with the same state share one pipeline and one compilation.
+// Request() and Get() belong to a single thread, the render loop.
+class PipelineCompiler
+{
+public:
+	using Handle = uint32_t;
+
+	struct Stats
+	{
+		size_t requested = 0;
+		size_t compiled = 0;
+		size_t failed = 0;
+		// from the first request to the last completed compilation
+		double wallMs = 0.0;
+		// sum of the time every request took, including waiting for a compilation of the same state
+		double compileMs = 0.0;
+	};
+
+	// threadCount 0 uses every hardware thread
+	PipelineCompiler(PipelineRegistry& registry, size_t threadCount);
+	// compilations that have not started are skipped, the ones running are waited for
+	~PipelineCompiler();
+
+	PipelineCompiler(const PipelineCompiler&) = delete;
+	PipelineCompiler& operator=(const PipelineCompiler&) = delete;
+
+	Handle Request(GraphicsPipelineDesc desc);
+	// VK_NULL_HANDLE while compiling, and for good if the compilation failed; owned by the registry
+	[[nodiscard]] VkPipeline Get(Handle handle) const;
+
+	[[nodiscard]] size_t GetThreadCount() const { return m_threadPool->GetThreadCount(); }
+	[[nodiscard]] Stats GetStats() const;
+
+private:
+	struct Entry
+	{
+		GraphicsPipelineDesc desc;
+		std::atomic<VkPipeline> pipeline{VK_NULL_HANDLE};
+		// set once the compilation has finished, successfully or not
+		std::atomic<bool> done{false};
+		double compileMs = 0.0;
+		std::chrono::steady_clock::time_point finishTime;
+	};
+
+	void Compile(Entry& entry);
+
+	PipelineRegistry& m_registry;
+
+	// a deque never moves its elements, the workers hold on to them while new ones are added
+	std::deque<Entry> m_entries;
+	std::chrono::steady_clock::time_point m_firstRequestTime;
+	std::atomic<bool> m_stopping{false};
+	std::unique_ptr<ThreadPool> m_threadPool;
+};
+
+#endif
@@ -0,0 +1,375 @@
+#include "PipelineRegistry.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace {
+    // FNV-1a fed one scalar at a time, so that struct padding never ends up in the hash
+    class StateHasher {
+    public:
+        template<typename T>
+        void Add(const T &value) {
+            static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>);
+            const auto bytes = reinterpret_cast<const unsigned char *>(&value);
+            for (size_t i = 0; i < sizeof(T); ++i) {
+                m_hash ^= bytes[i];
+                m_hash *= 0x100000001b3ull;
+            }
+        }
+
+        // non-dispatchable handles are pointers on 64-bit platforms and integers elsewhere
+        template<typename Handle>
+        void AddHandle(const Handle handle) {
+            if constexpr (std::is_pointer_v<Handle>) {
+                Add(reinterpret_cast<uintptr_t>(handle));
+            } else {
+                Add(handle);
+            }
+        }
+
+        [[nodiscard]] uint64_t Get() const { return m_hash; }
+
+    private:
+        uint64_t m_hash = 0xcbf29ce484222325ull;
+    };
+
+    uint64_t HashState(const GraphicsPipelineDesc &desc, const uint64_t vertexShaderHash, const uint64_t fragmentShaderHash) {
+        StateHasher hasher;
+        hasher.Add(vertexShaderHash);
+        hasher.Add(fragmentShaderHash);
+
+        hasher.Add(desc.vertexBindings.size());
+        for (const auto &binding : desc.vertexBindings) {
+            hasher.Add(binding.binding);
+            hasher.Add(binding.stride);
+            hasher.Add(binding.inputRate);
+        }
+        hasher.Add(desc.vertexAttributes.size());
+        for (const auto &attribute : desc.vertexAttributes) {
+            hasher.Add(attribute.location);
+            hasher.Add(attribute.binding);
+            hasher.Add(attribute.format);
+            hasher.Add(attribute.offset);
+        }
+
+        hasher.Add(desc.topology);
+        hasher.Add(desc.polygonMode);
+        hasher.Add(static_cast<uint32_t>(desc.extendedDynamicState));
+        if (!desc.extendedDynamicState) {
+            hasher.Add(desc.cullMode);
+            hasher.Add(desc.frontFace);
+        }
+        hasher.Add(static_cast<uint32_t>(desc.blendEnable));
+        hasher.Add(desc.fragmentConstants.size());
+        for (const auto constant : desc.fragmentConstants) {
+            hasher.Add(constant);
+        }
+        hasher.Add(desc.samples);
+
+        // equal layouts are one handle through GetOrCreateLayout(), but a different one on every run
+        hasher.AddHandle(desc.layout);
+        hasher.Add(desc.colorFormats.size());
+        for (const auto format : desc.colorFormats) {
+            hasher.Add(format);
+        }
+        // a dynamic rendering pipeline is not compatible with any render pass
+        hasher.Add(static_cast<uint32_t>(desc.renderPass == VK_NULL_HANDLE));
+        hasher.Add(desc.subpass);
+
+        return hasher.Get();
+    }
+}
+
+PipelineRegistry::PipelineRegistry(VkDevice device, ShaderModuleCache &shaderModules, VkPipelineCache pipelineCache)
+    : m_device(device), m_shaderModules(shaderModules), m_pipelineCache(pipelineCache) {}
+
+PipelineRegistry::~PipelineRegistry() {
+    // every compilation has finished by now, whoever started one waited for it
+    for (auto &shard : m_shards) {
+        for (const auto &[hash, pipeline] : shard.pipelines) {
+            vkDestroyPipeline(m_device, pipeline.get(), nullptr);
+        }
+    }
+
+    for (const auto &[hash, layout] : m_layouts) {
+        vkDestroyPipelineLayout(m_device, layout, nullptr);
+    }
+}
+
+VkPipelineLayout PipelineRegistry::GetOrCreateLayout(const PipelineLayoutDesc &desc) {
+    const auto hash = Hash(desc);
+
+    std::lock_guard<std::mutex> lock(m_layoutMutex);
+    const auto found = m_layouts.find(hash);
+    if (found != m_layouts.end()) {
+        return found->second;
+    }
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .setLayoutCount = static_cast<uint32_t>(desc.setLayouts.size()),
+            .pSetLayouts = desc.setLayouts.data(),
+            .pushConstantRangeCount = static_cast<uint32_t>(desc.pushConstantRanges.size()),
+            .pPushConstantRanges = desc.pushConstantRanges.data()
+    };
+
+    VkPipelineLayout layout;
+    if (vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, nullptr, &layout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create pipeline layout!");
+    }
+
+    m_layouts.emplace(hash, layout);
+    return layout;
+}
+
+VkPipeline PipelineRegistry::GetOrCreate(const GraphicsPipelineDesc &desc) {
+    const auto vertexShader = m_shaderModules.Load(desc.vertexShader);
+    const auto fragmentShader = m_shaderModules.Load(desc.fragmentShader);
+    return GetOrCreate(desc, vertexShader, m_shaderModules.GetHash(vertexShader), fragmentShader, m_shaderModules.GetHash(fragmentShader));
+}
+
+VkPipeline PipelineRegistry::GetOrCreate(const GraphicsPipelineDesc &desc, VkShaderModule vertexShader, const uint64_t vertexShaderHash,
+                                         VkShaderModule fragmentShader, const uint64_t fragmentShaderHash) {
+    const auto hash = HashState(desc, vertexShaderHash, fragmentShaderHash);
+
+    auto &shard = m_shards[hash % ShardCount];
+    std::promise<VkPipeline> promise;
+    std::shared_future<VkPipeline> existing;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        const auto [entry, isNew] = shard.pipelines.try_emplace(hash);
+        if (isNew) {
+            entry->second = promise.get_future().share();
+        } else {
+            existing = entry->second;
+        }
+    }
+
+    // waited for without the shard locked
+    if (existing.valid()) {
+        ++m_hits;
+        return existing.get();
+    }
+    ++m_misses;
+
+    // compiled without the lock, other states in the same shard go on meanwhile
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    try {
+        pipeline = Build(m_device, m_pipelineCache, desc, vertexShader, fragmentShader);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+    }
+    promise.set_value(pipeline);
+
+    return pipeline;
+}
+
+void PipelineRegistry::Remove(VkPipeline pipeline) {
+    // the hash of the state is not at hand, but this only runs when shaders are reloaded
+    for (auto &shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto entry = shard.pipelines.begin(); entry != shard.pipelines.end(); ++entry) {
+            if (entry->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready && entry->second.get() == pipeline) {
+                shard.pipelines.erase(entry);
+                return;
+            }
+        }
+    }
+}
+
+uint64_t PipelineRegistry::Hash(const GraphicsPipelineDesc &desc) const {
+    return HashState(desc, m_shaderModules.GetHash(m_shaderModules.Load(desc.vertexShader)),
+                     m_shaderModules.GetHash(m_shaderModules.Load(desc.fragmentShader)));
+}
+
+uint64_t PipelineRegistry::Hash(const PipelineLayoutDesc &desc) {
+    StateHasher hasher;
+    hasher.Add(desc.setLayouts.size());
+    for (const auto setLayout : desc.setLayouts) {
+        hasher.AddHandle(setLayout);
+    }
+    hasher.Add(desc.pushConstantRanges.size());
+    for (const auto &range : desc.pushConstantRanges) {
+        hasher.Add(range.stageFlags);
+        hasher.Add(range.offset);
+        hasher.Add(range.size);
+    }
+    return hasher.Get();
+}
+
+PipelineRegistry::Stats PipelineRegistry::GetStats() const {
+    Stats stats{.hits = m_hits.load(), .misses = m_misses.load()};
+
+    for (auto &shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.pipelines += shard.pipelines.size();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_layoutMutex);
+        stats.layouts = m_layouts.size();
+    }
+
+    return stats;
+}
+
+VkPipeline PipelineRegistry::Build(VkDevice device, VkPipelineCache pipelineCache, const GraphicsPipelineDesc &desc,
+                                   VkShaderModule vertexShader, VkShaderModule fragmentShader) {
+    std::vector<VkSpecializationMapEntry> specializationEntries(desc.fragmentConstants.size());
+    for (uint32_t i = 0; i < specializationEntries.size(); ++i) {
+        specializationEntries[i] = {.constantID = i, .offset = i * static_cast<uint32_t>(sizeof(uint32_t)), .size = sizeof(uint32_t)};
+    }
+
+    VkSpecializationInfo specializationInfo{
+            .mapEntryCount = static_cast<uint32_t>(specializationEntries.size()),
+            .pMapEntries = specializationEntries.data(),
+            .dataSize = desc.fragmentConstants.size() * sizeof(uint32_t),
+            .pData = desc.fragmentConstants.data()};
+
+    VkPipelineShaderStageCreateInfo vertShaderStageInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vertexShader,
+            .pName = "main",
+            .pSpecializationInfo = nullptr};
+    VkPipelineShaderStageCreateInfo fragShaderStageInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fragmentShader,
+            .pName = "main",
+            .pSpecializationInfo = desc.fragmentConstants.empty() ? nullptr : &specializationInfo};
+
+    VkPipelineShaderStageCreateInfo shaderStageCreateInfo[] = {vertShaderStageInfo, fragShaderStageInfo};
+
+    VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .vertexBindingDescriptionCount = static_cast<uint32_t>(desc.vertexBindings.size()),
+            .pVertexBindingDescriptions = desc.vertexBindings.data(),
+            .vertexAttributeDescriptionCount = static_cast<uint32_t>(desc.vertexAttributes.size()),
+            .pVertexAttributeDescriptions = desc.vertexAttributes.data()};
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .topology = desc.topology,
+            .primitiveRestartEnable = VK_FALSE};
+
+    // viewport and scissor are dynamic so the pipeline survives swap chain recreation
+    VkPipelineViewportStateCreateInfo viewportStateCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .viewportCount = 1,
+            .pViewports = nullptr,
+            .scissorCount = 1,
+            .pScissors = nullptr};
+
+    std::vector<VkDynamicState> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    if (desc.extendedDynamicState) {
+        dynamicStates.push_back(VK_DYNAMIC_STATE_CULL_MODE);
+        dynamicStates.push_back(VK_DYNAMIC_STATE_FRONT_FACE);
+    }
+
+    VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .dynamicStateCount = static_cast<uint32_t>(dynamicStates.size()),
+            .pDynamicStates = dynamicStates.data()};
+
+    VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .depthClampEnable = VK_FALSE,
+            .rasterizerDiscardEnable = VK_FALSE,
+            .polygonMode = desc.polygonMode,
+            .cullMode = desc.cullMode,
+            .frontFace = desc.frontFace,
+            .depthBiasEnable = VK_FALSE,
+            .depthBiasConstantFactor = 0.0f,
+            .depthBiasClamp = 0.0f,
+            .depthBiasSlopeFactor = 0.0f,
+            .lineWidth = 1.0f};
+
+    VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .rasterizationSamples = desc.samples,
+            .sampleShadingEnable = VK_FALSE,
+            .minSampleShading = 0.0f,
+            .pSampleMask = nullptr,
+            .alphaToCoverageEnable = VK_FALSE,
+            .alphaToOneEnable = VK_FALSE};
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachmentState{
+            .blendEnable = desc.blendEnable ? VK_TRUE : VK_FALSE,
+            .srcColorBlendFactor = desc.blendEnable ? VK_BLEND_FACTOR_SRC_ALPHA : VK_BLEND_FACTOR_ZERO,
+            .dstColorBlendFactor = desc.blendEnable ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA : VK_BLEND_FACTOR_ZERO,
+            .colorBlendOp = VK_BLEND_OP_ADD,
+            .srcAlphaBlendFactor = desc.blendEnable ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ZERO,
+            .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+            .alphaBlendOp = VK_BLEND_OP_ADD,
+            .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+    };
+
+    VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .logicOpEnable = VK_FALSE,
+            .logicOp = VK_LOGIC_OP_COPY,
+            .attachmentCount = 1,
+            .pAttachments = &colorBlendAttachmentState,
+            .blendConstants = {0.0f, 0.0f, 0.0f, 0.0f}
+    };
+
+    // without a render pass the attachment formats are all the pipeline needs to know
+    VkPipelineRenderingCreateInfo renderingCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+            .pNext = nullptr,
+            .viewMask = 0,
+            .colorAttachmentCount = static_cast<uint32_t>(desc.colorFormats.size()),
+            .pColorAttachmentFormats = desc.colorFormats.data(),
+            .depthAttachmentFormat = VK_FORMAT_UNDEFINED,
+            .stencilAttachmentFormat = VK_FORMAT_UNDEFINED};
+
+    VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+            .pNext = desc.renderPass == VK_NULL_HANDLE ? &renderingCreateInfo : nullptr,
+            .flags = 0,
+            .stageCount = 2,
+            .pStages = shaderStageCreateInfo,
+            .pVertexInputState = &vertexInputStateCreateInfo,
+            .pInputAssemblyState = &inputAssemblyStateCreateInfo,
+            .pTessellationState = nullptr,
+            .pViewportState = &viewportStateCreateInfo,
+            .pRasterizationState = &rasterizationStateCreateInfo,
+            .pMultisampleState = &multisampleStateCreateInfo,
+            .pDepthStencilState = nullptr,
+            .pColorBlendState = &colorBlendStateCreateInfo,
+            .pDynamicState = &dynamicStateCreateInfo,
+            .layout = desc.layout,
+            .renderPass = desc.renderPass,
+            .subpass = desc.subpass,
+            .basePipelineHandle = VK_NULL_HANDLE,
+            .basePipelineIndex = 0
+    };
+
+    VkPipeline pipeline;
+    if(vkCreateGraphicsPipelines(device, pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr, &pipeline) != VK_SUCCESS){
+        throw std::runtime_error("Failed to create graphics pipeline!");
+    }
+
+    return pipeline;
+}
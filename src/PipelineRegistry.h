@@ -0,0 +1,114 @@
+#ifndef VULKANLEARNING_PIPELINEREGISTRY_H
+#define VULKANLEARNING_PIPELINEREGISTRY_H
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ShaderModuleCache.h"
+
+// Everything that tells two graphics pipelines apart; viewport and scissor are always dynamic.
+struct GraphicsPipelineDesc
+{
+	// names for ShaderModuleCache::Load()
+	std::string vertexShader = "vert.spv";
+	std::string fragmentShader = "frag.spv";
+	std::vector<VkVertexInputBindingDescription> vertexBindings;
+	std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+	VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+	VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+	VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+	// cull mode and front face become dynamic state (VK_EXT_extended_dynamic_state or Vulkan 1.3), so the two
+	// fields above are left out of the hash and the command buffer sets them with vkCmdSetCullMode/vkCmdSetFrontFace
+	bool extendedDynamicState = false;
+	// standard alpha blending, src * srcAlpha + dst * (1 - srcAlpha)
+	bool blendEnable = false;
+	// 32-bit fragment shader specialization constants, the i-th value goes to constant_id i
+	std::vector<uint32_t> fragmentConstants;
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+	// from PipelineRegistry::GetOrCreateLayout(), which makes equal layouts the same handle
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	// render pass compatibility is all the pipeline depends on, so the hash covers the attachment formats
+	// and the subpass but not the render pass handle
+	std::vector<VkFormat> colorFormats;
+	// VK_NULL_HANDLE builds the pipeline for dynamic rendering against colorFormats
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	uint32_t subpass = 0;
+};
+
+struct PipelineLayoutDesc
+{
+	std::vector<VkDescriptorSetLayout> setLayouts;
+	std::vector<VkPushConstantRange> pushConstantRanges;
+};
+
+// Pipelines and pipeline layouts keyed by a 64-bit hash of their state, so materials that end up with the
+// same state share one object and one compilation. Shaders are hashed by their SPIR-V rather than by name
+// or handle, which tells a hot reloaded shader apart. Layouts go in by handle, so a hash only means something
+// for the lifetime of the device it was made on and is never to be stored.
+// Safe to use from any thread, the table is split into shards with a lock each.
+class PipelineRegistry
+{
+public:
+	struct Stats
+	{
+		size_t pipelines = 0;
+		size_t layouts = 0;
+		// lookups that found a pipeline created, or being created, by an earlier one
+		size_t hits = 0;
+		size_t misses = 0;
+	};
+
+	PipelineRegistry(VkDevice device, ShaderModuleCache& shaderModules, VkPipelineCache pipelineCache);
+	// destroys every pipeline and layout it handed out
+	~PipelineRegistry();
+
+	PipelineRegistry(const PipelineRegistry&) = delete;
+	PipelineRegistry& operator=(const PipelineRegistry&) = delete;
+
+	VkPipelineLayout GetOrCreateLayout(const PipelineLayoutDesc& desc);
+	// compiles on the calling thread if the state is new, a concurrent caller with the same state
+	// waits for that compilation instead of starting its own; VK_NULL_HANDLE if it failed
+	VkPipeline GetOrCreate(const GraphicsPipelineDesc& desc);
+	// same with the given modules in place of the ones desc names, for the hot reloader's modules that are not
+	// in the shader module cache; the hashes are ShaderModuleCache::Hash() of their code
+	VkPipeline GetOrCreate(const GraphicsPipelineDesc& desc, VkShaderModule vertexShader, uint64_t vertexShaderHash,
+	                       VkShaderModule fragmentShader, uint64_t fragmentShaderHash);
+	// hands a pipeline that nothing draws with any more back to the caller, who destroys it
+	void Remove(VkPipeline pipeline);
+
+	[[nodiscard]] uint64_t Hash(const GraphicsPipelineDesc& desc) const;
+	[[nodiscard]] static uint64_t Hash(const PipelineLayoutDesc& desc);
+	[[nodiscard]] Stats GetStats() const;
+
+	// creates the pipeline on the calling thread without looking at the registry, the caller owns it
+	[[nodiscard]] static VkPipeline Build(VkDevice device, VkPipelineCache pipelineCache, const GraphicsPipelineDesc& desc,
+	                                      VkShaderModule vertexShader, VkShaderModule fragmentShader);
+
+private:
+	static constexpr size_t ShardCount = 16;
+
+	struct Shard
+	{
+		mutable std::mutex mutex;
+		std::unordered_map<uint64_t, std::shared_future<VkPipeline>> pipelines;
+	};
+
+	VkDevice m_device;
+	ShaderModuleCache& m_shaderModules;
+	VkPipelineCache m_pipelineCache;
+
+	Shard m_shards[ShardCount];
+	std::atomic<size_t> m_hits{0};
+	std::atomic<size_t> m_misses{0};
+
+	mutable std::mutex m_layoutMutex;
+	std::unordered_map<uint64_t, VkPipelineLayout> m_layouts;
+};
+
+#endif
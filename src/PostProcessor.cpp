@@ -0,0 +1,372 @@
+#include "PostProcessor.h"
+
+#include <stdexcept>
+
+namespace {
+    constexpr uint32_t PostWorkgroupSize = 8;
+
+    // matches the push constant block in shader/post.comp
+    struct PostPushConstants
+    {
+        float exposure;
+        int32_t blurRadius;
+    };
+
+    constexpr VkImageSubresourceRange ColorSubresourceRange{
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = 1, .baseArrayLayer = 0, .layerCount = 1};
+}
+
+PostProcessor::PostProcessor(VkDevice device, VulkanAllocator &allocator, ShaderModuleCache &shaderModules, VkPipelineCache pipelineCache,
+                             const uint32_t computeFamily, const uint32_t graphicsFamily, const std::vector<VkImage> &sceneImages,
+                             const VkFormat format, const VkExtent2D extent, const Settings settings)
+    : m_device(device), m_allocator(allocator), m_computeFamily(computeFamily), m_graphicsFamily(graphicsFamily),
+      m_format(format), m_extent(extent), m_settings(settings) {
+    CreateImages(sceneImages);
+    CreateDescriptors();
+    CreatePipeline(shaderModules, pipelineCache);
+    CreateCommandBuffers();
+}
+
+PostProcessor::~PostProcessor() {
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
+
+    for (auto &frame : m_frames) {
+        vkDestroyCommandPool(m_device, frame.commandPool, nullptr);
+        vkDestroyImageView(m_device, frame.outputView, nullptr);
+        vkDestroyImageView(m_device, frame.sceneView, nullptr);
+        m_allocator.DestroyImage(frame.outputImage, frame.outputAllocation);
+    }
+}
+
+void PostProcessor::RecordRelease(VkCommandBuffer commandBuffer, const size_t frame) const {
+    if (!IsAsync()) return;
+
+    // the render pass made the color writes available to the transfer stage, this chains onto it; the access
+    // masks of the destination half are ignored on a release
+    VkImageMemoryBarrier releaseBarrier{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = 0,
+            .dstAccessMask = 0,
+            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .srcQueueFamilyIndex = m_graphicsFamily,
+            .dstQueueFamilyIndex = m_computeFamily,
+            .image = m_frames[frame].sceneImage,
+            .subresourceRange = ColorSubresourceRange};
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &releaseBarrier);
+}
+
+VkCommandBuffer PostProcessor::Record(const size_t frame, VkBuffer readbackBuffer) {
+    auto &resources = m_frames[frame];
+
+    // the frame's slot has completed on every timeline, nothing of the pool is in use any more
+    if (vkResetCommandPool(m_device, resources.commandPool, 0) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to reset post-processing command pool!");
+    }
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .pNext = nullptr,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            .pInheritanceInfo = nullptr};
+
+    const auto commandBuffer = resources.commandBuffer;
+    if (vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to begin recording post-processing command buffer!");
+    }
+
+    // the output of the previous use of this slot is not needed, hence UNDEFINED
+    VkImageMemoryBarrier inputBarriers[] = {
+            SceneBarrier(frame, 0, VK_ACCESS_SHADER_READ_BIT),
+            {
+                    .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                    .pNext = nullptr,
+                    .srcAccessMask = 0,
+                    .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                    .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                    .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .image = resources.outputImage,
+                    .subresourceRange = ColorSubresourceRange}};
+
+    // the timeline wait of the submission is at the compute shader stage, which this chains onto
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         0, nullptr, 0, nullptr, 2, inputBarriers);
+
+    PostPushConstants pushConstants{
+            .exposure = m_settings.exposure,
+            .blurRadius = m_settings.blurRadius};
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &resources.descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, (m_extent.width + PostWorkgroupSize - 1) / PostWorkgroupSize,
+                  (m_extent.height + PostWorkgroupSize - 1) / PostWorkgroupSize, 1);
+
+    // compute queues support transfers as well, so the result never goes back to the graphics queue
+    if (readbackBuffer != VK_NULL_HANDLE) {
+        VkImageMemoryBarrier outputBarrier{
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .pNext = nullptr,
+                .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+                .oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+                .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = resources.outputImage,
+                .subresourceRange = ColorSubresourceRange};
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &outputBarrier);
+
+        VkBufferImageCopy region{
+                .bufferOffset = 0,
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+                .imageOffset = {0, 0, 0},
+                .imageExtent = {m_extent.width, m_extent.height, 1}};
+
+        vkCmdCopyImageToBuffer(commandBuffer, resources.outputImage, VK_IMAGE_LAYOUT_GENERAL, readbackBuffer, 1, &region);
+
+        VkBufferMemoryBarrier hostReadBarrier{
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                .pNext = nullptr,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .buffer = readbackBuffer,
+                .offset = 0,
+                .size = VK_WHOLE_SIZE};
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                             0, nullptr, 1, &hostReadBarrier, 0, nullptr);
+    }
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record post-processing command buffer!");
+    }
+
+    return commandBuffer;
+}
+
+VkImageMemoryBarrier PostProcessor::SceneBarrier(const size_t frame, const VkAccessFlags srcAccessMask, const VkAccessFlags dstAccessMask) const {
+    // the scene image goes back to the graphics queue without a transfer, its render pass starts from UNDEFINED
+    return {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = srcAccessMask,
+            .dstAccessMask = dstAccessMask,
+            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .srcQueueFamilyIndex = IsAsync() ? m_graphicsFamily : VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = IsAsync() ? m_computeFamily : VK_QUEUE_FAMILY_IGNORED,
+            .image = m_frames[frame].sceneImage,
+            .subresourceRange = ColorSubresourceRange};
+}
+
+void PostProcessor::CreateImages(const std::vector<VkImage> &sceneImages) {
+    m_frames.resize(sceneImages.size());
+
+    for (size_t i = 0; i < m_frames.size(); ++i) {
+        auto &frame = m_frames[i];
+        frame.sceneImage = sceneImages[i];
+
+        // only ever touched by the post-processing queue, so it needs no ownership transfers of its own
+        VkImageCreateInfo imageCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .imageType = VK_IMAGE_TYPE_2D,
+                .format = m_format,
+                .extent = {m_extent.width, m_extent.height, 1},
+                .mipLevels = 1,
+                .arrayLayers = 1,
+                .samples = VK_SAMPLE_COUNT_1_BIT,
+                .tiling = VK_IMAGE_TILING_OPTIMAL,
+                .usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                .queueFamilyIndexCount = 0,
+                .pQueueFamilyIndices = nullptr,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+
+        frame.outputImage = m_allocator.CreateImage(imageCreateInfo, MemoryUsage::GpuOnly, frame.outputAllocation);
+
+        VkImageViewCreateInfo viewCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .image = frame.sceneImage,
+                .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                .format = m_format,
+                .components = {VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY},
+                .subresourceRange = ColorSubresourceRange};
+
+        if (vkCreateImageView(m_device, &viewCreateInfo, nullptr, &frame.sceneView) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create post-processing image view!");
+        }
+
+        viewCreateInfo.image = frame.outputImage;
+        if (vkCreateImageView(m_device, &viewCreateInfo, nullptr, &frame.outputView) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create post-processing image view!");
+        }
+    }
+}
+
+void PostProcessor::CreateDescriptors() {
+    VkDescriptorSetLayoutBinding bindings[2];
+    for (uint32_t i = 0; i < 2; ++i) {
+        bindings[i] = {
+                .binding = i,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = nullptr};
+    }
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .bindingCount = 2,
+            .pBindings = bindings};
+
+    if (vkCreateDescriptorSetLayout(m_device, &descriptorSetLayoutCreateInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create post-processing descriptor set layout!");
+    }
+
+    const auto frameCount = static_cast<uint32_t>(m_frames.size());
+
+    VkDescriptorPoolSize poolSize{
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 2 * frameCount};
+
+    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .maxSets = frameCount,
+            .poolSizeCount = 1,
+            .pPoolSizes = &poolSize};
+
+    if (vkCreateDescriptorPool(m_device, &descriptorPoolCreateInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create post-processing descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> setLayouts(frameCount, m_descriptorSetLayout);
+    std::vector<VkDescriptorSet> descriptorSets(frameCount);
+
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .descriptorPool = m_descriptorPool,
+            .descriptorSetCount = frameCount,
+            .pSetLayouts = setLayouts.data()};
+
+    if (vkAllocateDescriptorSets(m_device, &descriptorSetAllocateInfo, descriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate post-processing descriptor sets!");
+    }
+
+    for (size_t i = 0; i < m_frames.size(); ++i) {
+        auto &frame = m_frames[i];
+        frame.descriptorSet = descriptorSets[i];
+
+        VkDescriptorImageInfo imageInfos[] = {
+                {.sampler = VK_NULL_HANDLE, .imageView = frame.sceneView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL},
+                {.sampler = VK_NULL_HANDLE, .imageView = frame.outputView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL}};
+
+        VkWriteDescriptorSet writes[2];
+        for (uint32_t binding = 0; binding < 2; ++binding) {
+            writes[binding] = {
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .pNext = nullptr,
+                    .dstSet = frame.descriptorSet,
+                    .dstBinding = binding,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                    .pImageInfo = &imageInfos[binding],
+                    .pBufferInfo = nullptr,
+                    .pTexelBufferView = nullptr};
+        }
+
+        vkUpdateDescriptorSets(m_device, 2, writes, 0, nullptr);
+    }
+}
+
+void PostProcessor::CreatePipeline(ShaderModuleCache &shaderModules, VkPipelineCache pipelineCache) {
+    VkPushConstantRange pushConstantRange{
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(PostPushConstants)};
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .setLayoutCount = 1,
+            .pSetLayouts = &m_descriptorSetLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange};
+
+    if (vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create post-processing pipeline layout!");
+    }
+
+    const auto shaderModule = shaderModules.Load("post.spv");
+
+    VkComputePipelineCreateInfo computePipelineCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .stage = {
+                    .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .pNext = nullptr,
+                    .flags = 0,
+                    .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .module = shaderModule,
+                    .pName = "main",
+                    .pSpecializationInfo = nullptr},
+            .layout = m_pipelineLayout,
+            .basePipelineHandle = VK_NULL_HANDLE,
+            .basePipelineIndex = -1};
+
+    if (vkCreateComputePipelines(m_device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &m_pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create post-processing pipeline!");
+    }
+}
+
+void PostProcessor::CreateCommandBuffers() {
+    // re-recorded every frame like the graphics command buffers, so every frame in flight owns a transient pool
+    VkCommandPoolCreateInfo commandPoolCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = m_computeFamily};
+
+    for (auto &frame : m_frames) {
+        if (vkCreateCommandPool(m_device, &commandPoolCreateInfo, nullptr, &frame.commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create post-processing command pool!");
+        }
+
+        VkCommandBufferAllocateInfo commandBufferAllocateInfo{
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .pNext = nullptr,
+                .commandPool = frame.commandPool,
+                .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                .commandBufferCount = 1};
+
+        if (vkAllocateCommandBuffers(m_device, &commandBufferAllocateInfo, &frame.commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate post-processing command buffer!");
+        }
+    }
+}
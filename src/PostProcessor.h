@@ -0,0 +1,81 @@
+#ifndef VULKANLEARNING_POSTPROCESSOR_H
+#define VULKANLEARNING_POSTPROCESSOR_H
+
+#include "VulkanAllocator.h"
+#include "ShaderModuleCache.h"
+
+#include <vector>
+
+// Compute post-processing of the headless frames (tonemap and a box blur) recorded into command buffers of its own
+// queue family. On a dedicated async compute family the pass of one frame overlaps the graphics work of the next:
+// the scene image is released by the graphics queue and acquired by the compute queue, the frame's graphics
+// timeline value orders the two. With computeFamily == graphicsFamily it runs on the graphics queue, without
+// ownership transfers, so both can be compared.
+// Every frame in flight owns one scene image, as headless mode has, and one output image.
+class PostProcessor
+{
+public:
+	struct Settings
+	{
+		float exposure = 1.5f;
+		// in pixels, 0 only tonemaps
+		int32_t blurRadius = 2;
+	};
+
+	// sceneImages are RGBA8 with storage usage, one per frame in flight
+	PostProcessor(VkDevice device, VulkanAllocator& allocator, ShaderModuleCache& shaderModules, VkPipelineCache pipelineCache,
+	              uint32_t computeFamily, uint32_t graphicsFamily, const std::vector<VkImage>& sceneImages, VkFormat format,
+	              VkExtent2D extent, Settings settings);
+	~PostProcessor();
+
+	PostProcessor(const PostProcessor&) = delete;
+	PostProcessor& operator=(const PostProcessor&) = delete;
+
+	// recorded into the graphics command buffer once the scene image of frame is in TRANSFER_SRC_OPTIMAL, does nothing
+	// when both run on the same family
+	void RecordRelease(VkCommandBuffer commandBuffer, size_t frame) const;
+	// records the post pass of frame and returns its command buffer, which has to wait for the frame's graphics
+	// submission at the compute shader stage; readbackBuffer receives the result when it is not null
+	VkCommandBuffer Record(size_t frame, VkBuffer readbackBuffer);
+
+	[[nodiscard]] bool IsAsync() const { return m_computeFamily != m_graphicsFamily; }
+	[[nodiscard]] uint32_t GetFamily() const { return m_computeFamily; }
+	[[nodiscard]] const Settings& GetSettings() const { return m_settings; }
+
+private:
+	struct FrameResources
+	{
+		VkImage sceneImage{};
+		VkImageView sceneView{};
+		VkImage outputImage{};
+		VulkanAllocation outputAllocation;
+		VkImageView outputView{};
+		VkDescriptorSet descriptorSet{};
+		VkCommandPool commandPool{};
+		VkCommandBuffer commandBuffer{};
+	};
+
+	void CreateImages(const std::vector<VkImage>& sceneImages);
+	void CreateDescriptors();
+	void CreatePipeline(ShaderModuleCache& shaderModules, VkPipelineCache pipelineCache);
+	void CreateCommandBuffers();
+	// the scene image barrier of the compute side, the acquire half of the ownership transfer on an async family
+	[[nodiscard]] VkImageMemoryBarrier SceneBarrier(size_t frame, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask) const;
+
+	VkDevice m_device;
+	VulkanAllocator& m_allocator;
+	uint32_t m_computeFamily;
+	uint32_t m_graphicsFamily;
+	VkFormat m_format;
+	VkExtent2D m_extent;
+	Settings m_settings;
+
+	VkDescriptorSetLayout m_descriptorSetLayout{};
+	VkDescriptorPool m_descriptorPool{};
+	VkPipelineLayout m_pipelineLayout{};
+	VkPipeline m_pipeline{};
+
+	std::vector<FrameResources> m_frames;
+};
+
+#endif
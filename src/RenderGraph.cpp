@@ -0,0 +1,522 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+    constexpr size_t NoTransient = std::numeric_limits<size_t>::max();
+
+    constexpr VkImageSubresourceRange ColorSubresourceRange{
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = 1, .baseArrayLayer = 0, .layerCount = 1};
+
+    struct UsageInfo
+    {
+        VkImageLayout layout;
+        VkPipelineStageFlags2 stageMask;
+        VkAccessFlags2 readAccess;
+        VkAccessFlags2 writeAccess;
+        VkImageUsageFlags imageUsage;
+    };
+
+    UsageInfo InfoOf(const RenderGraph::Usage usage) {
+        switch (usage) {
+            case RenderGraph::Usage::ColorAttachment:
+                return {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
+            case RenderGraph::Usage::TransferSrc:
+                return {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                        VK_ACCESS_2_TRANSFER_READ_BIT, VK_ACCESS_2_NONE, VK_IMAGE_USAGE_TRANSFER_SRC_BIT};
+            case RenderGraph::Usage::TransferDst:
+                return {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                        VK_ACCESS_2_NONE, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_USAGE_TRANSFER_DST_BIT};
+            case RenderGraph::Usage::ComputeStorage:
+                return {VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_2_SHADER_READ_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_USAGE_STORAGE_BIT};
+            default:
+                return {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+                        VK_ACCESS_2_SHADER_READ_BIT, VK_ACCESS_2_NONE, VK_IMAGE_USAGE_SAMPLED_BIT};
+        }
+    }
+
+    // what has happened to a resource so far: the last writes and the reads that were made to wait for them
+    struct TrackedState
+    {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags2 writeStages = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE;
+        VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 readAccess = VK_ACCESS_2_NONE;
+    };
+}
+
+void RenderGraph::PassBuilder::Read(const Resource resource, const Usage usage) {
+    m_graph.AddAccess(m_pass, resource, usage, false);
+}
+
+void RenderGraph::PassBuilder::Write(const Resource resource, const Usage usage) {
+    m_graph.AddAccess(m_pass, resource, usage, true);
+}
+
+void RenderGraph::PassBuilder::SideEffect() {
+    m_graph.m_passes[m_pass].sideEffect = true;
+}
+
+RenderGraph::RenderGraph(VkDevice device, VulkanAllocator &allocator, PFN_vkCmdPipelineBarrier2KHR pipelineBarrier2)
+    : m_device(device), m_allocator(allocator), m_pipelineBarrier2(pipelineBarrier2) {
+}
+
+RenderGraph::~RenderGraph() {
+    DestroyTransientImages();
+}
+
+void RenderGraph::Reset() {
+    m_resources.clear();
+    m_passes.clear();
+    m_transientOf.clear();
+}
+
+RenderGraph::Resource RenderGraph::ImportImage(std::string name, VkImage image, VkImageView view, const State initial, const State final) {
+    m_resources.push_back({.name = std::move(name), .imported = true, .image = image, .view = view, .initial = initial, .final = final});
+    return static_cast<Resource>(m_resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::ImportBuffer(std::string name, VkBuffer buffer, const State initial, const State final) {
+    m_resources.push_back({.name = std::move(name), .imported = true, .buffer = true, .vkBuffer = buffer, .initial = initial, .final = final});
+    return static_cast<Resource>(m_resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::CreateImage(std::string name, const ImageDesc desc) {
+    m_resources.push_back({.name = std::move(name), .desc = desc});
+    return static_cast<Resource>(m_resources.size() - 1);
+}
+
+void RenderGraph::AddPass(std::string name, const Setup &setup, Record record) {
+    m_passes.push_back({.name = std::move(name), .record = std::move(record)});
+
+    PassBuilder builder(*this, m_passes.size() - 1);
+    setup(builder);
+}
+
+void RenderGraph::AddAccess(const size_t pass, const Resource resource, const Usage usage, const bool write) {
+    if (resource >= m_resources.size()) {
+        throw std::runtime_error("Render graph pass uses an unknown resource!");
+    }
+
+    // a pass sees one state of every resource, two accesses would need a barrier inside the pass
+    auto &accesses = m_passes[pass].accesses;
+    if (std::any_of(accesses.begin(), accesses.end(), [resource](const Access &access) { return access.resource == resource; })) {
+        throw std::runtime_error("Render graph pass uses a resource twice!");
+    }
+
+    accesses.push_back({.resource = resource, .usage = usage, .write = write});
+}
+
+void RenderGraph::Compile() {
+    m_stats = {};
+    m_stats.passes = static_cast<uint32_t>(m_passes.size());
+
+    CullPasses();
+
+    for (size_t i = 0; i < m_passes.size(); ++i) {
+        if (!m_passes[i].alive) continue;
+
+        for (const auto &access : m_passes[i].accesses) {
+            auto &resource = m_resources[access.resource];
+            if (resource.imported) continue;
+
+            if (resource.firstPass < 0) {
+                resource.firstPass = static_cast<int>(i);
+            }
+            resource.lastPass = static_cast<int>(i);
+            resource.usage |= InfoOf(access.usage).imageUsage;
+        }
+    }
+
+    PlaceTransientImages();
+    BuildBarriers();
+}
+
+void RenderGraph::CullPasses() {
+    // walked backwards, a pass survives when it writes something the outside world or a surviving pass reads
+    std::vector<bool> needed(m_resources.size());
+    for (size_t i = 0; i < m_resources.size(); ++i) {
+        needed[i] = m_resources[i].imported;
+    }
+
+    for (size_t i = m_passes.size(); i-- > 0;) {
+        auto &pass = m_passes[i];
+        pass.alive = pass.sideEffect || std::any_of(pass.accesses.begin(), pass.accesses.end(), [&needed](const Access &access) {
+            return access.write && needed[access.resource];
+        });
+
+        if (!pass.alive) {
+            ++m_stats.culledPasses;
+            continue;
+        }
+
+        for (const auto &access : pass.accesses) {
+            if (!access.write) {
+                needed[access.resource] = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::PlaceTransientImages() {
+    std::vector<TransientImage> wanted;
+    m_transientOf.assign(m_resources.size(), NoTransient);
+    for (size_t i = 0; i < m_resources.size(); ++i) {
+        const auto &resource = m_resources[i];
+        if (resource.imported || resource.firstPass < 0) continue;
+
+        m_transientOf[i] = wanted.size();
+        wanted.push_back({.desc = resource.desc, .usage = resource.usage, .firstPass = resource.firstPass, .lastPass = resource.lastPass});
+    }
+
+    // the same transients with the same lifetimes as last frame keep their images and memory
+    const auto reusable = std::equal(wanted.begin(), wanted.end(), m_transientImages.begin(), m_transientImages.end(),
+                                     [](const TransientImage &a, const TransientImage &b) {
+                                         return a.desc.format == b.desc.format && a.desc.extent.width == b.desc.extent.width &&
+                                                a.desc.extent.height == b.desc.extent.height && a.usage == b.usage &&
+                                                a.firstPass == b.firstPass && a.lastPass == b.lastPass;
+                                     });
+
+    if (!reusable) {
+        DestroyTransientImages();
+        m_transientImages = std::move(wanted);
+
+        std::vector<VkMemoryRequirements> requirements(m_transientImages.size());
+        for (size_t i = 0; i < m_transientImages.size(); ++i) {
+            auto &transient = m_transientImages[i];
+
+            VkImageCreateInfo imageCreateInfo{
+                    .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                    .pNext = nullptr,
+                    .flags = 0,
+                    .imageType = VK_IMAGE_TYPE_2D,
+                    .format = transient.desc.format,
+                    .extent = {transient.desc.extent.width, transient.desc.extent.height, 1},
+                    .mipLevels = 1,
+                    .arrayLayers = 1,
+                    .samples = VK_SAMPLE_COUNT_1_BIT,
+                    .tiling = VK_IMAGE_TILING_OPTIMAL,
+                    .usage = transient.usage,
+                    .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                    .queueFamilyIndexCount = 0,
+                    .pQueueFamilyIndices = nullptr,
+                    .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+
+            if (vkCreateImage(m_device, &imageCreateInfo, nullptr, &transient.image) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create render graph image!");
+            }
+            vkGetImageMemoryRequirements(m_device, transient.image, &requirements[i]);
+            transient.size = requirements[i].size;
+        }
+
+        // largest first, each image goes into the first slot whose images all live in other passes
+        std::vector<size_t> order(m_transientImages.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&requirements](size_t a, size_t b) {
+            return requirements[a].size > requirements[b].size;
+        });
+
+        for (const auto index : order) {
+            const auto &transient = m_transientImages[index];
+            const auto &imageRequirements = requirements[index];
+
+            const auto fits = [this, &transient, &imageRequirements](const MemorySlot &slot) {
+                return (slot.requirements.memoryTypeBits & imageRequirements.memoryTypeBits) != 0 &&
+                       std::none_of(slot.images.begin(), slot.images.end(), [this, &transient](size_t other) {
+                           const auto &occupant = m_transientImages[other];
+                           return transient.firstPass <= occupant.lastPass && occupant.firstPass <= transient.lastPass;
+                       });
+            };
+
+            auto slot = std::find_if(m_memorySlots.begin(), m_memorySlots.end(), fits);
+            if (slot == m_memorySlots.end()) {
+                m_memorySlots.push_back({.requirements = imageRequirements});
+                slot = std::prev(m_memorySlots.end());
+            } else {
+                slot->requirements.size = std::max(slot->requirements.size, imageRequirements.size);
+                slot->requirements.alignment = std::max(slot->requirements.alignment, imageRequirements.alignment);
+                slot->requirements.memoryTypeBits &= imageRequirements.memoryTypeBits;
+            }
+            slot->images.push_back(index);
+            m_transientImages[index].slot = static_cast<size_t>(slot - m_memorySlots.begin());
+        }
+
+        for (auto &slot : m_memorySlots) {
+            slot.allocation = m_allocator.Allocate(slot.requirements, MemoryUsage::GpuOnly, false);
+
+            for (const auto index : slot.images) {
+                if (vkBindImageMemory(m_device, m_transientImages[index].image, slot.allocation.memory, slot.allocation.offset) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to bind render graph image memory!");
+                }
+            }
+        }
+
+        for (auto &transient : m_transientImages) {
+            VkImageViewCreateInfo viewCreateInfo{
+                    .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                    .pNext = nullptr,
+                    .flags = 0,
+                    .image = transient.image,
+                    .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                    .format = transient.desc.format,
+                    .components = {VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY},
+                    .subresourceRange = ColorSubresourceRange};
+
+            if (vkCreateImageView(m_device, &viewCreateInfo, nullptr, &transient.view) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create render graph image view!");
+            }
+        }
+    }
+
+    m_stats.transientImages = static_cast<uint32_t>(m_transientImages.size());
+    for (const auto &transient : m_transientImages) {
+        m_stats.transientBytes += transient.size;
+    }
+    for (const auto &slot : m_memorySlots) {
+        m_stats.allocatedBytes += slot.requirements.size;
+    }
+}
+
+void RenderGraph::DestroyTransientImages() {
+    for (const auto &transient : m_transientImages) {
+        vkDestroyImageView(m_device, transient.view, nullptr);
+        vkDestroyImage(m_device, transient.image, nullptr);
+    }
+    for (auto &slot : m_memorySlots) {
+        m_allocator.Free(slot.allocation);
+    }
+
+    m_transientImages.clear();
+    m_memorySlots.clear();
+}
+
+void RenderGraph::BuildBarriers() {
+    m_imageBarriers.clear();
+    m_bufferBarriers.clear();
+
+    std::vector<TrackedState> states(m_resources.size());
+    for (size_t i = 0; i < m_resources.size(); ++i) {
+        const auto &resource = m_resources[i];
+        if (resource.imported) {
+            // whatever happened before the graph counts as a write that has to be waited for
+            states[i] = {.layout = resource.initial.layout, .writeStages = resource.initial.stageMask, .writeAccess = resource.initial.accessMask};
+        }
+    }
+    // how each memory slot was left by its last image, the next image placed in it starts from there
+    std::vector<TrackedState> slotStates(m_memorySlots.size());
+
+    const auto addBarrier = [this](Resource index, const TrackedState &before, VkPipelineStageFlags2 srcStageMask, VkImageLayout layout,
+                                   VkPipelineStageFlags2 dstStageMask, VkAccessFlags2 dstAccessMask) {
+        const auto &resource = m_resources[index];
+        if (resource.buffer) {
+            m_bufferBarriers.push_back({
+                    .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+                    .pNext = nullptr,
+                    .srcStageMask = srcStageMask,
+                    .srcAccessMask = before.writeAccess,
+                    .dstStageMask = dstStageMask,
+                    .dstAccessMask = dstAccessMask,
+                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .buffer = resource.vkBuffer,
+                    .offset = 0,
+                    .size = VK_WHOLE_SIZE});
+            return;
+        }
+
+        m_imageBarriers.push_back({
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+                .pNext = nullptr,
+                .srcStageMask = srcStageMask,
+                .srcAccessMask = before.writeAccess,
+                .dstStageMask = dstStageMask,
+                .dstAccessMask = dstAccessMask,
+                .oldLayout = before.layout,
+                .newLayout = layout,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = GetImage(index),
+                .subresourceRange = ColorSubresourceRange});
+    };
+
+    const auto beginBatch = [this](BarrierBatch &batch) {
+        batch.firstImageBarrier = m_imageBarriers.size();
+        batch.firstBufferBarrier = m_bufferBarriers.size();
+    };
+    const auto endBatch = [this](BarrierBatch &batch) {
+        batch.imageBarrierCount = m_imageBarriers.size() - batch.firstImageBarrier;
+        batch.bufferBarrierCount = m_bufferBarriers.size() - batch.firstBufferBarrier;
+        if (batch.imageBarrierCount + batch.bufferBarrierCount > 0) {
+            ++m_stats.barrierBatches;
+        }
+    };
+
+    for (size_t i = 0; i < m_passes.size(); ++i) {
+        auto &pass = m_passes[i];
+        if (!pass.alive) continue;
+
+        beginBatch(pass.barriers);
+        for (const auto &access : pass.accesses) {
+            const auto &resource = m_resources[access.resource];
+            const auto transient = m_transientOf[access.resource];
+            auto &state = states[access.resource];
+
+            if (transient != NoTransient && resource.firstPass == static_cast<int>(i)) {
+                // the contents are undefined, but the image before it in the same memory may still be in use
+                const auto &previous = slotStates[m_transientImages[transient].slot];
+                state = {.writeStages = previous.writeStages | previous.readStages, .writeAccess = previous.writeAccess};
+            }
+
+            const auto info = InfoOf(access.usage);
+            const auto layout = resource.buffer ? VK_IMAGE_LAYOUT_UNDEFINED : info.layout;
+            const auto accessMask = access.write ? info.writeAccess : info.readAccess;
+
+            if (access.write || state.layout != layout) {
+                // write after write, write after read or a layout transition, which is a write as well
+                if (state.layout != layout || state.writeStages != 0 || state.readStages != 0) {
+                    addBarrier(access.resource, state, state.writeStages | state.readStages, layout, info.stageMask, accessMask);
+                }
+                state = {.layout = layout, .writeStages = info.stageMask, .writeAccess = access.write ? accessMask : VK_ACCESS_2_NONE,
+                         .readStages = access.write ? VK_PIPELINE_STAGE_2_NONE : info.stageMask,
+                         .readAccess = access.write ? VK_ACCESS_2_NONE : accessMask};
+            } else {
+                // read after write, unless an earlier read already waited at the same stage with the same access
+                const auto covered = (info.stageMask & ~state.readStages) == 0 && (accessMask & ~state.readAccess) == 0;
+                if (state.writeStages != 0 && !covered) {
+                    addBarrier(access.resource, state, state.writeStages, layout, info.stageMask, accessMask);
+                }
+                state.readStages |= info.stageMask;
+                state.readAccess |= accessMask;
+            }
+        }
+        endBatch(pass.barriers);
+
+        m_stats.naiveBarriers += static_cast<uint32_t>(pass.accesses.size());
+        for (const auto &access : pass.accesses) {
+            const auto transient = m_transientOf[access.resource];
+            if (transient != NoTransient && m_resources[access.resource].lastPass == static_cast<int>(i)) {
+                slotStates[m_transientImages[transient].slot] = states[access.resource];
+            }
+        }
+    }
+
+    beginBatch(m_finalBarriers);
+    for (size_t i = 0; i < m_resources.size(); ++i) {
+        const auto &resource = m_resources[i];
+        if (!resource.imported) continue;
+
+        ++m_stats.naiveBarriers;
+        const auto &state = states[i];
+        const auto layout = resource.buffer ? VK_IMAGE_LAYOUT_UNDEFINED : resource.final.layout;
+        if (state.layout != layout || (state.writeAccess != 0 && resource.final.stageMask != 0)) {
+            addBarrier(static_cast<Resource>(i), state, state.writeStages | state.readStages, layout, resource.final.stageMask, resource.final.accessMask);
+        }
+    }
+    endBatch(m_finalBarriers);
+
+    m_stats.barriers = static_cast<uint32_t>(m_imageBarriers.size() + m_bufferBarriers.size());
+}
+
+void RenderGraph::Execute(VkCommandBuffer commandBuffer) const {
+    for (const auto &pass : m_passes) {
+        if (!pass.alive) continue;
+
+        RecordBarriers(commandBuffer, pass.barriers);
+        pass.record(commandBuffer);
+    }
+    RecordBarriers(commandBuffer, m_finalBarriers);
+}
+
+void RenderGraph::RecordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch &batch) const {
+    if (batch.imageBarrierCount + batch.bufferBarrierCount == 0) return;
+
+    if (m_pipelineBarrier2 != nullptr) {
+        VkDependencyInfo dependencyInfo{
+                .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+                .pNext = nullptr,
+                .dependencyFlags = 0,
+                .memoryBarrierCount = 0,
+                .pMemoryBarriers = nullptr,
+                .bufferMemoryBarrierCount = static_cast<uint32_t>(batch.bufferBarrierCount),
+                .pBufferMemoryBarriers = m_bufferBarriers.data() + batch.firstBufferBarrier,
+                .imageMemoryBarrierCount = static_cast<uint32_t>(batch.imageBarrierCount),
+                .pImageMemoryBarriers = m_imageBarriers.data() + batch.firstImageBarrier};
+
+        m_pipelineBarrier2(commandBuffer, &dependencyInfo);
+        return;
+    }
+
+    // the graph only uses stages and accesses that have the same bit in both versions, the per barrier stages are merged
+    VkPipelineStageFlags srcStageMask = 0;
+    VkPipelineStageFlags dstStageMask = 0;
+
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    imageBarriers.reserve(batch.imageBarrierCount);
+    for (size_t i = 0; i < batch.imageBarrierCount; ++i) {
+        const auto &barrier = m_imageBarriers[batch.firstImageBarrier + i];
+        srcStageMask |= static_cast<VkPipelineStageFlags>(barrier.srcStageMask);
+        dstStageMask |= static_cast<VkPipelineStageFlags>(barrier.dstStageMask);
+        imageBarriers.push_back({
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .pNext = nullptr,
+                .srcAccessMask = static_cast<VkAccessFlags>(barrier.srcAccessMask),
+                .dstAccessMask = static_cast<VkAccessFlags>(barrier.dstAccessMask),
+                .oldLayout = barrier.oldLayout,
+                .newLayout = barrier.newLayout,
+                .srcQueueFamilyIndex = barrier.srcQueueFamilyIndex,
+                .dstQueueFamilyIndex = barrier.dstQueueFamilyIndex,
+                .image = barrier.image,
+                .subresourceRange = barrier.subresourceRange});
+    }
+
+    std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    bufferBarriers.reserve(batch.bufferBarrierCount);
+    for (size_t i = 0; i < batch.bufferBarrierCount; ++i) {
+        const auto &barrier = m_bufferBarriers[batch.firstBufferBarrier + i];
+        srcStageMask |= static_cast<VkPipelineStageFlags>(barrier.srcStageMask);
+        dstStageMask |= static_cast<VkPipelineStageFlags>(barrier.dstStageMask);
+        bufferBarriers.push_back({
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                .pNext = nullptr,
+                .srcAccessMask = static_cast<VkAccessFlags>(barrier.srcAccessMask),
+                .dstAccessMask = static_cast<VkAccessFlags>(barrier.dstAccessMask),
+                .srcQueueFamilyIndex = barrier.srcQueueFamilyIndex,
+                .dstQueueFamilyIndex = barrier.dstQueueFamilyIndex,
+                .buffer = barrier.buffer,
+                .offset = barrier.offset,
+                .size = barrier.size});
+    }
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         srcStageMask != 0 ? srcStageMask : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT),
+                         dstStageMask != 0 ? dstStageMask : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT), 0,
+                         0, nullptr,
+                         static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+                         static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
+VkImage RenderGraph::GetImage(const Resource resource) const {
+    const auto &node = m_resources[resource];
+    if (node.imported) return node.image;
+
+    const auto transient = resource < m_transientOf.size() ? m_transientOf[resource] : NoTransient;
+    return transient != NoTransient ? m_transientImages[transient].image : VK_NULL_HANDLE;
+}
+
+VkImageView RenderGraph::GetImageView(const Resource resource) const {
+    const auto &node = m_resources[resource];
+    if (node.imported) return node.view;
+
+    const auto transient = resource < m_transientOf.size() ? m_transientOf[resource] : NoTransient;
+    return transient != NoTransient ? m_transientImages[transient].view : VK_NULL_HANDLE;
+}
+
+VkBuffer RenderGraph::GetBuffer(const Resource resource) const {
+    return m_resources[resource].vkBuffer;
+}
@@ -0,0 +1,202 @@
+#ifndef VULKANLEARNING_RENDERGRAPH_H
+#define VULKANLEARNING_RENDERGRAPH_H
+
+#include "VulkanAllocator.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Declarative frame description: passes say which images and buffers they read and write, Compile() culls the
+// passes nothing depends on, works out the barriers between the rest and places the transient images, and
+// Execute() records barriers and passes in order. Every pass gets at most one batched vkCmdPipelineBarrier2
+// (vkCmdPipelineBarrier without synchronization2), and only for real hazards or layout changes; reads that
+// follow reads in the same layout need none. Transient images whose lifetimes do not overlap share memory.
+// Rebuilt every frame, while the transient images and their memory are kept for as long as the same
+// transients with the same lifetimes are declared. One graph per frame in flight, the transients of a frame
+// may only be replaced once the GPU is done with it.
+class RenderGraph
+{
+public:
+	using Resource = uint32_t;
+
+	// how a pass touches a resource, which decides the layout, stages and access and the usage of transient images
+	enum class Usage : uint32_t
+	{
+		ColorAttachment,
+		TransferSrc,
+		TransferDst,
+		// storage image or buffer in a compute shader
+		ComputeStorage,
+		// sampled image in a fragment shader
+		FragmentSampled
+	};
+
+	struct State
+	{
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags2 stageMask = VK_PIPELINE_STAGE_2_NONE;
+		VkAccessFlags2 accessMask = VK_ACCESS_2_NONE;
+	};
+
+	struct ImageDesc
+	{
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkExtent2D extent{};
+	};
+
+	struct Stats
+	{
+		uint32_t passes = 0;
+		uint32_t culledPasses = 0;
+		uint32_t barriers = 0;
+		// one barrier per access of every pass plus the final transitions, what tracking nothing would emit
+		uint32_t naiveBarriers = 0;
+		uint32_t barrierBatches = 0;
+		uint32_t transientImages = 0;
+		// the transient images' sizes added up, against the memory they were placed in
+		VkDeviceSize transientBytes = 0;
+		VkDeviceSize allocatedBytes = 0;
+	};
+
+	class PassBuilder
+	{
+	public:
+		void Read(Resource resource, Usage usage);
+		void Write(Resource resource, Usage usage);
+		// keeps the pass even though nothing in the graph reads what it writes
+		void SideEffect();
+
+	private:
+		friend class RenderGraph;
+
+		PassBuilder(RenderGraph& graph, size_t pass) : m_graph(graph), m_pass(pass) {}
+
+		RenderGraph& m_graph;
+		size_t m_pass;
+	};
+
+	using Setup = std::function<void(PassBuilder&)>;
+	using Record = std::function<void(VkCommandBuffer)>;
+
+	// pipelineBarrier2 is vkCmdPipelineBarrier2(KHR), nullptr records vkCmdPipelineBarrier with the same masks
+	RenderGraph(VkDevice device, VulkanAllocator& allocator, PFN_vkCmdPipelineBarrier2KHR pipelineBarrier2);
+	~RenderGraph();
+
+	RenderGraph(const RenderGraph&) = delete;
+	RenderGraph& operator=(const RenderGraph&) = delete;
+
+	// forgets the passes and resources of the last frame, keeps the transient images
+	void Reset();
+
+	// initial is the state the resource is in before the graph runs, final the one it is left in
+	Resource ImportImage(std::string name, VkImage image, VkImageView view, State initial, State final);
+	Resource ImportBuffer(std::string name, VkBuffer buffer, State initial, State final);
+	// a color image that only lives inside the graph, its contents are undefined before its first write
+	Resource CreateImage(std::string name, ImageDesc desc);
+
+	// setup runs right away, record when the graph is executed
+	void AddPass(std::string name, const Setup& setup, Record record);
+
+	void Compile();
+	void Execute(VkCommandBuffer commandBuffer) const;
+
+	// valid between Compile() and the next Reset()
+	[[nodiscard]] VkImage GetImage(Resource resource) const;
+	[[nodiscard]] VkImageView GetImageView(Resource resource) const;
+	[[nodiscard]] VkBuffer GetBuffer(Resource resource) const;
+
+	[[nodiscard]] Stats GetStats() const { return m_stats; }
+	[[nodiscard]] bool UsesSynchronization2() const { return m_pipelineBarrier2 != nullptr; }
+
+private:
+	struct ResourceNode
+	{
+		std::string name;
+		bool imported = false;
+		bool buffer = false;
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkBuffer vkBuffer = VK_NULL_HANDLE;
+		State initial;
+		State final;
+		// transient images only
+		ImageDesc desc;
+		VkImageUsageFlags usage = 0;
+		int firstPass = -1;
+		int lastPass = -1;
+	};
+
+	struct Access
+	{
+		Resource resource;
+		Usage usage;
+		bool write;
+	};
+
+	struct BarrierBatch
+	{
+		size_t firstImageBarrier = 0;
+		size_t imageBarrierCount = 0;
+		size_t firstBufferBarrier = 0;
+		size_t bufferBarrierCount = 0;
+	};
+
+	struct PassNode
+	{
+		std::string name;
+		std::vector<Access> accesses;
+		bool sideEffect = false;
+		bool alive = false;
+		Record record;
+		BarrierBatch barriers;
+	};
+
+	struct TransientImage
+	{
+		ImageDesc desc;
+		VkImageUsageFlags usage = 0;
+		int firstPass = -1;
+		int lastPass = -1;
+		VkDeviceSize size = 0;
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		size_t slot = 0;
+	};
+
+	// memory shared by transient images whose lifetimes do not overlap
+	struct MemorySlot
+	{
+		VkMemoryRequirements requirements{};
+		VulkanAllocation allocation;
+		std::vector<size_t> images;
+	};
+
+	void AddAccess(size_t pass, Resource resource, Usage usage, bool write);
+	void CullPasses();
+	void PlaceTransientImages();
+	void DestroyTransientImages();
+	void BuildBarriers();
+	void RecordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch) const;
+
+	VkDevice m_device;
+	VulkanAllocator& m_allocator;
+	PFN_vkCmdPipelineBarrier2KHR m_pipelineBarrier2;
+
+	std::vector<ResourceNode> m_resources;
+	std::vector<PassNode> m_passes;
+	// transient resource index to its entry in m_transientImages
+	std::vector<size_t> m_transientOf;
+
+	std::vector<TransientImage> m_transientImages;
+	std::vector<MemorySlot> m_memorySlots;
+
+	std::vector<VkImageMemoryBarrier2> m_imageBarriers;
+	std::vector<VkBufferMemoryBarrier2> m_bufferBarriers;
+	// into the final states, after the last pass
+	BarrierBatch m_finalBarriers;
+
+	Stats m_stats;
+};
+
+#endif
@@ -0,0 +1,122 @@
+#include "ShaderHotReloader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace {
+    // editors save with several writes and renames, they are gathered into one rebuild
+    constexpr int DEBOUNCE_MS = 50;
+    // how often the watcher thread looks at m_stopping
+    constexpr int POLL_INTERVAL_MS = 200;
+
+    std::string ShellQuote(const std::string &value) {
+        std::string quoted = "'";
+        for (const auto c : value) {
+            if (c == '\'') {
+                quoted += "'\\''";
+            } else {
+                quoted += c;
+            }
+        }
+        return quoted + "'";
+    }
+}
+
+ShaderHotReloader::ShaderHotReloader(std::string shaderDirectory, std::vector<Source> sources,
+                                     std::function<void(const std::vector<std::string> &)> onCompiled)
+    : m_directory(std::move(shaderDirectory)), m_sources(std::move(sources)), m_onCompiled(std::move(onCompiled)) {
+    if (!m_directory.empty() && m_directory.back() != '/') {
+        m_directory += '/';
+    }
+
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify < 0) {
+        throw std::runtime_error("Failed to initialize inotify!");
+    }
+
+    // the directory rather than the files, so that saves which replace the file by a rename are seen too
+    if (inotify_add_watch(m_inotify, m_directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(m_inotify);
+        throw std::runtime_error("Failed to watch shader directory " + m_directory + "!");
+    }
+
+    m_thread = std::thread([this] { WatchLoop(); });
+}
+
+ShaderHotReloader::~ShaderHotReloader() {
+    m_stopping = true;
+    m_thread.join();
+    close(m_inotify);
+}
+
+void ShaderHotReloader::WatchLoop() {
+    while (!m_stopping) {
+        auto changed = ReadChangedSources(POLL_INTERVAL_MS);
+        if (changed.empty()) continue;
+
+        for (auto more = ReadChangedSources(DEBOUNCE_MS); !more.empty(); more = ReadChangedSources(DEBOUNCE_MS)) {
+            changed.insert(changed.end(), more.begin(), more.end());
+        }
+
+        std::vector<std::string> compiled;
+        for (const auto &source : m_sources) {
+            if (std::find(changed.begin(), changed.end(), source.glsl) != changed.end() && Compile(source)) {
+                compiled.push_back(source.spirv);
+            }
+        }
+
+        if (!compiled.empty()) {
+            m_onCompiled(compiled);
+        }
+    }
+}
+
+std::vector<std::string> ShaderHotReloader::ReadChangedSources(const int timeoutMs) const {
+    pollfd pollFd{.fd = m_inotify, .events = POLLIN, .revents = 0};
+    if (poll(&pollFd, 1, timeoutMs) <= 0) return {};
+
+    std::vector<std::string> changed;
+    alignas(inotify_event) char buffer[4096];
+    for (ssize_t size = read(m_inotify, buffer, sizeof(buffer)); size > 0; size = read(m_inotify, buffer, sizeof(buffer))) {
+        for (ssize_t offset = 0; offset < size;) {
+            const auto event = reinterpret_cast<const inotify_event *>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+            if (event->len == 0) continue;
+
+            const std::string name = event->name;
+            const auto watched = std::any_of(m_sources.begin(), m_sources.end(), [&name](const Source &source) { return source.glsl == name; });
+            if (watched) {
+                changed.push_back(name);
+            }
+        }
+    }
+    return changed;
+}
+
+bool ShaderHotReloader::Compile(const Source &source) const {
+    const auto output = m_directory + source.spirv;
+    const auto temporary = output + ".tmp";
+    const auto command = "glslc " + ShellQuote(m_directory + source.glsl) + " -o " + ShellQuote(temporary);
+
+    if (std::system(command.c_str()) != 0) {
+        std::cerr << "Failed to compile " << source.glsl << ", keeping the previous " << source.spirv << std::endl;
+        std::remove(temporary.c_str());
+        return false;
+    }
+
+    if (std::rename(temporary.c_str(), output.c_str()) != 0) {
+        std::cerr << "Failed to replace " << output << std::endl;
+        return false;
+    }
+
+    std::cout << "Recompiled " << source.glsl << std::endl;
+    return true;
+}
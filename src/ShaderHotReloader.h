@@ -0,0 +1,46 @@
+#ifndef VULKANLEARNING_SHADERHOTRELOADER_H
+#define VULKANLEARNING_SHADERHOTRELOADER_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Watches GLSL sources with inotify and recompiles them with glslc on a background thread.
+// The SPIR-V is written to a temporary file and renamed over the old one, so a reader never sees half a file.
+class ShaderHotReloader
+{
+public:
+	struct Source
+	{
+		// file names relative to the shader directory, e.g. "shader.vert" compiled to "vert.spv"
+		std::string glsl;
+		std::string spirv;
+	};
+
+	// onCompiled runs on the watcher thread with the SPIR-V outputs that were rebuilt, a failed
+	// compilation prints glslc's diagnostics and keeps the previous SPIR-V
+	ShaderHotReloader(std::string shaderDirectory, std::vector<Source> sources,
+	                  std::function<void(const std::vector<std::string>&)> onCompiled);
+	~ShaderHotReloader();
+
+	ShaderHotReloader(const ShaderHotReloader&) = delete;
+	ShaderHotReloader& operator=(const ShaderHotReloader&) = delete;
+
+private:
+	void WatchLoop();
+	// names of the watched sources among the pending inotify events, waits up to timeoutMs for the first one
+	[[nodiscard]] std::vector<std::string> ReadChangedSources(int timeoutMs) const;
+	[[nodiscard]] bool Compile(const Source& source) const;
+
+	std::string m_directory;
+	std::vector<Source> m_sources;
+	std::function<void(const std::vector<std::string>&)> m_onCompiled;
+
+	int m_inotify = -1;
+	std::atomic<bool> m_stopping{false};
+	std::thread m_thread;
+};
+
+#endif
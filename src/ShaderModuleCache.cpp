@@ -0,0 +1,158 @@
+#include "ShaderModuleCache.h"
+
+#include <cstring>
+
+namespace {
+    // little endian "SPVA"
+    constexpr uint32_t ArchiveMagic = 0x41565053;
+    constexpr uint32_t ArchiveVersion = 1;
+
+    struct ArchiveHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t reserved;
+    };
+
+    // offsets are from the start of the file, code is 16-byte aligned
+    struct ArchiveIndexEntry {
+        uint32_t nameOffset;
+        uint32_t nameSize;
+        uint32_t codeOffset;
+        uint32_t codeSize;
+    };
+}
+
+ShaderModuleCache::ShaderModuleCache(VkDevice device, std::string shaderDirectory)
+    : m_device(device), m_directory(std::move(shaderDirectory)) {
+    if (!m_directory.empty() && m_directory.back() != '/') {
+        m_directory += '/';
+    }
+
+    const auto archivePath = m_directory + ArchiveName;
+    if (access(archivePath.c_str(), R_OK) == 0) {
+        OpenArchive(archivePath);
+    }
+}
+
+ShaderModuleCache::~ShaderModuleCache() {
+    for (const auto &[hash, module] : m_modules) {
+        vkDestroyShaderModule(m_device, module.shaderModule, nullptr);
+    }
+}
+
+void ShaderModuleCache::OpenArchive(const std::string &path) {
+    m_archive = MappedFile(path);
+
+    const auto data = m_archive.GetData();
+    const auto size = m_archive.GetSize();
+
+    ArchiveHeader header{};
+    if (size < sizeof(header)) {
+        throw std::runtime_error("Shader archive " + path + " is truncated!");
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != ArchiveMagic || header.version != ArchiveVersion) {
+        throw std::runtime_error("Shader archive " + path + " has an unknown format!");
+    }
+    if (header.entryCount > (size - sizeof(header)) / sizeof(ArchiveIndexEntry)) {
+        throw std::runtime_error("Shader archive " + path + " is truncated!");
+    }
+
+    for (uint32_t i = 0; i < header.entryCount; ++i) {
+        ArchiveIndexEntry entry{};
+        std::memcpy(&entry, data + sizeof(header) + i * sizeof(entry), sizeof(entry));
+
+        if (static_cast<uint64_t>(entry.nameOffset) + entry.nameSize > size ||
+            static_cast<uint64_t>(entry.codeOffset) + entry.codeSize > size) {
+            throw std::runtime_error("Shader archive " + path + " has an entry outside of the file!");
+        }
+
+        const std::string_view name(reinterpret_cast<const char *>(data + entry.nameOffset), entry.nameSize);
+        const auto code = data + entry.codeOffset;
+        validateSpirv(code, entry.codeSize, path + ":" + std::string(name));
+
+        m_archiveEntries[name] = {reinterpret_cast<const uint32_t *>(code), entry.codeSize};
+    }
+}
+
+VkShaderModule ShaderModuleCache::Load(const std::string &name) {
+    const auto entry = m_archiveEntries.find(name);
+    if (entry == m_archiveEntries.end()) {
+        return LoadFile(name);
+    }
+
+    return GetOrCreate(entry->second.code, entry->second.size);
+}
+
+VkShaderModule ShaderModuleCache::LoadFile(const std::string &name) {
+    const auto path = m_directory + name;
+    const MappedFile file(path);
+    validateSpirv(file.GetData(), file.GetSize(), path);
+
+    return GetOrCreate(reinterpret_cast<const uint32_t *>(file.GetData()), file.GetSize());
+}
+
+VkShaderModule ShaderModuleCache::CreateFromFile(const std::string &name, uint64_t &hash) const {
+    const auto path = m_directory + name;
+    const MappedFile file(path);
+    validateSpirv(file.GetData(), file.GetSize(), path);
+
+    hash = Hash(file.GetData(), file.GetSize());
+    return createShaderModule(m_device, reinterpret_cast<const uint32_t *>(file.GetData()), file.GetSize());
+}
+
+VkShaderModule ShaderModuleCache::GetOrCreate(const uint32_t *code, const size_t size) {
+    const auto hash = Hash(code, size);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto found = m_modules.find(hash);
+        if (found != m_modules.end()) {
+            if (found->second.size != size) {
+                throw std::runtime_error("Shader modules of different code share a hash!");
+            }
+            return found->second.shaderModule;
+        }
+    }
+
+    // created outside of the lock, so that threads creating different modules do not serialize
+    auto shaderModule = createShaderModule(m_device, code, size);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto [inserted, isNew] = m_modules.emplace(hash, Module{.shaderModule = shaderModule, .size = size});
+    if (isNew) {
+        m_hashes.emplace(shaderModule, hash);
+    } else {
+        // another thread created the same module first, or one of different code has the same hash
+        vkDestroyShaderModule(m_device, shaderModule, nullptr);
+        if (inserted->second.size != size) {
+            throw std::runtime_error("Shader modules of different code share a hash!");
+        }
+    }
+    return inserted->second.shaderModule;
+}
+
+uint64_t ShaderModuleCache::GetHash(VkShaderModule shaderModule) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto found = m_hashes.find(shaderModule);
+    if (found == m_hashes.end()) {
+        throw std::runtime_error("Shader module does not belong to this cache!");
+    }
+    return found->second;
+}
+
+size_t ShaderModuleCache::GetModuleCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_modules.size();
+}
+
+uint64_t ShaderModuleCache::Hash(const void *data, const size_t size) {
+    auto hash = 0xcbf29ce484222325ull;
+    const auto bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
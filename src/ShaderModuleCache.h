@@ -0,0 +1,76 @@
+#ifndef VULKANLEARNING_SHADERMODULECACHE_H
+#define VULKANLEARNING_SHADERMODULECACHE_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "../tools/LoadShader.h"
+
+// Shader modules keyed by a hash of their SPIR-V, so every distinct shader is created once per device
+// however many pipelines use it. SPIR-V is read through mmap: from the shader archive when the directory
+// has one (a single mapping for every shader) and from the loose .spv files otherwise.
+class ShaderModuleCache
+{
+public:
+	// written by shader/pack_shaders.py next to the .spv files
+	static constexpr const char* ArchiveName = "shaders.spvpack";
+
+	ShaderModuleCache(VkDevice device, std::string shaderDirectory);
+	~ShaderModuleCache();
+
+	ShaderModuleCache(const ShaderModuleCache&) = delete;
+	ShaderModuleCache& operator=(const ShaderModuleCache&) = delete;
+
+	// name is relative to the shader directory, e.g. "vert.spv"; the module lives as long as the cache
+	VkShaderModule Load(const std::string& name);
+	// same as Load() but always maps the loose file, skipping the archive
+	VkShaderModule LoadFile(const std::string& name);
+	// maps the loose file into a module that stays out of the cache, for the hot reloader, whose modules would
+	// otherwise pile up with every edit; the caller destroys it once the pipelines using it have been created.
+	// hash is set to Hash() of its code
+	[[nodiscard]] VkShaderModule CreateFromFile(const std::string& name, uint64_t& hash) const;
+	// code must already be validated
+	VkShaderModule GetOrCreate(const uint32_t* code, size_t size);
+
+	// Hash() of the code the module was created from
+	[[nodiscard]] uint64_t GetHash(VkShaderModule shaderModule) const;
+
+	[[nodiscard]] bool HasArchive() const { return m_archive.GetSize() > 0; }
+	[[nodiscard]] size_t GetModuleCount() const;
+
+	// FNV-1a over the whole code
+	[[nodiscard]] static uint64_t Hash(const void* data, size_t size);
+
+private:
+	struct ArchiveEntry
+	{
+		const uint32_t* code;
+		size_t size;
+	};
+
+	struct Module
+	{
+		VkShaderModule shaderModule;
+		// told apart from a different shader with the same hash
+		size_t size;
+	};
+
+	void OpenArchive(const std::string& path);
+
+	VkDevice m_device;
+	std::string m_directory;
+
+	MappedFile m_archive;
+	// views into m_archive, which stays mapped for the lifetime of the cache
+	std::unordered_map<std::string_view, ArchiveEntry> m_archiveEntries;
+
+	mutable std::mutex m_mutex;
+	std::unordered_map<uint64_t, Module> m_modules;
+	std::unordered_map<VkShaderModule, uint64_t> m_hashes;
+};
+
+#endif
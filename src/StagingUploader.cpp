@@ -0,0 +1,289 @@
+#include "StagingUploader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+
+namespace {
+    constexpr VkDeviceSize StagingAlignment = 16;
+}
+
+StagingUploader::StagingUploader(VkDevice device, VulkanAllocator &allocator, FrameScheduler &scheduler, VkQueue transferQueue, const uint32_t transferFamily,
+                                 const uint32_t graphicsFamily, const VkDeviceSize ringSize)
+    : m_device(device), m_allocator(allocator), m_scheduler(scheduler), m_transferQueue(transferQueue), m_transferFamily(transferFamily), m_graphicsFamily(graphicsFamily), m_ringSize(ringSize) {
+    VkCommandPoolCreateInfo commandPoolCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+            .queueFamilyIndex = m_transferFamily};
+
+    if (vkCreateCommandPool(m_device, &commandPoolCreateInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create transfer command pool!");
+    }
+
+    m_stagingBuffer = m_allocator.CreateBuffer(m_ringSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryUsage::CpuToGpu, m_stagingAllocation);
+}
+
+StagingUploader::~StagingUploader() {
+    Submit();
+    while (!m_inFlight.empty()) {
+        RetireOldest();
+    }
+
+    vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+    m_allocator.DestroyBuffer(m_stagingBuffer, m_stagingAllocation);
+}
+
+void StagingUploader::UploadBuffer(VkBuffer buffer, const VkDeviceSize offset, const void *data, const VkDeviceSize size, const VkPipelineStageFlags dstStageMask, const VkAccessFlags dstAccessMask) {
+    if (size == 0) return;
+
+    // anything bigger than the ring goes through in pieces, waiting for earlier pieces as needed
+    const auto bytes = static_cast<const char *>(data);
+    for (VkDeviceSize done = 0; done < size;) {
+        const auto chunk = std::min(size - done, m_ringSize);
+        const auto stagingOffset = Reserve(chunk);
+
+        std::memcpy(static_cast<char *>(m_stagingAllocation.mapped) + stagingOffset, bytes + done, chunk);
+
+        VkBufferCopy region{
+                .srcOffset = stagingOffset,
+                .dstOffset = offset + done,
+                .size = chunk};
+        vkCmdCopyBuffer(m_current.commandBuffer, m_stagingBuffer, buffer, 1, &region);
+
+        done += chunk;
+    }
+
+    // the release barrier also covers pieces submitted in earlier batches, they come first in queue order
+    const auto ownershipTransfer = m_transferFamily != m_graphicsFamily;
+    if (ownershipTransfer) {
+        VkBufferMemoryBarrier releaseBarrier{
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                .pNext = nullptr,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = 0,
+                .srcQueueFamilyIndex = m_transferFamily,
+                .dstQueueFamilyIndex = m_graphicsFamily,
+                .buffer = buffer,
+                .offset = offset,
+                .size = size};
+
+        vkCmdPipelineBarrier(m_current.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr, 1, &releaseBarrier, 0, nullptr);
+    }
+
+    // the timeline wait makes the transfer writes available, the barrier only has to pick up the ownership
+    m_pending.acquireBarriers.push_back(VkBufferMemoryBarrier{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = 0,
+            .dstAccessMask = dstAccessMask,
+            .srcQueueFamilyIndex = ownershipTransfer ? m_transferFamily : VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = ownershipTransfer ? m_graphicsFamily : VK_QUEUE_FAMILY_IGNORED,
+            .buffer = buffer,
+            .offset = offset,
+            .size = size});
+    m_pending.dstStageMask |= dstStageMask;
+}
+
+void StagingUploader::UploadImage(VkImage image, const uint32_t levelCount, const std::vector<ImageLevel> &levels, const VkExtent2D blockExtent,
+                                  const uint32_t blockSize, const VkPipelineStageFlags dstStageMask, const VkAccessFlags dstAccessMask) {
+    const VkImageSubresourceRange range{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = levelCount, .baseArrayLayer = 0, .layerCount = 1};
+
+    auto transitioned = false;
+    for (const auto &level : levels) {
+        const auto blocksX = (level.extent.width + blockExtent.width - 1) / blockExtent.width;
+        const auto blocksY = (level.extent.height + blockExtent.height - 1) / blockExtent.height;
+        const auto rowSize = static_cast<VkDeviceSize>(blocksX) * blockSize;
+        if (level.size < rowSize * blocksY) {
+            throw std::runtime_error("Failed to upload image level, its data is too short!");
+        }
+        if (rowSize > m_ringSize) {
+            throw std::runtime_error("Failed to upload image level, a row of blocks is bigger than the staging ring!");
+        }
+
+        const auto bytes = static_cast<const char *>(level.data);
+        const auto bandRows = static_cast<uint32_t>(std::min<VkDeviceSize>(m_ringSize / rowSize, blocksY));
+        for (uint32_t row = 0; row < blocksY; row += bandRows) {
+            const auto rows = std::min(bandRows, blocksY - row);
+            const auto stagingOffset = Reserve(rowSize * rows);
+
+            // recorded into the first batch, the later ones run after it in queue order
+            if (!transitioned) {
+                VkImageMemoryBarrier barrier{
+                        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                        .pNext = nullptr,
+                        .srcAccessMask = 0,
+                        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .image = image,
+                        .subresourceRange = range};
+                vkCmdPipelineBarrier(m_current.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                     0, nullptr, 0, nullptr, 1, &barrier);
+                transitioned = true;
+            }
+
+            std::memcpy(static_cast<char *>(m_stagingAllocation.mapped) + stagingOffset, bytes + row * rowSize, rowSize * rows);
+
+            const auto top = row * blockExtent.height;
+            VkBufferImageCopy region{
+                    .bufferOffset = stagingOffset,
+                    .bufferRowLength = 0,
+                    .bufferImageHeight = 0,
+                    .imageSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = level.mipLevel, .baseArrayLayer = 0, .layerCount = 1},
+                    .imageOffset = {0, static_cast<int32_t>(top), 0},
+                    .imageExtent = {level.extent.width, std::min(rows * blockExtent.height, level.extent.height - top), 1}};
+            vkCmdCopyBufferToImage(m_current.commandBuffer, m_stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        }
+    }
+    if (!transitioned) return;
+
+    // without an ownership transfer the graphics side barrier does the layout transition alone
+    const auto ownershipTransfer = m_transferFamily != m_graphicsFamily;
+    if (ownershipTransfer) {
+        VkImageMemoryBarrier releaseBarrier{
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .pNext = nullptr,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = 0,
+                .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                .srcQueueFamilyIndex = m_transferFamily,
+                .dstQueueFamilyIndex = m_graphicsFamily,
+                .image = image,
+                .subresourceRange = range};
+
+        vkCmdPipelineBarrier(m_current.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &releaseBarrier);
+    }
+
+    m_pending.imageAcquireBarriers.push_back(VkImageMemoryBarrier{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = 0,
+            .dstAccessMask = dstAccessMask,
+            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .srcQueueFamilyIndex = ownershipTransfer ? m_transferFamily : VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = ownershipTransfer ? m_graphicsFamily : VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = range});
+    m_pending.dstStageMask |= dstStageMask;
+}
+
+StagingUploader::PendingUploads StagingUploader::Flush() {
+    RetireCompleted();
+    Submit();
+
+    PendingUploads pending;
+    std::swap(pending, m_pending);
+    return pending;
+}
+
+VkDeviceSize StagingUploader::Reserve(const VkDeviceSize size) {
+    for (;;) {
+        std::optional<VkDeviceSize> offset;
+
+        if (m_ringEmpty) {
+            m_head = 0;
+            m_tail = 0;
+            offset = 0;
+        } else if (m_head != m_tail) {
+            const auto head = (m_head + StagingAlignment - 1) / StagingAlignment * StagingAlignment;
+
+            if (m_head > m_tail) {
+                // free space is [head, end) followed by [0, tail)
+                if (head + size <= m_ringSize) {
+                    offset = head;
+                } else if (size <= m_tail) {
+                    offset = 0;
+                }
+            } else if (head + size <= m_tail) {
+                offset = head;
+            }
+        }
+
+        if (offset.has_value()) {
+            if (m_current.commandBuffer == VK_NULL_HANDLE) {
+                BeginBatch(offset.value());
+            }
+            m_head = offset.value() + size;
+            m_ringEmpty = false;
+            return offset.value();
+        }
+
+        // the ring is full, let the staged copies run and wait until the oldest batch frees its bytes
+        Submit();
+        RetireOldest();
+    }
+}
+
+void StagingUploader::BeginBatch(const VkDeviceSize begin) {
+    if (!m_freeBatches.empty()) {
+        m_current = m_freeBatches.back();
+        m_freeBatches.pop_back();
+    } else {
+        VkCommandBufferAllocateInfo commandBufferAllocateInfo{
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .pNext = nullptr,
+                .commandPool = m_commandPool,
+                .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                .commandBufferCount = 1};
+
+        if (vkAllocateCommandBuffers(m_device, &commandBufferAllocateInfo, &m_current.commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate transfer command buffer!");
+        }
+    }
+    m_current.begin = begin;
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .pNext = nullptr,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            .pInheritanceInfo = nullptr};
+
+    if (vkBeginCommandBuffer(m_current.commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to begin recording transfer command buffer!");
+    }
+}
+
+void StagingUploader::Submit() {
+    if (m_current.commandBuffer == VK_NULL_HANDLE) return;
+
+    if (vkEndCommandBuffer(m_current.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record transfer command buffer!");
+    }
+
+    // later batches signal higher values, so the graphics queue only ever waits for the last one
+    m_current.value = m_scheduler.Submit(FrameScheduler::Queue::Transfer, m_transferQueue, {.commandBuffers = {m_current.commandBuffer}});
+    m_pending.transferValue = m_current.value;
+    m_inFlight.push_back(m_current);
+    m_current = {};
+}
+
+void StagingUploader::RetireOldest() {
+    auto batch = m_inFlight.front();
+    m_inFlight.pop_front();
+
+    m_scheduler.Wait(FrameScheduler::Queue::Transfer, batch.value);
+    vkResetCommandBuffer(batch.commandBuffer, 0);
+    m_freeBatches.push_back(batch);
+
+    if (!m_inFlight.empty()) {
+        m_tail = m_inFlight.front().begin;
+    } else if (m_current.commandBuffer != VK_NULL_HANDLE) {
+        m_tail = m_current.begin;
+    } else {
+        m_ringEmpty = true;
+    }
+}
+
+void StagingUploader::RetireCompleted() {
+    while (!m_inFlight.empty() && m_scheduler.IsComplete(FrameScheduler::Queue::Transfer, m_inFlight.front().value)) {
+        RetireOldest();
+    }
+}
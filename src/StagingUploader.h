@@ -0,0 +1,94 @@
+#ifndef VULKANLEARNING_STAGINGUPLOADER_H
+#define VULKANLEARNING_STAGINGUPLOADER_H
+
+#include "VulkanAllocator.h"
+#include "FrameScheduler.h"
+
+#include <deque>
+#include <vector>
+
+// Streams data into device local buffers and images through a persistently mapped staging ring.
+// Copies run on the transfer queue, ideally a transfer-only family, so the graphics queue never waits
+// for a large upload; the graphics side only waits for the transfer timeline value and records the acquire
+// barriers handed out by Flush(). Staging space is reclaimed as the transfer timeline passes each batch.
+class StagingUploader
+{
+public:
+	struct PendingUploads
+	{
+		// transfer timeline value that covers every copy, 0 when nothing was submitted
+		uint64_t transferValue = 0;
+		// acquire half of the queue family ownership transfers, to be recorded before the data is used
+		std::vector<VkBufferMemoryBarrier> acquireBarriers;
+		// the same for images, which also go to SHADER_READ_ONLY_OPTIMAL
+		std::vector<VkImageMemoryBarrier> imageAcquireBarriers;
+		VkPipelineStageFlags dstStageMask = 0;
+	};
+
+	StagingUploader(VkDevice device, VulkanAllocator& allocator, FrameScheduler& scheduler, VkQueue transferQueue, uint32_t transferFamily, uint32_t graphicsFamily, VkDeviceSize ringSize);
+	~StagingUploader();
+
+	StagingUploader(const StagingUploader&) = delete;
+	StagingUploader& operator=(const StagingUploader&) = delete;
+
+	// dstStageMask and dstAccessMask describe how the graphics queue reads the buffer afterwards
+	void UploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
+
+	// one mip level of a 2D image, its texel blocks tightly packed row by row
+	struct ImageLevel
+	{
+		const void* data = nullptr;
+		VkDeviceSize size = 0;
+		uint32_t mipLevel = 0;
+		VkExtent2D extent{};
+	};
+
+	// fills levels of an image that has never been used and leaves it in SHADER_READ_ONLY_OPTIMAL; blockExtent and
+	// blockSize describe the format, 1x1 texels for uncompressed ones. A level bigger than the ring goes through in
+	// bands of block rows
+	void UploadImage(VkImage image, uint32_t levelCount, const std::vector<ImageLevel>& levels, VkExtent2D blockExtent, uint32_t blockSize,
+	                 VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
+
+	// submits everything recorded since the last call, never waits for the transfer queue
+	[[nodiscard]] PendingUploads Flush();
+
+private:
+	struct Batch
+	{
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		// transfer timeline value signaled by its submission
+		uint64_t value = 0;
+		// ring offset of the first byte staged by this batch
+		VkDeviceSize begin = 0;
+	};
+
+	VkDeviceSize Reserve(VkDeviceSize size);
+	void BeginBatch(VkDeviceSize begin);
+	void Submit();
+	void RetireOldest();
+	void RetireCompleted();
+
+	VkDevice m_device;
+	VulkanAllocator& m_allocator;
+	FrameScheduler& m_scheduler;
+	VkQueue m_transferQueue;
+	uint32_t m_transferFamily;
+	uint32_t m_graphicsFamily;
+
+	VkCommandPool m_commandPool{};
+
+	VkBuffer m_stagingBuffer{};
+	VulkanAllocation m_stagingAllocation;
+	VkDeviceSize m_ringSize;
+	VkDeviceSize m_head = 0;
+	VkDeviceSize m_tail = 0;
+	bool m_ringEmpty = true;
+
+	Batch m_current;
+	std::deque<Batch> m_inFlight;
+	std::vector<Batch> m_freeBatches;
+
+	PendingUploads m_pending;
+};
+
+#endif
@@ -0,0 +1,448 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    constexpr uint8_t Ktx2Identifier[12] = {0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n'};
+
+    // the file is little endian, like every host this runs on
+    struct Ktx2Header
+    {
+        uint8_t identifier[12];
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+    static_assert(sizeof(Ktx2Header) == 80, "the level index follows the 80 byte header");
+
+    struct Ktx2Level
+    {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+
+    // block footprints of the ASTC formats, each has a UNORM and an SRGB variant in this order
+    constexpr VkExtent2D AstcBlockExtents[] = {
+            {4, 4}, {5, 4}, {5, 5}, {6, 5}, {6, 6}, {8, 5}, {8, 6}, {8, 8}, {10, 5}, {10, 6}, {10, 8}, {10, 10}, {12, 10}, {12, 12}};
+
+    // after a decode did not fit into the budget, so that it is not redone every frame
+    constexpr uint64_t BudgetRetryFrames = 60;
+}
+
+TextureStreamer::TextureStreamer(VkPhysicalDevice physicalDevice, VkDevice device, VulkanAllocator &allocator, FrameScheduler &scheduler,
+                                 StagingUploader &uploader, BindlessTable &bindless, const VkDeviceSize budget, const uint32_t decodeThreads)
+    : m_physicalDevice(physicalDevice), m_device(device), m_allocator(allocator), m_scheduler(scheduler), m_uploader(uploader),
+      m_bindless(bindless), m_decoders(decodeThreads) {
+    m_stats.budget = budget;
+
+    // every level the image holds may be sampled, the view starts at the finest resident one
+    VkSamplerCreateInfo samplerCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .magFilter = VK_FILTER_LINEAR,
+            .minFilter = VK_FILTER_LINEAR,
+            .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+            .addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+            .addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+            .addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+            .mipLodBias = 0.0f,
+            .anisotropyEnable = VK_FALSE,
+            .maxAnisotropy = 1.0f,
+            .compareEnable = VK_FALSE,
+            .compareOp = VK_COMPARE_OP_ALWAYS,
+            .minLod = 0.0f,
+            .maxLod = VK_LOD_CLAMP_NONE,
+            .borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK,
+            .unnormalizedCoordinates = VK_FALSE};
+
+    if (vkCreateSampler(m_device, &samplerCreateInfo, nullptr, &m_sampler) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create texture sampler!");
+    }
+    m_samplerHandle = m_bindless.AddSampler(m_sampler);
+}
+
+TextureStreamer::~TextureStreamer() {
+    for (auto &texture : m_textures) {
+        vkDestroyImageView(m_device, texture->view, nullptr);
+        m_allocator.DestroyImage(texture->image, texture->allocation);
+    }
+    vkDestroySampler(m_device, m_sampler, nullptr);
+}
+
+TextureStreamer::TextureId TextureStreamer::Load(const std::string &path) {
+    const auto fail = [&path](const std::string &reason) {
+        return std::runtime_error("Failed to load texture " + path + ", " + reason + "!");
+    };
+
+    auto texture = std::make_unique<Texture>();
+    texture->path = path;
+    texture->file = MappedFile(path);
+
+    const auto *const data = texture->file.GetData();
+    const auto fileSize = texture->file.GetSize();
+
+    Ktx2Header header{};
+    if (fileSize < sizeof(header)) {
+        throw fail("the file is too short");
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    if (std::memcmp(header.identifier, Ktx2Identifier, sizeof(Ktx2Identifier)) != 0) {
+        throw fail("it is no KTX2 file");
+    }
+    if (header.supercompressionScheme != 0 || header.vkFormat == VK_FORMAT_UNDEFINED) {
+        throw fail("supercompressed and Basis Universal files need a transcoder");
+    }
+    if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1) {
+        throw fail("only 2D textures without array layers or cube faces are supported");
+    }
+
+    texture->format = GetFormatInfo(static_cast<VkFormat>(header.vkFormat));
+    if (texture->format.blockSize == 0) {
+        throw fail("its format is not supported");
+    }
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(m_physicalDevice, texture->format.format, &formatProperties);
+    if ((formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) == 0) {
+        throw fail("the device cannot sample its format");
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+    if (header.pixelWidth > properties.limits.maxImageDimension2D || header.pixelHeight > properties.limits.maxImageDimension2D) {
+        throw fail("it is larger than the device's maxImageDimension2D");
+    }
+
+    texture->extent = {header.pixelWidth, header.pixelHeight};
+    // 0 asks the loader to generate the mips, the file only has the base level then
+    const auto levelCount = std::max(header.levelCount, 1u);
+    // the full chain down to 1x1, any more and the level extents and the image's mipLevels would be invalid
+    auto maxLevelCount = 1u;
+    for (auto size = std::max(header.pixelWidth, header.pixelHeight); size > 1; size >>= 1) {
+        ++maxLevelCount;
+    }
+    if (levelCount > maxLevelCount) {
+        throw fail("it has more levels than its size allows");
+    }
+    if (fileSize < sizeof(header) + levelCount * sizeof(Ktx2Level)) {
+        throw fail("its level index is truncated");
+    }
+
+    texture->levels.resize(levelCount);
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        Ktx2Level entry{};
+        std::memcpy(&entry, data + sizeof(header) + level * sizeof(Ktx2Level), sizeof(entry));
+
+        const auto extent = LevelExtent(*texture, level);
+        const auto &format = texture->format;
+        const auto expected = static_cast<uint64_t>((extent.width + format.blockExtent.width - 1) / format.blockExtent.width) *
+                              ((extent.height + format.blockExtent.height - 1) / format.blockExtent.height) * format.fileBlockSize;
+        if (entry.byteLength < expected || entry.byteOffset > fileSize || fileSize - entry.byteOffset < expected) {
+            throw fail("level " + std::to_string(level) + " is truncated");
+        }
+        texture->levels[level] = {.offset = entry.byteOffset, .size = expected};
+    }
+
+    texture->tailLevel = levelCount - 1;
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        const auto extent = LevelExtent(*texture, level);
+        if (std::max(extent.width, extent.height) <= TailSize) {
+            texture->tailLevel = level;
+            break;
+        }
+    }
+    texture->requestedLevel = levelCount;
+
+    // the tail is small enough to be read right here, it is not held to the budget
+    const auto tail = texture->tailLevel;
+    const auto image = CreateImage(*texture, tail);
+    Upload(*texture, image, tail, Decode(*texture, tail), tail);
+    Swap(*texture, image, tail, 0);
+
+    m_textures.push_back(std::move(texture));
+    ++m_stats.textures;
+    return static_cast<TextureId>(m_textures.size() - 1);
+}
+
+void TextureStreamer::Request(const TextureId texture, const uint32_t mipLevel) {
+    auto &requested = m_textures[texture]->requestedLevel;
+    requested = std::min(requested, mipLevel);
+}
+
+void TextureStreamer::Update(const uint64_t frameNumber) {
+    for (auto &texture : m_textures) {
+        if (texture->requestedLevel <= texture->residentLevel) {
+            texture->lastUsedFrame = frameNumber;
+        }
+    }
+
+    for (auto &texture : m_textures) {
+        if (texture->decoding.valid() && texture->swappedFrame != frameNumber &&
+            texture->decoding.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            FinishDecoding(*texture, frameNumber);
+        }
+    }
+
+    for (auto &texture : m_textures) {
+        if (!texture->decoding.valid() && texture->requestedLevel < texture->residentLevel && frameNumber >= texture->retryFrame) {
+            const auto level = texture->requestedLevel;
+            texture->decodingLevel = level;
+            texture->decoding = m_decoders.Submit([&texture = *texture, level] {
+                return Decode(texture, level);
+            });
+        }
+        texture->requestedLevel = static_cast<uint32_t>(texture->levels.size());
+    }
+}
+
+BindlessTable::Handle TextureStreamer::GetHandle(const TextureId texture) const {
+    return m_textures[texture]->handle;
+}
+
+VkExtent2D TextureStreamer::GetExtent(const TextureId texture) const {
+    return m_textures[texture]->extent;
+}
+
+uint32_t TextureStreamer::GetLevelCount(const TextureId texture) const {
+    return static_cast<uint32_t>(m_textures[texture]->levels.size());
+}
+
+uint32_t TextureStreamer::GetResidentLevel(const TextureId texture) const {
+    return m_textures[texture]->residentLevel;
+}
+
+TextureStreamer::Stats TextureStreamer::GetStats() const {
+    return m_stats;
+}
+
+TextureStreamer::FormatInfo TextureStreamer::GetFormatInfo(const VkFormat fileFormat) const {
+    switch (fileFormat) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            return {.format = fileFormat, .blockExtent = {1, 1}, .blockSize = 4, .fileBlockSize = 4};
+        // widened on decode, optimal tiling support for three channel formats is rare
+        case VK_FORMAT_R8G8B8_UNORM:
+            return {.format = VK_FORMAT_R8G8B8A8_UNORM, .blockExtent = {1, 1}, .blockSize = 4, .fileBlockSize = 3};
+        case VK_FORMAT_R8G8B8_SRGB:
+            return {.format = VK_FORMAT_R8G8B8A8_SRGB, .blockExtent = {1, 1}, .blockSize = 4, .fileBlockSize = 3};
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+            return {.format = fileFormat, .blockExtent = {4, 4}, .blockSize = 8, .fileBlockSize = 8};
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+        case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+        case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return {.format = fileFormat, .blockExtent = {4, 4}, .blockSize = 16, .fileBlockSize = 16};
+        default:
+            break;
+    }
+
+    if (fileFormat >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && fileFormat <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK) {
+        const auto blockExtent = AstcBlockExtents[(fileFormat - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2];
+        return {.format = fileFormat, .blockExtent = blockExtent, .blockSize = 16, .fileBlockSize = 16};
+    }
+
+    return {};
+}
+
+VkExtent2D TextureStreamer::LevelExtent(const Texture &texture, const uint32_t level) {
+    return {std::max(texture.extent.width >> level, 1u), std::max(texture.extent.height >> level, 1u)};
+}
+
+std::vector<std::vector<uint8_t>> TextureStreamer::Decode(const Texture &texture, const uint32_t firstLevel) {
+    std::vector<std::vector<uint8_t>> decoded;
+    decoded.reserve(texture.levels.size() - firstLevel);
+
+    for (auto level = firstLevel; level < texture.levels.size(); ++level) {
+        // the copy faults the pages in here, on a worker, rather than while the render thread stages them
+        const auto *const source = texture.file.GetData() + texture.levels[level].offset;
+        const auto size = texture.levels[level].size;
+        auto &out = decoded.emplace_back();
+
+        if (texture.format.fileBlockSize == texture.format.blockSize) {
+            out.resize(size);
+            std::memcpy(out.data(), source, size);
+            continue;
+        }
+
+        const auto texelCount = size / texture.format.fileBlockSize;
+        out.resize(texelCount * 4);
+        const auto *const rgb = reinterpret_cast<const uint8_t *>(source);
+        for (size_t i = 0; i < texelCount; ++i) {
+            out[i * 4 + 0] = rgb[i * 3 + 0];
+            out[i * 4 + 1] = rgb[i * 3 + 1];
+            out[i * 4 + 2] = rgb[i * 3 + 2];
+            out[i * 4 + 3] = 255;
+        }
+    }
+    return decoded;
+}
+
+VkImageCreateInfo TextureStreamer::ImageCreateInfo(const Texture &texture, const uint32_t firstLevel) {
+    const auto extent = LevelExtent(texture, firstLevel);
+    return {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = texture.format.format,
+            .extent = {extent.width, extent.height, 1},
+            .mipLevels = static_cast<uint32_t>(texture.levels.size()) - firstLevel,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = nullptr,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+}
+
+VkDeviceSize TextureStreamer::MeasureImage(const Texture &texture, const uint32_t firstLevel) const {
+    // the layout is up to the driver, so the size is asked of an image that never gets memory
+    const auto createInfo = ImageCreateInfo(texture, firstLevel);
+    VkImage image;
+    if (vkCreateImage(m_device, &createInfo, nullptr, &image) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create texture image!");
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(m_device, image, &requirements);
+    vkDestroyImage(m_device, image, nullptr);
+    return requirements.size;
+}
+
+TextureStreamer::ResidentImage TextureStreamer::CreateImage(const Texture &texture, const uint32_t firstLevel) {
+    ResidentImage image;
+    image.image = m_allocator.CreateImage(ImageCreateInfo(texture, firstLevel), MemoryUsage::GpuOnly, image.allocation);
+    image.size = image.allocation.size;
+    return image;
+}
+
+void TextureStreamer::Upload(Texture &texture, const ResidentImage &image, const uint32_t firstLevel,
+                             const std::vector<std::vector<uint8_t>> &decoded, const uint32_t decodedLevel) {
+    std::vector<StagingUploader::ImageLevel> levels;
+    for (auto level = firstLevel; level < texture.levels.size(); ++level) {
+        const auto &data = decoded[level - decodedLevel];
+        levels.push_back({.data = data.data(), .size = data.size(), .mipLevel = level - firstLevel, .extent = LevelExtent(texture, level)});
+        m_stats.uploadedBytes += data.size();
+    }
+
+    m_uploader.UploadImage(image.image, static_cast<uint32_t>(levels.size()), levels, texture.format.blockExtent, texture.format.blockSize,
+                           VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+}
+
+void TextureStreamer::Swap(Texture &texture, const ResidentImage &image, const uint32_t firstLevel, const uint64_t frameNumber) {
+    VkImageViewCreateInfo viewCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .image = image.image,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = texture.format.format,
+            .components = {VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY},
+            .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = VK_REMAINING_MIP_LEVELS, .baseArrayLayer = 0, .layerCount = 1}};
+
+    VkImageView view;
+    if (vkCreateImageView(m_device, &viewCreateInfo, nullptr, &view) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create texture image view!");
+    }
+
+    // frames already submitted may still sample the old image, the frame being recorded gets the new handle
+    if (texture.image != VK_NULL_HANDLE) {
+        m_scheduler.DeferDeletion(FrameScheduler::Queue::Graphics,
+                                  [device = m_device, &allocator = m_allocator, view = texture.view, image = texture.image, allocation = texture.allocation]() mutable {
+                                      vkDestroyImageView(device, view, nullptr);
+                                      allocator.DestroyImage(image, allocation);
+                                  });
+        m_bindless.Remove(BindlessTable::ResourceType::SampledImage, texture.handle);
+        m_stats.residentBytes -= texture.size;
+    }
+
+    texture.image = image.image;
+    texture.allocation = image.allocation;
+    texture.view = view;
+    texture.size = image.size;
+    texture.residentLevel = firstLevel;
+    texture.swappedFrame = frameNumber;
+    texture.handle = m_bindless.AddSampledImage(view);
+
+    m_stats.residentBytes += image.size;
+    m_stats.peakResidentBytes = std::max(m_stats.peakResidentBytes, m_stats.residentBytes);
+}
+
+bool TextureStreamer::MakeRoom(const VkDeviceSize bytes, const Texture &keep, const uint64_t frameNumber) {
+    while (m_stats.residentBytes + bytes > m_stats.budget) {
+        // an image swapped in this frame may still be waiting for its upload, which no graphics frame has waited for yet
+        Texture *victim = nullptr;
+        for (auto &texture : m_textures) {
+            if (texture.get() == &keep || texture->residentLevel >= texture->tailLevel || texture->lastUsedFrame >= frameNumber ||
+                texture->swappedFrame == frameNumber) continue;
+
+            if (victim == nullptr || texture->lastUsedFrame < victim->lastUsedFrame) {
+                victim = texture.get();
+            }
+        }
+        if (victim == nullptr) return false;
+
+        // keeps what the frame still asks for, which is coarser than what the texture holds; the levels are read
+        // from the mapping again, they are a quarter of the dropped size at most
+        const auto level = std::min(victim->tailLevel, std::max(victim->residentLevel + 1, victim->requestedLevel));
+        const auto image = CreateImage(*victim, level);
+        Upload(*victim, image, level, Decode(*victim, level), level);
+        Swap(*victim, image, level, frameNumber);
+        ++m_stats.evictions;
+    }
+    return true;
+}
+
+void TextureStreamer::FinishDecoding(Texture &texture, const uint64_t frameNumber) {
+    const auto decoded = texture.decoding.get();
+    const auto decodedLevel = texture.decodingLevel;
+
+    // the camera may have moved on while the worker decoded, nothing finer than the frame asks for is kept
+    auto level = std::clamp(texture.requestedLevel, decodedLevel, texture.residentLevel);
+    for (; level < texture.residentLevel; ++level) {
+        const auto size = MeasureImage(texture, level);
+        if (MakeRoom(size > texture.size ? size - texture.size : 0, texture, frameNumber)) break;
+    }
+
+    if (level != decodedLevel && texture.requestedLevel <= decodedLevel) {
+        ++m_stats.budgetLimited;
+        texture.retryFrame = frameNumber + BudgetRetryFrames;
+    }
+    if (level >= texture.residentLevel) return;
+
+    const auto image = CreateImage(texture, level);
+    Upload(texture, image, level, decoded, decodedLevel);
+    Swap(texture, image, level, frameNumber);
+    ++m_stats.upgrades;
+}
@@ -0,0 +1,159 @@
+#ifndef VULKANLEARNING_TEXTURESTREAMER_H
+#define VULKANLEARNING_TEXTURESTREAMER_H
+
+#include "VulkanAllocator.h"
+#include "FrameScheduler.h"
+#include "StagingUploader.h"
+#include "BindlessTable.h"
+#include "../tools/LoadShader.h"
+#include "../tools/ThreadPool.h"
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Mip residency of KTX2 textures read through memory mapped files. Loading a texture only uploads its mip tail,
+// the levels at most TailSize texels wide, so that it can be sampled right away; finer levels follow once the
+// camera asks for them with Request(). They are decoded on worker threads (copied out of the mapping, RGB8 widened
+// to RGBA8 as few devices sample RGB8) and uploaded through the staging ring. A texture always sits in one image
+// that holds its levels from the finest resident one down, so a residency change builds a new image and view and
+// retires the old ones through the frame scheduler; shaders pick up the new bindless handle with the frame.
+// When the resident images would exceed the budget, the detail levels of the least recently needed textures are
+// dropped first, textures the current frame needs are never evicted for another one.
+// Block compressed files (BC, ASTC) are uploaded as they are and need a device that samples their format,
+// supercompressed ones (BasisLZ, Zstandard) are rejected. Used from the render thread only.
+class TextureStreamer
+{
+public:
+	using TextureId = uint32_t;
+
+	// width or height, in texels, up to which levels belong to the always resident mip tail
+	static constexpr uint32_t TailSize = 64;
+
+	struct Stats
+	{
+		uint32_t textures = 0;
+		VkDeviceSize residentBytes = 0;
+		VkDeviceSize peakResidentBytes = 0;
+		VkDeviceSize budget = 0;
+		// level data uploaded since the start, mip tails included
+		VkDeviceSize uploadedBytes = 0;
+		uint32_t upgrades = 0;
+		uint32_t evictions = 0;
+		// upgrades cut short because the budget was spent on textures in use
+		uint32_t budgetLimited = 0;
+	};
+
+	TextureStreamer(VkPhysicalDevice physicalDevice, VkDevice device, VulkanAllocator& allocator, FrameScheduler& scheduler,
+	                StagingUploader& uploader, BindlessTable& bindless, VkDeviceSize budget, uint32_t decodeThreads);
+	~TextureStreamer();
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	// maps the file and uploads its mip tail, throws if the file is no KTX2 texture this streamer can use
+	TextureId Load(const std::string& path);
+	// the finest level the current frame samples, called every frame for every texture in view
+	void Request(TextureId texture, uint32_t mipLevel);
+	// once per frame before the uploads are flushed: swaps in decoded levels, evicts under the budget and starts
+	// decoding the levels requested since the last call
+	void Update(uint64_t frameNumber);
+
+	// the texture at its current residency, only valid for the frame being recorded
+	[[nodiscard]] BindlessTable::Handle GetHandle(TextureId texture) const;
+	[[nodiscard]] BindlessTable::Handle GetSampler() const { return m_samplerHandle; }
+	[[nodiscard]] VkExtent2D GetExtent(TextureId texture) const;
+	[[nodiscard]] uint32_t GetLevelCount(TextureId texture) const;
+	[[nodiscard]] uint32_t GetResidentLevel(TextureId texture) const;
+	[[nodiscard]] Stats GetStats() const;
+
+private:
+	struct FormatInfo
+	{
+		// format of the image, the file's one unless it is widened on decode
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkExtent2D blockExtent{1, 1};
+		uint32_t blockSize = 0;
+		// bytes per block in the file
+		uint32_t fileBlockSize = 0;
+	};
+
+	struct Level
+	{
+		uint64_t offset = 0;
+		uint64_t size = 0;
+	};
+
+	struct Texture
+	{
+		std::string path;
+		MappedFile file;
+		FormatInfo format;
+		VkExtent2D extent{};
+		std::vector<Level> levels;
+		uint32_t tailLevel = 0;
+
+		// finest level the image holds, every coarser one is in it too
+		uint32_t residentLevel = 0;
+		VkImage image = VK_NULL_HANDLE;
+		VulkanAllocation allocation;
+		VkImageView view = VK_NULL_HANDLE;
+		BindlessTable::Handle handle = BindlessTable::InvalidHandle;
+		VkDeviceSize size = 0;
+
+		// finest level requested since the last Update(), levels.size() for none
+		uint32_t requestedLevel = 0;
+		// last frame that needed the resident detail, what the eviction order goes by
+		uint64_t lastUsedFrame = 0;
+		// the frame its image was last replaced in, it is left alone for the rest of that frame
+		uint64_t swappedFrame = UINT64_MAX;
+		// no new decode before this frame after the budget got in the way
+		uint64_t retryFrame = 0;
+
+		// levels [decodingLevel, levels.size()) decoded on a worker
+		std::future<std::vector<std::vector<uint8_t>>> decoding;
+		uint32_t decodingLevel = 0;
+	};
+
+	struct ResidentImage
+	{
+		VkImage image = VK_NULL_HANDLE;
+		VulkanAllocation allocation;
+		VkDeviceSize size = 0;
+	};
+
+	[[nodiscard]] FormatInfo GetFormatInfo(VkFormat fileFormat) const;
+	[[nodiscard]] static VkExtent2D LevelExtent(const Texture& texture, uint32_t level);
+	// reads levels [firstLevel, levels.size()) out of the mapping, safe on any thread
+	[[nodiscard]] static std::vector<std::vector<uint8_t>> Decode(const Texture& texture, uint32_t firstLevel);
+	[[nodiscard]] static VkImageCreateInfo ImageCreateInfo(const Texture& texture, uint32_t firstLevel);
+	// memory an image of levels [firstLevel, levels.size()) would take, without allocating it
+	[[nodiscard]] VkDeviceSize MeasureImage(const Texture& texture, uint32_t firstLevel) const;
+	[[nodiscard]] ResidentImage CreateImage(const Texture& texture, uint32_t firstLevel);
+	// uploads decoded levels starting at firstLevel into image, which holds levels [firstLevel, levels.size())
+	void Upload(Texture& texture, const ResidentImage& image, uint32_t firstLevel, const std::vector<std::vector<uint8_t>>& decoded,
+	            uint32_t decodedLevel);
+	void Swap(Texture& texture, const ResidentImage& image, uint32_t firstLevel, uint64_t frameNumber);
+	// drops cold detail levels until bytes more fit into the budget, false if that is not possible this frame
+	bool MakeRoom(VkDeviceSize bytes, const Texture& keep, uint64_t frameNumber);
+	void FinishDecoding(Texture& texture, uint64_t frameNumber);
+
+	VkPhysicalDevice m_physicalDevice;
+	VkDevice m_device;
+	VulkanAllocator& m_allocator;
+	FrameScheduler& m_scheduler;
+	StagingUploader& m_uploader;
+	BindlessTable& m_bindless;
+
+	VkSampler m_sampler{};
+	BindlessTable::Handle m_samplerHandle = BindlessTable::InvalidHandle;
+
+	std::vector<std::unique_ptr<Texture>> m_textures;
+	Stats m_stats;
+
+	// declared last, so that it is joined before the textures its tasks read go away
+	ThreadPool m_decoders;
+};
+
+#endif
@@ -0,0 +1,263 @@
+#include "TlsfAllocator.h"
+
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+    uint32_t MostSignificantBit(const uint64_t value) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return index;
+#else
+        return 63 - __builtin_clzll(value);
+#endif
+    }
+
+    uint32_t LeastSignificantBit(const uint64_t value) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return index;
+#else
+        return __builtin_ctzll(value);
+#endif
+    }
+
+    uint64_t AlignUp(const uint64_t value, const uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+TlsfAllocator::TlsfAllocator(const uint64_t size)
+    : m_size(size) {
+    for (auto &freeLists : m_freeLists) {
+        for (auto &head : freeLists) {
+            head = InvalidNode;
+        }
+    }
+
+    const auto node = CreateNode();
+    m_nodes[node] = {
+            .offset = 0,
+            .size = size,
+            .prevPhysical = InvalidNode,
+            .nextPhysical = InvalidNode,
+            .prevFree = InvalidNode,
+            .nextFree = InvalidNode,
+            .free = true};
+    InsertFree(node);
+}
+
+uint32_t TlsfAllocator::Allocate(uint64_t size, uint64_t alignment, uint64_t &offset) {
+    if (size == 0) size = 1;
+    if (alignment == 0) alignment = 1;
+
+    // any free range of at least this size can hold the allocation whatever its offset is
+    const auto searchSize = size + alignment - 1;
+    if (searchSize > m_size) return InvalidNode;
+
+    const auto node = FindFreeNode(searchSize);
+    if (node == InvalidNode) return InvalidNode;
+
+    RemoveFree(node);
+
+    // hand the alignment padding back as its own free range, the previous range is never free
+    // because free neighbours are always merged
+    const auto padding = AlignUp(m_nodes[node].offset, alignment) - m_nodes[node].offset;
+    if (padding > 0) {
+        const auto paddingNode = CreateNode();
+        m_nodes[paddingNode] = {
+                .offset = m_nodes[node].offset,
+                .size = padding,
+                .prevPhysical = m_nodes[node].prevPhysical,
+                .nextPhysical = node,
+                .prevFree = InvalidNode,
+                .nextFree = InvalidNode,
+                .free = true};
+
+        if (m_nodes[paddingNode].prevPhysical != InvalidNode) {
+            m_nodes[m_nodes[paddingNode].prevPhysical].nextPhysical = paddingNode;
+        }
+        m_nodes[node].prevPhysical = paddingNode;
+        m_nodes[node].offset += padding;
+        m_nodes[node].size -= padding;
+
+        InsertFree(paddingNode);
+    }
+
+    // split the tail off if it is big enough to be useful on its own
+    const auto remaining = m_nodes[node].size - size;
+    if (remaining >= SecondLevelCount) {
+        const auto tailNode = CreateNode();
+        m_nodes[tailNode] = {
+                .offset = m_nodes[node].offset + size,
+                .size = remaining,
+                .prevPhysical = node,
+                .nextPhysical = m_nodes[node].nextPhysical,
+                .prevFree = InvalidNode,
+                .nextFree = InvalidNode,
+                .free = true};
+
+        if (m_nodes[tailNode].nextPhysical != InvalidNode) {
+            m_nodes[m_nodes[tailNode].nextPhysical].prevPhysical = tailNode;
+        }
+        m_nodes[node].nextPhysical = tailNode;
+        m_nodes[node].size = size;
+
+        InsertFree(tailNode);
+    }
+
+    m_nodes[node].free = false;
+    m_usedSize += m_nodes[node].size;
+    ++m_allocationCount;
+
+    offset = m_nodes[node].offset;
+    return node;
+}
+
+void TlsfAllocator::Free(uint32_t node) {
+    m_usedSize -= m_nodes[node].size;
+    --m_allocationCount;
+    m_nodes[node].free = true;
+
+    const auto prev = m_nodes[node].prevPhysical;
+    if (prev != InvalidNode && m_nodes[prev].free) {
+        RemoveFree(prev);
+
+        m_nodes[prev].size += m_nodes[node].size;
+        m_nodes[prev].nextPhysical = m_nodes[node].nextPhysical;
+        if (m_nodes[prev].nextPhysical != InvalidNode) {
+            m_nodes[m_nodes[prev].nextPhysical].prevPhysical = prev;
+        }
+
+        ReleaseNode(node);
+        node = prev;
+    }
+
+    const auto next = m_nodes[node].nextPhysical;
+    if (next != InvalidNode && m_nodes[next].free) {
+        RemoveFree(next);
+
+        m_nodes[node].size += m_nodes[next].size;
+        m_nodes[node].nextPhysical = m_nodes[next].nextPhysical;
+        if (m_nodes[node].nextPhysical != InvalidNode) {
+            m_nodes[m_nodes[node].nextPhysical].prevPhysical = node;
+        }
+
+        ReleaseNode(next);
+    }
+
+    InsertFree(node);
+}
+
+uint64_t TlsfAllocator::GetLargestFreeRange() const {
+    if (m_firstLevelBitmap == 0) return 0;
+
+    // the largest range lives in the highest non empty list, but that list spans a size class
+    const auto firstLevel = MostSignificantBit(m_firstLevelBitmap);
+    const auto secondLevel = MostSignificantBit(m_secondLevelBitmaps[firstLevel]);
+
+    uint64_t largest = 0;
+    for (auto node = m_freeLists[firstLevel][secondLevel]; node != InvalidNode; node = m_nodes[node].nextFree) {
+        largest = std::max(largest, m_nodes[node].size);
+    }
+
+    return largest;
+}
+
+void TlsfAllocator::Mapping(const uint64_t size, uint32_t &firstLevel, uint32_t &secondLevel) {
+    if (size < SecondLevelCount) {
+        firstLevel = 0;
+        secondLevel = static_cast<uint32_t>(size);
+        return;
+    }
+
+    const auto msb = MostSignificantBit(size);
+    firstLevel = msb - SecondLevelLog2 + 1;
+    secondLevel = static_cast<uint32_t>(size >> (msb - SecondLevelLog2)) - SecondLevelCount;
+}
+
+uint32_t TlsfAllocator::FindFreeNode(uint64_t size) const {
+    // round up to the next size class so that every range in the list found is big enough
+    if (size >= SecondLevelCount) {
+        size += (1ull << (MostSignificantBit(size) - SecondLevelLog2)) - 1;
+    }
+
+    uint32_t firstLevel;
+    uint32_t secondLevel;
+    Mapping(size, firstLevel, secondLevel);
+
+    if (firstLevel >= FirstLevelCount) return InvalidNode;
+
+    auto secondLevelMap = m_secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+    if (secondLevelMap == 0) {
+        const auto firstLevelMap = firstLevel + 1 < FirstLevelCount ? m_firstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+        if (firstLevelMap == 0) return InvalidNode;
+
+        firstLevel = LeastSignificantBit(firstLevelMap);
+        secondLevelMap = m_secondLevelBitmaps[firstLevel];
+    }
+
+    secondLevel = LeastSignificantBit(secondLevelMap);
+    return m_freeLists[firstLevel][secondLevel];
+}
+
+void TlsfAllocator::InsertFree(const uint32_t node) {
+    uint32_t firstLevel;
+    uint32_t secondLevel;
+    Mapping(m_nodes[node].size, firstLevel, secondLevel);
+
+    const auto head = m_freeLists[firstLevel][secondLevel];
+    m_nodes[node].prevFree = InvalidNode;
+    m_nodes[node].nextFree = head;
+    if (head != InvalidNode) {
+        m_nodes[head].prevFree = node;
+    }
+
+    m_freeLists[firstLevel][secondLevel] = node;
+    m_firstLevelBitmap |= 1ull << firstLevel;
+    m_secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+}
+
+void TlsfAllocator::RemoveFree(const uint32_t node) {
+    uint32_t firstLevel;
+    uint32_t secondLevel;
+    Mapping(m_nodes[node].size, firstLevel, secondLevel);
+
+    const auto prev = m_nodes[node].prevFree;
+    const auto next = m_nodes[node].nextFree;
+    if (prev != InvalidNode) {
+        m_nodes[prev].nextFree = next;
+    } else {
+        m_freeLists[firstLevel][secondLevel] = next;
+    }
+    if (next != InvalidNode) {
+        m_nodes[next].prevFree = prev;
+    }
+
+    if (m_freeLists[firstLevel][secondLevel] == InvalidNode) {
+        m_secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+        if (m_secondLevelBitmaps[firstLevel] == 0) {
+            m_firstLevelBitmap &= ~(1ull << firstLevel);
+        }
+    }
+}
+
+uint32_t TlsfAllocator::CreateNode() {
+    if (!m_unusedNodes.empty()) {
+        const auto node = m_unusedNodes.back();
+        m_unusedNodes.pop_back();
+        return node;
+    }
+
+    m_nodes.emplace_back();
+    return static_cast<uint32_t>(m_nodes.size() - 1);
+}
+
+void TlsfAllocator::ReleaseNode(const uint32_t node) {
+    m_unusedNodes.push_back(node);
+}
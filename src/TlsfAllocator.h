@@ -0,0 +1,61 @@
+#ifndef VULKANLEARNING_TLSFALLOCATOR_H
+#define VULKANLEARNING_TLSFALLOCATOR_H
+
+#include <cstdint>
+#include <vector>
+
+// Two-level segregated fit bookkeeping for a linear range of [0, size).
+// It only hands out offsets and never touches the memory itself, so it can be tested without a device.
+class TlsfAllocator
+{
+public:
+	static constexpr uint32_t InvalidNode = UINT32_MAX;
+
+	explicit TlsfAllocator(uint64_t size);
+
+	// returns InvalidNode when no free range can hold size bytes at the requested alignment
+	[[nodiscard]] uint32_t Allocate(uint64_t size, uint64_t alignment, uint64_t& offset);
+	void Free(uint32_t node);
+
+	[[nodiscard]] uint64_t GetSize() const { return m_size; }
+	[[nodiscard]] uint64_t GetUsedSize() const { return m_usedSize; }
+	[[nodiscard]] uint32_t GetAllocationCount() const { return m_allocationCount; }
+	[[nodiscard]] bool IsEmpty() const { return m_allocationCount == 0; }
+	[[nodiscard]] uint64_t GetLargestFreeRange() const;
+
+private:
+	static constexpr uint32_t SecondLevelLog2 = 4;
+	static constexpr uint32_t SecondLevelCount = 1u << SecondLevelLog2;
+	static constexpr uint32_t FirstLevelCount = 64;
+
+	struct Node
+	{
+		uint64_t offset;
+		uint64_t size;
+		uint32_t prevPhysical;
+		uint32_t nextPhysical;
+		uint32_t prevFree;
+		uint32_t nextFree;
+		bool free;
+	};
+
+	static void Mapping(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel);
+	[[nodiscard]] uint32_t FindFreeNode(uint64_t size) const;
+	void InsertFree(uint32_t node);
+	void RemoveFree(uint32_t node);
+	uint32_t CreateNode();
+	void ReleaseNode(uint32_t node);
+
+	uint64_t m_size;
+	uint64_t m_usedSize = 0;
+	uint32_t m_allocationCount = 0;
+
+	uint64_t m_firstLevelBitmap = 0;
+	uint32_t m_secondLevelBitmaps[FirstLevelCount]{};
+	uint32_t m_freeLists[FirstLevelCount][SecondLevelCount]{};
+
+	std::vector<Node> m_nodes;
+	std::vector<uint32_t> m_unusedNodes;
+};
+
+#endif
@@ -0,0 +1,346 @@
+#include "VulkanAllocator.h"
+
+#include "TlsfAllocator.h"
+
+#include <algorithm>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+
+namespace {
+    constexpr VkDeviceSize LargeHeapBlockSize = 256ull * 1024 * 1024;
+    // heaps up to this size get blocks of an eighth of the heap instead
+    constexpr VkDeviceSize SmallHeapMaxSize = 1024ull * 1024 * 1024;
+    constexpr VkDeviceSize MinimumBlockSize = 1024ull * 1024;
+
+    VkMemoryPropertyFlags RequiredFlags(const MemoryUsage usage) {
+        switch (usage) {
+            case MemoryUsage::GpuOnly:
+                return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            case MemoryUsage::CpuToGpu:
+            case MemoryUsage::GpuToCpu:
+                return VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        }
+        return 0;
+    }
+
+    VkMemoryPropertyFlags PreferredFlags(const MemoryUsage usage) {
+        return usage == MemoryUsage::GpuToCpu ? VK_MEMORY_PROPERTY_HOST_CACHED_BIT : 0;
+    }
+
+    double ToMiB(const VkDeviceSize bytes) {
+        return static_cast<double>(bytes) / (1024.0 * 1024.0);
+    }
+}
+
+class VulkanMemoryBlock
+{
+public:
+    VulkanMemoryBlock(VkDeviceMemory memory, void *mapped, const VkDeviceSize size, const uint32_t memoryTypeIndex, const size_t kind)
+        : memory(memory), mapped(mapped), memoryTypeIndex(memoryTypeIndex), kind(kind), ranges(size) {}
+
+    VkDeviceMemory memory;
+    void *mapped;
+    uint32_t memoryTypeIndex;
+    size_t kind;
+    TlsfAllocator ranges;
+};
+
+VulkanAllocator::VulkanAllocator(VkPhysicalDevice physicalDevice, VkDevice device)
+    : m_physicalDevice(physicalDevice), m_device(device) {
+    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &m_memoryProperties);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+    m_bufferImageGranularity = properties.limits.bufferImageGranularity;
+    m_maxMemoryAllocationCount = properties.limits.maxMemoryAllocationCount;
+}
+
+VulkanAllocator::~VulkanAllocator() {
+    for (auto &kinds : m_blocks) {
+        for (auto &blocks : kinds) {
+            for (const auto &block : blocks) {
+                if (!block->ranges.IsEmpty()) {
+                    std::cerr << "Memory block destroyed with " << block->ranges.GetAllocationCount() << " live allocations" << std::endl;
+                }
+                FreeDeviceMemory(block->memory);
+            }
+        }
+    }
+}
+
+VulkanAllocation VulkanAllocator::Allocate(const VkMemoryRequirements &requirements, const MemoryUsage usage, const bool linearResource) {
+    std::lock_guard lock(m_mutex);
+
+    const auto memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits, RequiredFlags(usage), PreferredFlags(usage));
+    const auto blockSize = GetPreferredBlockSize(memoryTypeIndex);
+
+    // big resources would mostly waste the rest of a block, give them their own memory
+    if (requirements.size > blockSize / 2) {
+        VulkanAllocation allocation{
+                .memory = VK_NULL_HANDLE,
+                .offset = 0,
+                .size = requirements.size,
+                .mapped = nullptr,
+                .memoryTypeIndex = memoryTypeIndex,
+                .block = nullptr,
+                .node = 0};
+        allocation.memory = AllocateDeviceMemory(requirements.size, memoryTypeIndex, &allocation.mapped);
+
+        const auto heapIndex = m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+        m_dedicatedBytes[heapIndex] += requirements.size;
+        ++m_dedicatedCount[heapIndex];
+
+        return allocation;
+    }
+
+    // with a granularity of 1 buffers and optimal images may sit next to each other in the same block
+    const size_t kind = (m_bufferImageGranularity > 1 && !linearResource) ? 1 : 0;
+    auto &blocks = m_blocks[memoryTypeIndex][kind];
+
+    const auto allocateFrom = [&](VulkanMemoryBlock *block, VulkanAllocation &allocation) {
+        VkDeviceSize offset = 0;
+        const auto node = block->ranges.Allocate(requirements.size, requirements.alignment, offset);
+        if (node == TlsfAllocator::InvalidNode) return false;
+
+        allocation = {
+                .memory = block->memory,
+                .offset = offset,
+                .size = requirements.size,
+                .mapped = block->mapped ? static_cast<char *>(block->mapped) + offset : nullptr,
+                .memoryTypeIndex = memoryTypeIndex,
+                .block = block,
+                .node = node};
+        return true;
+    };
+
+    VulkanAllocation allocation;
+    for (const auto &block : blocks) {
+        if (allocateFrom(block.get(), allocation)) return allocation;
+    }
+
+    void *mapped = nullptr;
+    const auto memory = AllocateDeviceMemory(blockSize, memoryTypeIndex, &mapped);
+    blocks.push_back(std::make_unique<VulkanMemoryBlock>(memory, mapped, blockSize, memoryTypeIndex, kind));
+
+    if (!allocateFrom(blocks.back().get(), allocation)) {
+        throw std::runtime_error("Failed to sub-allocate from a new memory block!");
+    }
+
+    return allocation;
+}
+
+void VulkanAllocator::Free(VulkanAllocation &allocation) {
+    if (allocation.memory == VK_NULL_HANDLE) return;
+
+    std::lock_guard lock(m_mutex);
+
+    if (allocation.block == nullptr) {
+        const auto heapIndex = m_memoryProperties.memoryTypes[allocation.memoryTypeIndex].heapIndex;
+        m_dedicatedBytes[heapIndex] -= allocation.size;
+        --m_dedicatedCount[heapIndex];
+
+        FreeDeviceMemory(allocation.memory);
+        allocation = {};
+        return;
+    }
+
+    auto *block = allocation.block;
+    block->ranges.Free(allocation.node);
+    allocation = {};
+
+    if (!block->ranges.IsEmpty()) return;
+
+    // keep one empty block around so that a resource recreated every frame does not hit vkAllocateMemory,
+    // but give any further empty block back to the driver
+    auto &blocks = m_blocks[block->memoryTypeIndex][block->kind];
+    const auto otherEmpty = std::any_of(blocks.begin(), blocks.end(), [block](const auto &other) {
+        return other.get() != block && other->ranges.IsEmpty();
+    });
+    if (!otherEmpty) return;
+
+    const auto it = std::find_if(blocks.begin(), blocks.end(), [block](const auto &other) { return other.get() == block; });
+    FreeDeviceMemory(block->memory);
+    blocks.erase(it);
+}
+
+VkBuffer VulkanAllocator::CreateBuffer(const VkDeviceSize size, const VkBufferUsageFlags usage, const MemoryUsage memoryUsage, VulkanAllocation &allocation) {
+    VkBufferCreateInfo createInfo{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .size = size,
+            .usage = usage,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = nullptr};
+
+    VkBuffer buffer;
+    if (vkCreateBuffer(m_device, &createInfo, nullptr, &buffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create buffer!");
+    }
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(m_device, buffer, &memoryRequirements);
+
+    // nothing may outlive a failed creation, neither the buffer nor its memory
+    try {
+        allocation = Allocate(memoryRequirements, memoryUsage, true);
+    } catch (...) {
+        vkDestroyBuffer(m_device, buffer, nullptr);
+        throw;
+    }
+    if (vkBindBufferMemory(m_device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+        DestroyBuffer(buffer, allocation);
+        throw std::runtime_error("Failed to bind buffer memory!");
+    }
+
+    return buffer;
+}
+
+VkImage VulkanAllocator::CreateImage(const VkImageCreateInfo &createInfo, const MemoryUsage memoryUsage, VulkanAllocation &allocation) {
+    VkImage image;
+    if (vkCreateImage(m_device, &createInfo, nullptr, &image) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create image!");
+    }
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetImageMemoryRequirements(m_device, image, &memoryRequirements);
+
+    try {
+        allocation = Allocate(memoryRequirements, memoryUsage, createInfo.tiling == VK_IMAGE_TILING_LINEAR);
+    } catch (...) {
+        vkDestroyImage(m_device, image, nullptr);
+        throw;
+    }
+    if (vkBindImageMemory(m_device, image, allocation.memory, allocation.offset) != VK_SUCCESS) {
+        DestroyImage(image, allocation);
+        throw std::runtime_error("Failed to bind image memory!");
+    }
+
+    return image;
+}
+
+void VulkanAllocator::DestroyBuffer(VkBuffer buffer, VulkanAllocation &allocation) {
+    vkDestroyBuffer(m_device, buffer, nullptr);
+    Free(allocation);
+}
+
+void VulkanAllocator::DestroyImage(VkImage image, VulkanAllocation &allocation) {
+    vkDestroyImage(m_device, image, nullptr);
+    Free(allocation);
+}
+
+uint32_t VulkanAllocator::FindMemoryType(const uint32_t typeFilter, const VkMemoryPropertyFlags required, const VkMemoryPropertyFlags preferred) const {
+    std::optional<uint32_t> fallback;
+
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; ++i) {
+        const auto flags = m_memoryProperties.memoryTypes[i].propertyFlags;
+        if (!(typeFilter & (1 << i)) || (flags & required) != required) continue;
+
+        if ((flags & preferred) == preferred) return i;
+        if (!fallback.has_value()) fallback = i;
+    }
+
+    if (fallback.has_value()) return fallback.value();
+
+    throw std::runtime_error("Failed to find suitable memory type!");
+}
+
+std::vector<VulkanAllocator::HeapStats> VulkanAllocator::GetHeapStats() const {
+    std::lock_guard lock(m_mutex);
+
+    std::vector<HeapStats> stats(m_memoryProperties.memoryHeapCount);
+    std::vector<VkDeviceSize> freeBytes(stats.size());
+
+    for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; ++i) {
+        stats[i].heapSize = m_memoryProperties.memoryHeaps[i].size;
+        stats[i].blockBytes = m_dedicatedBytes[i];
+        stats[i].usedBytes = m_dedicatedBytes[i];
+        stats[i].allocationCount = m_dedicatedCount[i];
+        stats[i].dedicatedAllocationCount = m_dedicatedCount[i];
+    }
+
+    for (uint32_t type = 0; type < m_memoryProperties.memoryTypeCount; ++type) {
+        const auto heapIndex = m_memoryProperties.memoryTypes[type].heapIndex;
+        auto &heap = stats[heapIndex];
+
+        for (const auto &blocks : m_blocks[type]) {
+            for (const auto &block : blocks) {
+                heap.blockBytes += block->ranges.GetSize();
+                heap.usedBytes += block->ranges.GetUsedSize();
+                heap.largestFreeRange = std::max(heap.largestFreeRange, block->ranges.GetLargestFreeRange());
+                heap.allocationCount += block->ranges.GetAllocationCount();
+                ++heap.blockCount;
+                freeBytes[heapIndex] += block->ranges.GetSize() - block->ranges.GetUsedSize();
+            }
+        }
+    }
+
+    for (size_t i = 0; i < stats.size(); ++i) {
+        if (freeBytes[i] > 0) {
+            stats[i].fragmentation = 1.0f - static_cast<float>(stats[i].largestFreeRange) / static_cast<float>(freeBytes[i]);
+        }
+    }
+
+    return stats;
+}
+
+void VulkanAllocator::PrintStats(std::ostream &out) const {
+    const auto stats = GetHeapStats();
+
+    for (size_t i = 0; i < stats.size(); ++i) {
+        const auto &heap = stats[i];
+        if (heap.blockBytes == 0) continue;
+
+        out << "Memory heap " << i
+            << ((m_memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local, " : " (")
+            << ToMiB(heap.heapSize) << " MiB): "
+            << ToMiB(heap.usedBytes) << " MiB used of " << ToMiB(heap.blockBytes) << " MiB in "
+            << heap.blockCount << " blocks and " << heap.dedicatedAllocationCount << " dedicated allocations, "
+            << heap.allocationCount << " allocations, fragmentation " << heap.fragmentation * 100.0f << "%" << std::endl;
+    }
+}
+
+VkDeviceSize VulkanAllocator::GetPreferredBlockSize(const uint32_t memoryTypeIndex) const {
+    const auto heapSize = m_memoryProperties.memoryHeaps[m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+    if (heapSize > SmallHeapMaxSize) return LargeHeapBlockSize;
+
+    return std::max(heapSize / 8, MinimumBlockSize);
+}
+
+VkDeviceMemory VulkanAllocator::AllocateDeviceMemory(const VkDeviceSize size, const uint32_t memoryTypeIndex, void **mapped) {
+    if (m_deviceMemoryCount >= m_maxMemoryAllocationCount) {
+        throw std::runtime_error("Exceeded maxMemoryAllocationCount!");
+    }
+
+    VkMemoryAllocateInfo allocateInfo{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .allocationSize = size,
+            .memoryTypeIndex = memoryTypeIndex};
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(m_device, &allocateInfo, nullptr, &memory) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate device memory!");
+    }
+    ++m_deviceMemoryCount;
+
+    // host visible memory stays mapped for the lifetime of the block, allocations just offset into it
+    *mapped = nullptr;
+    if (m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        if (vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+            vkFreeMemory(m_device, memory, nullptr);
+            --m_deviceMemoryCount;
+            throw std::runtime_error("Failed to map device memory!");
+        }
+    }
+
+    return memory;
+}
+
+void VulkanAllocator::FreeDeviceMemory(VkDeviceMemory memory) {
+    // freeing implicitly unmaps
+    vkFreeMemory(m_device, memory, nullptr);
+    --m_deviceMemoryCount;
+}
@@ -0,0 +1,98 @@
+#ifndef VULKANLEARNING_VULKANALLOCATOR_H
+#define VULKANLEARNING_VULKANALLOCATOR_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <ostream>
+
+enum class MemoryUsage
+{
+	// device local, never touched by the host
+	GpuOnly,
+	// host visible and coherent, written by the host and read by the device
+	CpuToGpu,
+	// host visible and coherent, preferably cached, written by the device and read by the host
+	GpuToCpu
+};
+
+class VulkanMemoryBlock;
+
+struct VulkanAllocation
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	// points at offset inside a persistently mapped block, nullptr unless the memory is host visible
+	void* mapped = nullptr;
+	uint32_t memoryTypeIndex = 0;
+
+	// block the range was carved from, nullptr for a dedicated allocation
+	VulkanMemoryBlock* block = nullptr;
+	uint32_t node = 0;
+};
+
+// Sub-allocates buffers and images out of a few large VkDeviceMemory blocks per memory type
+// instead of calling vkAllocateMemory for every resource.
+class VulkanAllocator
+{
+public:
+	struct HeapStats
+	{
+		VkDeviceSize heapSize = 0;
+		VkDeviceSize blockBytes = 0;
+		VkDeviceSize usedBytes = 0;
+		VkDeviceSize largestFreeRange = 0;
+		uint32_t blockCount = 0;
+		uint32_t allocationCount = 0;
+		uint32_t dedicatedAllocationCount = 0;
+		// 0 when every free byte is in one range, approaching 1 as the free space is scattered
+		float fragmentation = 0.0f;
+	};
+
+	VulkanAllocator(VkPhysicalDevice physicalDevice, VkDevice device);
+	~VulkanAllocator();
+
+	VulkanAllocator(const VulkanAllocator&) = delete;
+	VulkanAllocator& operator=(const VulkanAllocator&) = delete;
+
+	// linearResource is true for buffers and linear images, which must not share a
+	// bufferImageGranularity page with optimal images
+	[[nodiscard]] VulkanAllocation Allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, bool linearResource);
+	void Free(VulkanAllocation& allocation);
+
+	[[nodiscard]] VkBuffer CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage, VulkanAllocation& allocation);
+	[[nodiscard]] VkImage CreateImage(const VkImageCreateInfo& createInfo, MemoryUsage memoryUsage, VulkanAllocation& allocation);
+	void DestroyBuffer(VkBuffer buffer, VulkanAllocation& allocation);
+	void DestroyImage(VkImage image, VulkanAllocation& allocation);
+
+	[[nodiscard]] uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred) const;
+
+	[[nodiscard]] std::vector<HeapStats> GetHeapStats() const;
+	void PrintStats(std::ostream& out) const;
+
+private:
+	static constexpr size_t ResourceKindCount = 2;
+
+	[[nodiscard]] VkDeviceSize GetPreferredBlockSize(uint32_t memoryTypeIndex) const;
+	VkDeviceMemory AllocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mapped);
+	void FreeDeviceMemory(VkDeviceMemory memory);
+
+	VkPhysicalDevice m_physicalDevice;
+	VkDevice m_device;
+
+	VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+	VkDeviceSize m_bufferImageGranularity = 1;
+	uint32_t m_maxMemoryAllocationCount = 0;
+	uint32_t m_deviceMemoryCount = 0;
+
+	// indexed by memory type, then by resource kind when bufferImageGranularity keeps linear and optimal resources apart
+	std::vector<std::unique_ptr<VulkanMemoryBlock>> m_blocks[VK_MAX_MEMORY_TYPES][ResourceKindCount];
+	VkDeviceSize m_dedicatedBytes[VK_MAX_MEMORY_HEAPS]{};
+	uint32_t m_dedicatedCount[VK_MAX_MEMORY_HEAPS]{};
+
+	mutable std::mutex m_mutex;
+};
+
+#endif
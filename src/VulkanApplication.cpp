@@ -12,7 +12,115 @@ namespace {
     const std::vector<const char *> DeviceExtensions = {
             VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
-    constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+    constexpr VkFormat OffscreenImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+    double MillisecondsSince(const std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // input-to-present latency samples kept for the percentiles
+    constexpr size_t LATENCY_SAMPLE_CAPACITY = 1024;
+    // below this a secondary command buffer costs more than recording the draws inline
+    constexpr size_t MIN_DRAWS_PER_CHUNK = 256;
+    constexpr VkDeviceSize STAGING_RING_SIZE = 16 * 1024 * 1024;
+    // transient uniform and storage data of one frame
+    constexpr VkDeviceSize FRAME_ALLOCATOR_SIZE = 1024 * 1024;
+    // the smallest maxUniformBufferRange a device may have
+    constexpr VkDeviceSize FRAME_BINDING_RANGE = 16 * 1024;
+    // distinct material states, more materials than this share pipelines
+    constexpr uint32_t MATERIAL_BRIGHTNESS_LEVELS = 256;
+
+    // matches the push constant block in shader/shader_bindless.vert
+    struct ScenePushConstants
+    {
+        // bindless handle of the SceneObject buffer
+        uint32_t objectBuffer;
+    };
+
+    const std::vector<Vertex> TriangleVertices = {
+            {{0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}},
+            {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},
+            {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}}};
+    const std::vector<uint16_t> TriangleIndices = {0, 1, 2};
+    // distance from the triangle's origin to its farthest corner
+    constexpr float TriangleRadius = 0.7072f;
+
+    // Gribb-Hartmann extraction from a column-major view projection matrix, with Vulkan's 0..1 depth range
+    void ExtractFrustumPlanes(const float (&viewProjection)[16], float (&planes)[6][4]) {
+        const auto row = [&viewProjection](int r, int c) { return viewProjection[c * 4 + r]; };
+
+        for (int c = 0; c < 4; ++c) {
+            planes[0][c] = row(3, c) + row(0, c);
+            planes[1][c] = row(3, c) - row(0, c);
+            planes[2][c] = row(3, c) + row(1, c);
+            planes[3][c] = row(3, c) - row(1, c);
+            planes[4][c] = row(2, c);
+            planes[5][c] = row(3, c) - row(2, c);
+        }
+
+        for (auto &plane : planes) {
+            const auto length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+            for (auto &component : plane) {
+                component /= length;
+            }
+        }
+    }
+
+    size_t FramesInFlightFor(const LatencyPolicy policy) {
+        switch (policy) {
+            case LatencyPolicy::LowLatency:
+                return 1;
+            case LatencyPolicy::Throughput:
+                return 3;
+            default:
+                return 2;
+        }
+    }
+
+    const char *LatencyPolicyName(const LatencyPolicy policy) {
+        switch (policy) {
+            case LatencyPolicy::LowLatency:
+                return "low-latency";
+            case LatencyPolicy::Throughput:
+                return "throughput";
+            case LatencyPolicy::PowerSaving:
+                return "power-saving";
+            default:
+                return "balanced";
+        }
+    }
+
+    const char *PresentModeName(const VkPresentModeKHR presentMode) {
+        switch (presentMode) {
+            case VK_PRESENT_MODE_IMMEDIATE_KHR:
+                return "IMMEDIATE";
+            case VK_PRESENT_MODE_MAILBOX_KHR:
+                return "MAILBOX";
+            case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+                return "FIFO_RELAXED";
+            default:
+                return "FIFO";
+        }
+    }
+
+    // the layout transitions a render pass would do on its own, for dynamic rendering
+    void TransitionColorImage(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                              VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask,
+                              VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask) {
+        VkImageMemoryBarrier barrier{
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .pNext = nullptr,
+                .srcAccessMask = srcAccessMask,
+                .dstAccessMask = dstAccessMask,
+                .oldLayout = oldLayout,
+                .newLayout = newLayout,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = image,
+                .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = 1, .baseArrayLayer = 0, .layerCount = 1}};
+
+        vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
 
     VkResult CreateDebugUtilsMessengerExt(
             VkInstance instance,
@@ -49,38 +157,133 @@ namespace {
     }
 }
 
-VulkanApplication::VulkanApplication(const uint32_t width, const uint32_t height)
-    : m_width(width), m_height(height) {
+VulkanApplication::VulkanApplication(const uint32_t width, const uint32_t height, ApplicationOptions options)
+    : m_width(width), m_height(height), m_options(std::move(options)) {
+    if (!m_options.dumpPath.empty()) {
+        m_options.readback = true;
+    }
+    if (!m_options.batchPath.empty()) {
+        m_options.headless = true;
+        m_options.readback = true;
+    }
+
+    // the streamed textures are sampled through the bindless table
+    if (m_options.texturePaths.size() > MAX_SCENE_TEXTURES) {
+        std::cerr << "Only the first " << MAX_SCENE_TEXTURES << " of " << m_options.texturePaths.size() << " textures are used" << std::endl;
+        m_options.texturePaths.resize(MAX_SCENE_TEXTURES);
+    }
+    if (!m_options.texturePaths.empty()) {
+        m_options.bindless = true;
+    }
+
+    // the GPU-driven and bindless paths read the static object buffer, the instanced path streams its own data
+    if (m_options.instanced && (m_options.gpuCulling || m_options.bindless)) {
+        std::cerr << "--instanced is ignored together with --gpu-culling or --bindless" << std::endl;
+        m_options.instanced = false;
+    }
+
+    // the graph records its passes with dynamic rendering
+    if (m_options.graphPasses > 0) {
+        m_options.renderGraph = true;
+    }
+    if (m_options.renderGraph) {
+        m_options.dynamicRendering = true;
+    }
+
+    // a swap chain image can rarely be a storage image, its formats are mostly sRGB
+    if (m_options.postProcess && !m_options.headless) {
+        std::cerr << "--post-process needs --headless, it is ignored" << std::endl;
+        m_options.postProcess = false;
+    }
+
+    m_framesInFlight = m_options.framesInFlight > 0 ? m_options.framesInFlight : FramesInFlightFor(m_options.latencyPolicy);
+    m_frameInputTimes.resize(m_framesInFlight);
+    m_latencySamples.resize(LATENCY_SAMPLE_CAPACITY);
+
+    if (m_options.headless) return;
+
     glfwInit();
 
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
     m_pWindow = glfwCreateWindow(m_width, m_height, "Vulkan", nullptr, nullptr);
+    glfwSetWindowUserPointer(m_pWindow, this);
+    glfwSetFramebufferSizeCallback(m_pWindow, FramebufferResizeCallback);
 }
 
 VulkanApplication::~VulkanApplication() {
-    for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i){
+    // no pipeline may be built once the device starts going away
+    m_shaderHotReloader.reset();
+    m_pipelineCompiler.reset();
+    m_profiler.reset();
+
+    // its images go back to the allocator and its retired ones to the scheduler
+    m_textureStreamer.reset();
+    m_gpuCulling.reset();
+    m_postProcessor.reset();
+    m_renderGraphs.clear();
+    m_frameAllocator.reset();
+    // InitInstance() may have thrown before the allocator existed
+    if (m_allocator) {
+        for(size_t i = 0; i < m_readbackBuffers.size(); ++i){
+            m_allocator->DestroyBuffer(m_readbackBuffers[i], m_readbackAllocations[i]);
+        }
+        for(size_t i = 0; i < m_instanceBuffers.size(); ++i){
+            m_allocator->DestroyBuffer(m_instanceBuffers[i], m_instanceAllocations[i]);
+        }
+        m_allocator->DestroyBuffer(m_objectBuffer, m_objectAllocation);
+        m_allocator->DestroyBuffer(m_indexBuffer, m_indexAllocation);
+        m_allocator->DestroyBuffer(m_vertexBuffer, m_vertexAllocation);
+    }
+    m_uploader.reset();
+
+    for(size_t i = 0; i < m_imageAvailableSemaphores.size(); ++i){
         vkDestroySemaphore(m_device, m_renderFinishedSemaphores[i], nullptr);
         vkDestroySemaphore(m_device, m_imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(m_device, m_inFlightFences[i], nullptr);
     }
 
-    vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+    // runs the deletions still waiting for the timelines, retired swap chains and pipelines among them
+    m_scheduler.reset();
+
+    m_recordThreadPool.reset();
+    for(const auto &frameCommands : m_frameCommands){
+        for(auto workerCommandPool : frameCommands.workerCommandPools){
+            vkDestroyCommandPool(m_device, workerCommandPool, nullptr);
+        }
+        vkDestroyCommandPool(m_device, frameCommands.commandPool, nullptr);
+    }
 
     for(auto framebuffer : m_swapChainFramebuffer){
         vkDestroyFramebuffer(m_device, framebuffer, nullptr);
     }
 
+    // its material pipelines are still the registry's
+    if (m_reloadedPipelines) {
+        vkDestroyPipeline(m_device, m_reloadedPipelines->graphicsPipeline, nullptr);
+    }
     vkDestroyPipeline(m_device, m_graphicsPipeline, nullptr);
-    vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+    m_pipelineRegistry.reset();
+    m_bindless.reset();
+
+    SavePipelineCache();
+    vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
+
     vkDestroyRenderPass(m_device, m_renderPass, nullptr);
 
     for(auto imageView : m_swapChainImageViews){
         vkDestroyImageView(m_device, imageView, nullptr);
     }
 
+    if (m_options.headless) {
+        for (size_t i = 0; i < m_offscreenImageAllocations.size(); ++i) {
+            m_allocator->DestroyImage(m_swapChainImages[i], m_offscreenImageAllocations[i]);
+        }
+    }
+
     vkDestroySwapchainKHR(m_device, m_swapChain, nullptr);
+    m_shaderModules.reset();
+    m_allocator.reset();
     vkDestroyDevice(m_device, nullptr);
 
     if (EnableValidationLayers) {
@@ -90,41 +293,124 @@ VulkanApplication::~VulkanApplication() {
     vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
     vkDestroyInstance(m_instance, nullptr);
 
-    glfwDestroyWindow(m_pWindow);
+    if (m_pWindow != nullptr) {
+        glfwDestroyWindow(m_pWindow);
 
-    glfwTerminate();
+        glfwTerminate();
+    }
 }
 
 void VulkanApplication::InitInstance() {
+    PROFILE_FUNCTION();
+
+    const auto initStart = std::chrono::steady_clock::now();
+
     CreateInstance();
     SetupDebugMessenger();
-    CreateSurface();
+    if (!m_options.headless) {
+        CreateSurface();
+    }
     PickPhysicalDevice();
     CreateLogicalDevice();
-    CreateSwapChain();
+    CreateFrameScheduler();
+    m_allocator = std::make_unique<VulkanAllocator>(m_physicalDevice, m_device);
+    m_shaderModules = std::make_unique<ShaderModuleCache>(m_device, "../shader");
+    if (m_options.bindless) {
+        CreateBindlessTable();
+    }
+    CreateStagingUploader();
+    CreateFrameAllocator();
+    CreatePipelineCache();
+    if (m_options.headless) {
+        CreateOffscreenImages();
+    } else {
+        CreateSwapChain();
+    }
     CreateImageViews();
     CreateRenderPass();
+
+    const auto pipelineStart = std::chrono::steady_clock::now();
     CreateGraphicsPipeline();
+    const auto pipelineMs = MillisecondsSince(pipelineStart);
+    if (m_options.pipelinePermutations > 0) {
+        CreatePipelineCompiler();
+    }
+
     CreateFramebuffer();
     CreateCommandPool();
+    if (m_options.headless) {
+        CreateReadbackBuffers();
+    }
+    if (m_options.headless || m_options.gpuProfile) {
+        CreateGpuProfiler();
+    }
+    CreateMeshBuffers();
+    if (!m_options.texturePaths.empty()) {
+        CreateTextureStreamer();
+    }
+    CreateSceneObjects();
+    if (m_options.gpuCulling) {
+        CreateGpuCulling();
+    }
+    if (m_options.postProcess) {
+        CreatePostProcessor();
+    }
+    if (m_options.renderGraph) {
+        CreateRenderGraphs();
+    }
     CreateCommandBuffer();
     CreateSyncObjects();
+    if (m_options.hotReload) {
+        CreateShaderHotReloader();
+    }
+
+    std::cout << "Startup took " << MillisecondsSince(initStart) << " ms, pipeline creation " << pipelineMs
+              << " ms (" << (m_pipelineCacheWarm ? "warm" : "cold") << " pipeline cache)" << std::endl;
 }
 
 void VulkanApplication::Run(){
+    if (!m_options.batchPath.empty()) {
+        RunBatch();
+        return;
+    }
+    if (m_options.headless) {
+        RunHeadless();
+        return;
+    }
+
     while (!glfwWindowShouldClose(m_pWindow)) {
         glfwPollEvents();
+        m_lastInputTime = std::chrono::steady_clock::now();
         DrawFrame();
     }
 
     vkDeviceWaitIdle(m_device);
+    MeasureFrameLatency();
+    ReportLatency();
+    ReportFrameScheduler();
+    ReportRenderGraph();
+    ReportTextureStreamer();
+    ReportFrameAllocator();
+    ReportPipelineCompiler();
+    ReportGpuProfile();
+    WriteCpuTrace();
 }
 
 void VulkanApplication::CreateInstance() {
+    PROFILE_FUNCTION();
     if (EnableValidationLayers && !CheckValidationLayerSupport()) {
         throw std::runtime_error("validation layers requested, but not available!");
     }
 
+    // timeline semaphores, dynamic rendering and descriptor indexing are core in newer Vulkan versions and
+    // build on 1.1 or 1.2 as extensions, so ask for the newest the loader offers
+    const auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+            vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+    if (enumerateInstanceVersion != nullptr) {
+        enumerateInstanceVersion(&m_instanceApiVersion);
+    }
+    m_instanceApiVersion = std::min(m_instanceApiVersion, VK_API_VERSION_1_3);
+
     VkApplicationInfo appInfo =
             {
                     .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
@@ -133,7 +419,7 @@ void VulkanApplication::CreateInstance() {
                     .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
                     .pEngineName = "No Engine",
                     .engineVersion = VK_MAKE_VERSION(1, 0, 0),
-                    .apiVersion = VK_API_VERSION_1_0};
+                    .apiVersion = m_instanceApiVersion};
 
     auto extensions = GetRequiredExtensions();
     VkInstanceCreateInfo createInfo =
@@ -178,6 +464,7 @@ void VulkanApplication::PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCr
 }
 
 void VulkanApplication::SetupDebugMessenger() {
+    PROFILE_FUNCTION();
     if constexpr (!EnableValidationLayers) return;
 
     VkDebugUtilsMessengerCreateInfoEXT createInfo;
@@ -189,12 +476,14 @@ void VulkanApplication::SetupDebugMessenger() {
 }
 
 void VulkanApplication::CreateSurface() {
+    PROFILE_FUNCTION();
     if (glfwCreateWindowSurface(m_instance, m_pWindow, nullptr, &m_surface) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create window surface!");
     }
 }
 
 void VulkanApplication::PickPhysicalDevice() {
+    PROFILE_FUNCTION();
     uint32_t deviceCount = 0;
     vkEnumeratePhysicalDevices(m_instance, &deviceCount, nullptr);
 
@@ -205,25 +494,111 @@ void VulkanApplication::PickPhysicalDevice() {
     std::vector<VkPhysicalDevice> devices(deviceCount);
     vkEnumeratePhysicalDevices(m_instance, &deviceCount, devices.data());
 
+    std::vector<DeviceCandidate> candidates;
     for (const auto &device : devices) {
         if (IsDeviceSuitable(device)) {
-            m_physicalDevice = device;
-            break;
+            candidates.push_back(RateDevice(device));
         }
     }
 
-    if (m_physicalDevice == nullptr) {
+    if (candidates.empty()) {
         throw std::runtime_error("Failed to find a suitable GPU!");
     }
+
+    // devices that form a group with others, such as linked GPUs, are only rendered on one at a time
+    uint32_t groupCount = 0;
+    vkEnumeratePhysicalDeviceGroups(m_instance, &groupCount, nullptr);
+    std::vector<VkPhysicalDeviceGroupProperties> groups(groupCount);
+    for (auto &group : groups) {
+        group.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GROUP_PROPERTIES;
+        group.pNext = nullptr;
+    }
+    vkEnumeratePhysicalDeviceGroups(m_instance, &groupCount, groups.data());
+    for (auto &candidate : candidates) {
+        for (const auto &group : groups) {
+            const auto end = group.physicalDevices + group.physicalDeviceCount;
+            if (std::find(group.physicalDevices, end, candidate.device) != end) {
+                candidate.groupSize = group.physicalDeviceCount;
+            }
+        }
+    }
+
+    // the order of enumeration is up to the loader, which often puts an integrated GPU first
+    std::stable_sort(candidates.begin(), candidates.end(), [](const DeviceCandidate &lhs, const DeviceCandidate &rhs) {
+        return lhs.score > rhs.score;
+    });
+    m_suitableDeviceCount = candidates.size();
+
+    size_t chosen = 0;
+    if (!m_options.device.empty()) {
+        chosen = candidates.size();
+        for (size_t i = 0; i < candidates.size() && chosen == candidates.size(); ++i) {
+            if (MatchesDevice(candidates[i], i, m_options.device)) {
+                chosen = i;
+            }
+        }
+        if (chosen == candidates.size()) {
+            throw std::runtime_error("Failed to find the GPU " + m_options.device + "!");
+        }
+    }
+    m_physicalDevice = candidates[chosen].device;
+
+    // an application picked by rank runs next to others, which have printed the ranking already
+    const auto byRank = !m_options.device.empty() &&
+                        std::all_of(m_options.device.begin(), m_options.device.end(), [](const char c) { return c >= '0' && c <= '9'; });
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        const auto &candidate = candidates[i];
+        if (byRank && i != chosen) continue;
+
+        const char *type = "other";
+        switch (candidate.properties.deviceType) {
+            case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: type = "discrete"; break;
+            case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: type = "integrated"; break;
+            case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: type = "virtual"; break;
+            case VK_PHYSICAL_DEVICE_TYPE_CPU: type = "CPU"; break;
+            default: break;
+        }
+
+        std::cout << (i == chosen ? "* " : "  ") << "GPU " << i << ": " << candidate.properties.deviceName << " (" << type << ", "
+                  << (candidate.localMemory >> 20) << " MiB device local"
+                  << (candidate.transferQueue ? ", transfer queue" : "") << (candidate.asyncComputeQueue ? ", async compute queue" : "");
+        if (candidate.groupSize > 1) {
+            std::cout << ", group of " << candidate.groupSize;
+        }
+        std::cout << ") " << candidate.uuid << std::endl;
+    }
 }
 
 void VulkanApplication::CreateLogicalDevice() {
+    PROFILE_FUNCTION();
     auto indices = FindQueueFamilies(m_physicalDevice);
 
-    std::set<uint32_t> uniqueQueueFamilies =
-            {
-                    indices.graphicsFamily.value(),
-                    indices.presentFamily.value()};
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &deviceProperties);
+
+    if (m_options.postProcess) {
+        // a software ICD exposes its queues but runs them one after the other, a second queue only adds synchronization
+        if (m_options.asyncCompute && (!indices.asyncComputeFamily.has_value() || deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU)) {
+            std::cerr << "No dedicated compute queue family on a hardware device, post-processing runs on the graphics queue" << std::endl;
+            m_options.asyncCompute = false;
+        }
+        if (!m_options.asyncCompute && indices.computeFamily != indices.graphicsFamily) {
+            std::cerr << "Post-processing needs a compute queue, it is disabled" << std::endl;
+            m_options.postProcess = false;
+        }
+    }
+    const auto asyncCompute = m_options.postProcess && m_options.asyncCompute;
+
+    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value()};
+    if (indices.presentFamily.has_value()) {
+        uniqueQueueFamilies.insert(indices.presentFamily.value());
+    }
+    if (indices.transferFamily.has_value()) {
+        uniqueQueueFamilies.insert(indices.transferFamily.value());
+    }
+    if (asyncCompute) {
+        uniqueQueueFamilies.insert(indices.asyncComputeFamily.value());
+    }
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 
@@ -239,19 +614,159 @@ void VulkanApplication::CreateLogicalDevice() {
                 .pQueuePriorities = &queuePriority});
     }
 
-    VkPhysicalDeviceFeatures deviceFeatures{};
+    auto deviceExtensions = GetRequiredDeviceExtensions();
+
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(m_physicalDevice, &supportedFeatures);
+
+    auto &deviceFeatures = m_enabledFeatures;
+    // GPU-driven draws select their object through firstInstance, the rest only saves draw calls
+    const auto drawIndirectCount = m_options.gpuCulling && HasDeviceExtension(m_physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    if (m_options.gpuCulling) {
+        deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+        deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+        if (drawIndirectCount) {
+            deviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        }
+    }
+    if (m_options.headless || m_options.gpuProfile) {
+        deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+        deviceFeatures.inheritedQueries = supportedFeatures.inheritedQueries;
+    }
+
+    const auto apiVersion = std::min(m_instanceApiVersion, deviceProperties.apiVersion);
+    const auto core13 = apiVersion >= VK_API_VERSION_1_3;
+    // the extension also needs create_renderpass2 and depth_stencil_resolve, which 1.2 has in core
+    auto dynamicRendering = m_options.dynamicRendering && apiVersion >= VK_API_VERSION_1_2 &&
+                            (core13 || HasDeviceExtension(m_physicalDevice, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME));
+    const auto extendedDynamicStateExtension = dynamicRendering && !core13 &&
+                                               HasDeviceExtension(m_physicalDevice, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+    auto extendedDynamicState = false;
+    // descriptor indexing is core in 1.2, the extension needs maintenance3 which 1.1 has in core
+    const auto descriptorIndexingExtension = apiVersion < VK_API_VERSION_1_2 &&
+                                             HasDeviceExtension(m_physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    auto bindless = m_options.bindless && apiVersion >= VK_API_VERSION_1_1 && (apiVersion >= VK_API_VERSION_1_2 || descriptorIndexingExtension);
+    // the render graph prefers vkCmdPipelineBarrier2 but works without it
+    const auto synchronization2Extension = m_options.renderGraph && !core13 &&
+                                           HasDeviceExtension(m_physicalDevice, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+    auto synchronization2 = m_options.renderGraph && (core13 || synchronization2Extension);
+
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT,
+            .pNext = nullptr,
+            .extendedDynamicState = VK_FALSE};
+    VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeatures{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES,
+            .pNext = nullptr,
+            .dynamicRendering = VK_FALSE};
+    VkPhysicalDeviceSynchronization2Features synchronization2Features{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES,
+            .pNext = nullptr,
+            .synchronization2 = VK_FALSE};
+    VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures{};
+    descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    // required, IsDeviceSuitable() has checked for it
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+            .pNext = nullptr,
+            .timelineSemaphore = VK_TRUE};
+    VkPhysicalDeviceFeatures2 features2{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = nullptr,
+            .features = {}};
+
+    // only the structures of features the device knows may be chained, when querying as well as when enabling
+    void **chainEnd = &features2.pNext;
+    const auto chain = [&chainEnd](auto &features) {
+        features.pNext = nullptr;
+        *chainEnd = &features;
+        chainEnd = &features.pNext;
+    };
+
+    if (dynamicRendering) {
+        chain(dynamicRenderingFeatures);
+    }
+    if (extendedDynamicStateExtension) {
+        chain(extendedDynamicStateFeatures);
+    }
+    if (bindless) {
+        chain(descriptorIndexingFeatures);
+    }
+    if (synchronization2) {
+        chain(synchronization2Features);
+    }
+    if (features2.pNext != nullptr) {
+        vkGetPhysicalDeviceFeatures2(m_physicalDevice, &features2);
+        dynamicRendering = dynamicRendering && dynamicRenderingFeatures.dynamicRendering;
+        // core in 1.3 without a feature bit of its own
+        extendedDynamicState = dynamicRendering && (core13 || extendedDynamicStateFeatures.extendedDynamicState);
+        bindless = bindless && BindlessTable::IsSupported(supportedFeatures, descriptorIndexingFeatures);
+        synchronization2 = synchronization2 && synchronization2Features.synchronization2;
+    }
+    if (m_options.dynamicRendering && !dynamicRendering) {
+        std::cerr << "Dynamic rendering needs Vulkan 1.3 or VK_KHR_dynamic_rendering on Vulkan 1.2, falling back to render passes" << std::endl;
+        m_options.dynamicRendering = false;
+        if (m_options.renderGraph) {
+            std::cerr << "The render graph records its passes with dynamic rendering, it is disabled" << std::endl;
+            m_options.renderGraph = false;
+        }
+    }
+    if (m_options.bindless && !bindless) {
+        std::cerr << "Bindless resources need descriptor indexing (Vulkan 1.2 or VK_EXT_descriptor_indexing), falling back to vertex attributes" << std::endl;
+        m_options.bindless = false;
+        if (!m_options.texturePaths.empty()) {
+            std::cerr << "The streamed textures are sampled through the bindless table, they are disabled" << std::endl;
+            m_options.texturePaths.clear();
+        }
+    }
+
+    // the optional features are enabled through the same chain, which rules out pEnabledFeatures
+    features2.pNext = nullptr;
+    chainEnd = &features2.pNext;
+    chain(timelineSemaphoreFeatures);
+    if (apiVersion < VK_API_VERSION_1_2) {
+        deviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    }
+    if (dynamicRendering) {
+        chain(dynamicRenderingFeatures);
+        if (!core13) {
+            deviceExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+        }
+    }
+    if (extendedDynamicState && extendedDynamicStateExtension) {
+        chain(extendedDynamicStateFeatures);
+        deviceExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+    }
+    if (bindless) {
+        descriptorIndexingFeatures = BindlessTable::RequiredFeatures();
+        chain(descriptorIndexingFeatures);
+        deviceFeatures.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+        deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+        if (descriptorIndexingExtension) {
+            deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        }
+    }
+    if (synchronization2 && m_options.renderGraph) {
+        chain(synchronization2Features);
+        if (!core13) {
+            deviceExtensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+        }
+    }
+    const auto enableFeatures2 = features2.pNext != nullptr;
+    features2.features = deviceFeatures;
+
     VkDeviceCreateInfo createInfo =
             {
                     .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-                    .pNext = nullptr,
+                    .pNext = enableFeatures2 ? &features2 : nullptr,
                     .flags = 0,
                     .queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size()),
                     .pQueueCreateInfos = queueCreateInfos.data(),
                     .enabledLayerCount = 0,
                     .ppEnabledLayerNames = nullptr,
-                    .enabledExtensionCount = static_cast<uint32_t>(DeviceExtensions.size()),
-                    .ppEnabledExtensionNames = DeviceExtensions.data(),
-                    .pEnabledFeatures = &deviceFeatures};
+                    .enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size()),
+                    .ppEnabledExtensionNames = deviceExtensions.data(),
+                    .pEnabledFeatures = enableFeatures2 ? nullptr : &deviceFeatures};
 
     if (EnableValidationLayers) {
         createInfo.enabledLayerCount = static_cast<uint32_t>(ValidationLayers.size());
@@ -263,20 +778,173 @@ void VulkanApplication::CreateLogicalDevice() {
     }
 
     vkGetDeviceQueue(m_device, indices.graphicsFamily.value(), 0, &m_graphicsQueue);
-    vkGetDeviceQueue(m_device, indices.presentFamily.value(), 0, &m_presentQueue);
+    if (indices.presentFamily.has_value()) {
+        vkGetDeviceQueue(m_device, indices.presentFamily.value(), 0, &m_presentQueue);
+    }
+    vkGetDeviceQueue(m_device, indices.transferFamily.value_or(indices.graphicsFamily.value()), 0, &m_transferQueue);
+    vkGetDeviceQueue(m_device, asyncCompute ? indices.asyncComputeFamily.value() : indices.graphicsFamily.value(), 0, &m_computeQueue);
+
+    if (dynamicRendering) {
+        m_renderingSupport.beginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(
+                vkGetDeviceProcAddr(m_device, core13 ? "vkCmdBeginRendering" : "vkCmdBeginRenderingKHR"));
+        m_renderingSupport.endRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(
+                vkGetDeviceProcAddr(m_device, core13 ? "vkCmdEndRendering" : "vkCmdEndRenderingKHR"));
+        if (extendedDynamicState) {
+            m_renderingSupport.setCullMode = reinterpret_cast<PFN_vkCmdSetCullModeEXT>(
+                    vkGetDeviceProcAddr(m_device, core13 ? "vkCmdSetCullMode" : "vkCmdSetCullModeEXT"));
+            m_renderingSupport.setFrontFace = reinterpret_cast<PFN_vkCmdSetFrontFaceEXT>(
+                    vkGetDeviceProcAddr(m_device, core13 ? "vkCmdSetFrontFace" : "vkCmdSetFrontFaceEXT"));
+        }
+    }
+
+    if (synchronization2 && m_options.renderGraph) {
+        m_renderingSupport.pipelineBarrier2 = reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(
+                vkGetDeviceProcAddr(m_device, core13 ? "vkCmdPipelineBarrier2" : "vkCmdPipelineBarrier2KHR"));
+    }
+
+    if (m_options.gpuCulling) {
+        if (!deviceFeatures.drawIndirectFirstInstance || indices.computeFamily != indices.graphicsFamily) {
+            std::cerr << "GPU culling needs drawIndirectFirstInstance and a graphics queue with compute, falling back to CPU draws" << std::endl;
+            m_options.gpuCulling = false;
+            return;
+        }
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+
+        m_drawSupport.multiDrawIndirect = deviceFeatures.multiDrawIndirect;
+        m_drawSupport.maxDrawIndirectCount = deviceFeatures.multiDrawIndirect ? properties.limits.maxDrawIndirectCount : 1;
+        if (drawIndirectCount) {
+            m_drawSupport.drawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+                    vkGetDeviceProcAddr(m_device, "vkCmdDrawIndexedIndirectCountKHR"));
+        }
+    }
+}
+
+void VulkanApplication::CreateFrameScheduler() {
+    PROFILE_FUNCTION();
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+
+    m_scheduler = std::make_unique<FrameScheduler>(m_device, std::min(m_instanceApiVersion, properties.apiVersion) >= VK_API_VERSION_1_2, m_framesInFlight);
+}
+
+void VulkanApplication::CreateStagingUploader() {
+    PROFILE_FUNCTION();
+    const auto indices = FindQueueFamilies(m_physicalDevice);
+    const auto graphicsFamily = indices.graphicsFamily.value();
+
+    m_uploader = std::make_unique<StagingUploader>(m_device, *m_allocator, *m_scheduler, m_transferQueue,
+                                                   indices.transferFamily.value_or(graphicsFamily), graphicsFamily, STAGING_RING_SIZE);
+}
+
+void VulkanApplication::CreateFrameAllocator() {
+    PROFILE_FUNCTION();
+    m_frameAllocator = std::make_unique<FrameAllocator>(m_physicalDevice, m_device, *m_allocator, m_framesInFlight,
+                                                        FRAME_ALLOCATOR_SIZE, FRAME_BINDING_RANGE);
+}
+
+void VulkanApplication::CreatePipelineCache() {
+    PROFILE_FUNCTION();
+    std::vector<char> initialData;
+    if (!m_options.pipelineCachePath.empty()) {
+        initialData = LoadPipelineCacheData();
+    }
+    m_pipelineCacheWarm = !initialData.empty();
+
+    VkPipelineCacheCreateInfo createInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .initialDataSize = initialData.size(),
+            .pInitialData = initialData.empty() ? nullptr : initialData.data()};
+
+    if (vkCreatePipelineCache(m_device, &createInfo, nullptr, &m_pipelineCache) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create pipeline cache!");
+    }
+}
+
+std::vector<char> VulkanApplication::LoadPipelineCacheData() const {
+    std::ifstream file(m_options.pipelineCachePath, std::ios::ate | std::ios::binary);
+
+    // no cache yet, this is a cold start
+    if (!file.is_open()) return {};
+
+    std::vector<char> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(data.data(), static_cast<std::streamsize>(data.size()));
+
+    if (!file || !IsPipelineCacheCompatible(data)) {
+        std::cerr << "Discarding stale pipeline cache " << m_options.pipelineCachePath << std::endl;
+        return {};
+    }
+
+    return data;
+}
+
+bool VulkanApplication::IsPipelineCacheCompatible(const std::vector<char> &data) const {
+    // VkPipelineCacheHeaderVersionOne: headerSize, headerVersion, vendorID, deviceID, pipelineCacheUUID
+    uint32_t header[4];
+    constexpr size_t headerSize = sizeof(header) + VK_UUID_SIZE;
+
+    if (data.size() < headerSize) return false;
+
+    std::memcpy(header, data.data(), sizeof(header));
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+
+    return header[0] >= headerSize &&
+           header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header[2] == properties.vendorID &&
+           header[3] == properties.deviceID &&
+           std::memcmp(data.data() + sizeof(header), properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
 }
 
+void VulkanApplication::SavePipelineCache() const {
+    if (m_pipelineCache == VK_NULL_HANDLE || m_options.pipelineCachePath.empty()) return;
+
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) return;
+
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, data.data()) != VK_SUCCESS) return;
+
+    // write next to the old cache and swap it in, so an interrupted write never leaves a truncated cache behind
+    const auto tempPath = m_options.pipelineCachePath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), static_cast<std::streamsize>(dataSize));
+
+        if (!file) {
+            std::cerr << "Failed to write pipeline cache " << tempPath << std::endl;
+            return;
+        }
+    }
+
+    if (std::rename(tempPath.c_str(), m_options.pipelineCachePath.c_str()) != 0) {
+        std::cerr << "Failed to replace pipeline cache " << m_options.pipelineCachePath << std::endl;
+        std::remove(tempPath.c_str());
+    }
+}
 
 void VulkanApplication::CreateSwapChain() {
+    PROFILE_FUNCTION();
     const auto swapChainSupport = QuerySwapChainSupport(m_physicalDevice);
 
     const auto surfaceFormat = ChooseSwapSurfaceFormat(swapChainSupport.formats);
-    const auto presentMode = ChooseSwapChainMode(swapChainSupport.presentModes);
+    const auto presentMode = ChooseSwapChainMode(swapChainSupport.presentModes, m_options.latencyPolicy);
     const auto extent = ChooseSwapExtent(swapChainSupport.capabilities);
 
-    auto imageCount = swapChainSupport.capabilities.minImageCount + 1;
-    if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
-        imageCount = swapChainSupport.capabilities.maxImageCount;
+    auto imageCount = ChooseSwapImageCount(swapChainSupport.capabilities);
+
+    // the last pass of a longer render graph copies into the swap chain image
+    VkImageUsageFlags imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if (m_options.graphPasses > 0) {
+        if ((swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) == 0) {
+            throw std::runtime_error("Failed to find swap chain images that can be copied to!");
+        }
+        imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
     }
 
     VkSwapchainCreateInfoKHR createInfo =
@@ -290,7 +958,7 @@ void VulkanApplication::CreateSwapChain() {
                     .imageColorSpace = surfaceFormat.colorSpace,
                     .imageExtent = extent,
                     .imageArrayLayers = 1,
-                    .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                    .imageUsage = imageUsage,
                     .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
                     .queueFamilyIndexCount = 0,
                     .pQueueFamilyIndices = nullptr,
@@ -298,7 +966,7 @@ void VulkanApplication::CreateSwapChain() {
                     .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
                     .presentMode = presentMode,
                     .clipped = VK_TRUE,
-                    .oldSwapchain = nullptr};
+                    .oldSwapchain = m_swapChain};
 
     auto indices = FindQueueFamilies(m_physicalDevice);
 
@@ -310,9 +978,12 @@ void VulkanApplication::CreateSwapChain() {
         createInfo.pQueueFamilyIndices = queueFamilyIndices;
     }
 
-    if (vkCreateSwapchainKHR(m_device, &createInfo, nullptr, &m_swapChain) != VK_SUCCESS) {
+    // the previous swap chain (if any) becomes retired, its owner destroys it once its frames are done
+    VkSwapchainKHR swapChain;
+    if (vkCreateSwapchainKHR(m_device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create swap chain!");
     }
+    m_swapChain = swapChain;
 
     vkGetSwapchainImagesKHR(m_device, m_swapChain, &imageCount, nullptr);
     m_swapChainImages.resize(imageCount);
@@ -320,9 +991,103 @@ void VulkanApplication::CreateSwapChain() {
 
     m_swapChainImageFormat = surfaceFormat.format;
     m_swapChainExtent = extent;
+    m_presentMode = presentMode;
+}
+
+void VulkanApplication::RecreateSwapChain() {
+    PROFILE_FUNCTION();
+    int width = 0;
+    int height = 0;
+    glfwGetFramebufferSize(m_pWindow, &width, &height);
+
+    // a minimized window has nothing to render to, wait until it comes back
+    while (width == 0 || height == 0) {
+        if (glfwWindowShouldClose(m_pWindow)) return;
+
+        glfwWaitEvents();
+        glfwGetFramebufferSize(m_pWindow, &width, &height);
+    }
+
+    m_width = static_cast<uint32_t>(width);
+    m_height = static_cast<uint32_t>(height);
+    m_framebufferResized = false;
+
+    // frames that are still in flight keep presenting from the old swap chain, so everything that
+    // depends on its images is destroyed once the graphics timeline has passed them
+    m_scheduler->DeferDeletion(FrameScheduler::Queue::Graphics,
+                               [device = m_device, swapChain = m_swapChain, imageViews = std::move(m_swapChainImageViews),
+                                framebuffers = std::move(m_swapChainFramebuffer)] {
+                                   for (auto framebuffer : framebuffers) {
+                                       vkDestroyFramebuffer(device, framebuffer, nullptr);
+                                   }
+                                   for (auto imageView : imageViews) {
+                                       vkDestroyImageView(device, imageView, nullptr);
+                                   }
+                                   vkDestroySwapchainKHR(device, swapChain, nullptr);
+                               });
+    m_swapChainImageViews.clear();
+    m_swapChainFramebuffer.clear();
+
+    // the surface format does not change with the extent, so the render pass and the pipeline
+    // (which takes viewport and scissor as dynamic state) stay valid
+    CreateSwapChain();
+    CreateImageViews();
+    CreateFramebuffer();
+
+    m_imagesInFlight.assign(m_swapChainImages.size(), 0);
+}
+
+void VulkanApplication::FramebufferResizeCallback(GLFWwindow *window, int, int) {
+    auto app = static_cast<VulkanApplication *>(glfwGetWindowUserPointer(window));
+    app->m_framebufferResized = true;
+}
+
+void VulkanApplication::CreateOffscreenImages() {
+    PROFILE_FUNCTION();
+    // headless mode fills the swap chain members with its own images so that the image views,
+    // framebuffers and command buffers are shared with the windowed path
+    m_swapChainImageFormat = OffscreenImageFormat;
+    m_swapChainExtent = {m_width, m_height};
+
+    m_swapChainImages.resize(m_framesInFlight);
+    m_offscreenImageAllocations.resize(m_framesInFlight);
+
+    // the post pass reads the scene as a storage image, the render graph's last copy writes it
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    if (m_options.postProcess) {
+        usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+    }
+    if (m_options.graphPasses > 0) {
+        usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
+
+    for (size_t i = 0; i < m_framesInFlight; ++i) {
+        VkImageCreateInfo createInfo{
+                .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .imageType = VK_IMAGE_TYPE_2D,
+                .format = m_swapChainImageFormat,
+                .extent = {m_swapChainExtent.width, m_swapChainExtent.height, 1},
+                .mipLevels = 1,
+                .arrayLayers = 1,
+                .samples = VK_SAMPLE_COUNT_1_BIT,
+                .tiling = VK_IMAGE_TILING_OPTIMAL,
+                .usage = usage,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                .queueFamilyIndexCount = 0,
+                .pQueueFamilyIndices = nullptr,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+
+        m_swapChainImages[i] = m_allocator->CreateImage(createInfo, MemoryUsage::GpuOnly, m_offscreenImageAllocations[i]);
+    }
 }
 
 void VulkanApplication::CreateRenderPass() {
+    PROFILE_FUNCTION();
+    // dynamic rendering describes its attachments when it begins, the layout transitions are recorded by hand
+    if (m_options.dynamicRendering) return;
+
     VkAttachmentDescription attachmentDescription{
         .flags = 0,
         .format = m_swapChainImageFormat,
@@ -332,7 +1097,7 @@ void VulkanApplication::CreateRenderPass() {
         .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+        .finalLayout = m_options.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
     };
 
     VkAttachmentReference attachmentReference{
@@ -353,6 +1118,18 @@ void VulkanApplication::CreateRenderPass() {
             .pPreserveAttachments = nullptr
     };
 
+    // headless frames are copied out right after the render pass, so the color writes
+    // have to be visible to the transfer stage
+    VkSubpassDependency readbackDependency{
+            .srcSubpass = 0,
+            .dstSubpass = VK_SUBPASS_EXTERNAL,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+            .dependencyFlags = 0
+    };
+
     VkRenderPassCreateInfo renderPassCreateInfo{
             .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
             .pNext = nullptr,
@@ -361,8 +1138,8 @@ void VulkanApplication::CreateRenderPass() {
             .pAttachments = &attachmentDescription,
             .subpassCount = 1,
             .pSubpasses = &subpassDescription,
-            .dependencyCount = 0,
-            .pDependencies = nullptr
+            .dependencyCount = m_options.headless ? 1u : 0u,
+            .pDependencies = m_options.headless ? &readbackDependency : nullptr
     };
 
     if(vkCreateRenderPass(m_device, &renderPassCreateInfo, nullptr, &m_renderPass) != VK_SUCCESS){
@@ -371,6 +1148,7 @@ void VulkanApplication::CreateRenderPass() {
 }
 
 void VulkanApplication::CreateImageViews() {
+    PROFILE_FUNCTION();
     m_swapChainImageViews.resize(m_swapChainImages.size());
 
     for (size_t i = 0; i < m_swapChainImages.size(); ++i) {
@@ -395,159 +1173,243 @@ void VulkanApplication::CreateImageViews() {
     }
 }
 
-void VulkanApplication::CreateGraphicsPipeline() {
-    auto vertShaderModule = createShaderModuleFromFile(m_device, "../shader/vert.spv");
-    auto fragShaderModule = createShaderModuleFromFile(m_device, "../shader/frag.spv");
+void VulkanApplication::CreateBindlessTable() {
+    PROFILE_FUNCTION();
+    m_bindless = std::make_unique<BindlessTable>(m_physicalDevice, m_device, *m_scheduler, BindlessTable::Capacity{});
 
-    VkPipelineShaderStageCreateInfo vertShaderStageInfo{
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .stage = VK_SHADER_STAGE_VERTEX_BIT,
-            .module = vertShaderModule,
-            .pName = "main",
-            .pSpecializationInfo = nullptr};
-    VkPipelineShaderStageCreateInfo fragShaderStageInfo{
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-            .module = fragShaderModule,
-            .pName = "main",
-            .pSpecializationInfo = nullptr};
+    const auto capacity = m_bindless->GetCapacity();
+    std::cout << "Bindless table with " << capacity.storageBuffers << " storage buffers, " << capacity.sampledImages
+              << " sampled images and " << capacity.samplers << " samplers" << std::endl;
+}
 
-    VkPipelineShaderStageCreateInfo shaderStageCreateInfo[] = {vertShaderStageInfo, fragShaderStageInfo};
+void VulkanApplication::CreateGraphicsPipeline() {
+    PROFILE_FUNCTION();
+    m_pipelineRegistry = std::make_unique<PipelineRegistry>(m_device, *m_shaderModules, m_pipelineCache);
+    // set 0 is the frame allocator's, the bindless table follows it
+    if (m_bindless) {
+        m_pipelineLayout = m_pipelineRegistry->GetOrCreateLayout({
+                .setLayouts = {m_frameAllocator->GetLayout(), m_bindless->GetLayout()},
+                .pushConstantRanges = {{.stageFlags = VK_SHADER_STAGE_VERTEX_BIT, .offset = 0, .size = sizeof(ScenePushConstants)}}});
+    } else {
+        m_pipelineLayout = m_pipelineRegistry->GetOrCreateLayout({.setLayouts = {m_frameAllocator->GetLayout()}});
+    }
 
-    VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo{
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .vertexBindingDescriptionCount = 0,
-            .pVertexBindingDescriptions = nullptr,
-            .vertexAttributeDescriptionCount = 0,
-            .pVertexAttributeDescriptions = nullptr};
+    // drawn with until the material permutations have been compiled, so it is built right away; it is not
+    // in the registry because the hot reloader replaces and destroys it
+    const auto desc = SceneGraphicsPipelineDesc();
+    m_graphicsPipeline = PipelineRegistry::Build(m_device, m_pipelineCache, desc,
+                                                 m_shaderModules->Load(desc.vertexShader), m_shaderModules->Load(desc.fragmentShader));
+}
 
-    VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo{
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-            .primitiveRestartEnable = VK_FALSE};
+void VulkanApplication::CreateShaderHotReloader() {
+    PROFILE_FUNCTION();
+    m_shaderHotReloader = std::make_unique<ShaderHotReloader>(
+            "../shader",
+            std::vector<ShaderHotReloader::Source>{
+                    m_bindless ? ShaderHotReloader::Source{"shader_bindless.vert", "vert_bindless.spv"}
+                    : m_options.instanced ? ShaderHotReloader::Source{"shader_instanced.vert", "vert_instanced.spv"}
+                                          : ShaderHotReloader::Source{"shader.vert", "vert.spv"},
+                    !m_options.texturePaths.empty() ? ShaderHotReloader::Source{"shader_textured.frag", "frag_textured.spv"}
+                                                    : ShaderHotReloader::Source{"shader.frag", "frag.spv"}},
+            [this](const std::vector<std::string> &) { ReloadGraphicsPipeline(); });
+}
 
-    VkViewport viewport{
-            .x = 0.0f,
-            .y = 0.0f,
-            .width = static_cast<float>(m_swapChainExtent.width),
-            .height = static_cast<float>(m_swapChainExtent.height),
-            .minDepth = 0.0f,
-            .maxDepth = 1.0f};
+// runs on the hot reloader's thread, so the render loop never waits for the driver's compiler
+void VulkanApplication::ReloadGraphicsPipeline() {
+    const auto start = std::chrono::steady_clock::now();
+
+    // the archive was packed from the old SPIR-V, the fresh files are read directly; the modules are only needed
+    // while the pipelines are created, so they do not go into the cache
+    const auto desc = SceneGraphicsPipelineDesc();
+    VkShaderModule vertexShader = VK_NULL_HANDLE;
+    VkShaderModule fragmentShader = VK_NULL_HANDLE;
+    auto reloaded = std::make_unique<ReloadedPipelines>();
+    try {
+        uint64_t vertexShaderHash;
+        uint64_t fragmentShaderHash;
+        vertexShader = m_shaderModules->CreateFromFile(desc.vertexShader, vertexShaderHash);
+        fragmentShader = m_shaderModules->CreateFromFile(desc.fragmentShader, fragmentShaderHash);
+        reloaded->graphicsPipeline = PipelineRegistry::Build(m_device, m_pipelineCache, desc, vertexShader, fragmentShader);
+
+        // through the registry, so the materials that share a state still share a pipeline
+        reloaded->materialPipelines.reserve(m_materialDescs.size());
+        for (const auto &materialDesc : m_materialDescs) {
+            reloaded->materialPipelines.push_back(
+                    m_pipelineRegistry->GetOrCreate(materialDesc, vertexShader, vertexShaderHash, fragmentShader, fragmentShaderHash));
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << " Keeping the current graphics pipeline." << std::endl;
+    }
+    vkDestroyShaderModule(m_device, fragmentShader, nullptr);
+    vkDestroyShaderModule(m_device, vertexShader, nullptr);
+    if (reloaded->graphicsPipeline == VK_NULL_HANDLE) return;
+
+    const auto materialCount = reloaded->materialPipelines.size();
+    {
+        std::lock_guard<std::mutex> lock(m_reloadMutex);
+        // a reload that DrawFrame() has not taken over yet was never drawn with, its graphics pipeline can go right
+        // away; its material pipelines may be the current ones as well, DrawFrame() sorts them out
+        if (const auto replaced = std::move(m_reloadedPipelines)) {
+            vkDestroyPipeline(m_device, replaced->graphicsPipeline, nullptr);
+            reloaded->supersededPipelines = replaced->supersededPipelines;
+            reloaded->supersededPipelines.insert(reloaded->supersededPipelines.end(),
+                                                 replaced->materialPipelines.begin(), replaced->materialPipelines.end());
+        }
+        m_reloadedPipelines = std::move(reloaded);
+    }
 
-    VkRect2D scissor{
-            .offset = {0, 0},
-            .extent = m_swapChainExtent};
+    std::cout << "Rebuilt graphics pipeline and " << materialCount << " material pipelines in " << MillisecondsSince(start) << " ms" << std::endl;
+}
 
-    VkPipelineViewportStateCreateInfo viewportStateCreateInfo{
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .viewportCount = 1,
-            .pViewports = &viewport,
-            .scissorCount = 1,
-            .pScissors = &scissor};
+void VulkanApplication::TakeOverReloadedPipelines(ReloadedPipelines &reloaded) {
+    m_scheduler->DeferDeletion(FrameScheduler::Queue::Graphics, [device = m_device, pipeline = m_graphicsPipeline] {
+        vkDestroyPipeline(device, pipeline, nullptr);
+    });
+    m_graphicsPipeline = reloaded.graphicsPipeline;
+
+    // the material pipelines drawn with so far, minus the ones the reload kept because their SPIR-V and state did
+    // not change, leave the registry; the frames in flight may still use them
+    std::unordered_set<VkPipeline> retired(reloaded.supersededPipelines.begin(), reloaded.supersededPipelines.end());
+    if (m_reloadedMaterialPipelines.empty()) {
+        for (const auto handle : m_materialPipelines) {
+            retired.insert(m_pipelineCompiler->Get(handle));
+        }
+    } else {
+        retired.insert(m_reloadedMaterialPipelines.begin(), m_reloadedMaterialPipelines.end());
+    }
+    for (const auto pipeline : reloaded.materialPipelines) {
+        retired.erase(pipeline);
+    }
+    retired.erase(VK_NULL_HANDLE);
 
-    VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo{
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .depthClampEnable = VK_FALSE,
-            .rasterizerDiscardEnable = VK_FALSE,
-            .polygonMode = VK_POLYGON_MODE_FILL,
-            .cullMode = VK_CULL_MODE_BACK_BIT,
-            .frontFace = VK_FRONT_FACE_CLOCKWISE,
-            .depthBiasEnable = VK_FALSE,
-            .depthBiasConstantFactor = 0.0f,
-            .depthBiasClamp = 0.0f,
-            .depthBiasSlopeFactor = 0.0f,
-            .lineWidth = 1.0f};
-
-    VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo{
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
-            .sampleShadingEnable = VK_FALSE,
-            .minSampleShading = 0.0f,
-            .pSampleMask = nullptr,
-            .alphaToCoverageEnable = VK_FALSE,
-            .alphaToOneEnable = VK_FALSE};
-
-    VkPipelineColorBlendAttachmentState colorBlendAttachmentState{
-            .blendEnable = VK_FALSE,
-            .srcColorBlendFactor = VK_BLEND_FACTOR_ZERO,
-            .dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
-            .colorBlendOp = VK_BLEND_OP_ADD,
-            .srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-            .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-            .alphaBlendOp = VK_BLEND_OP_ADD,
-            .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
-    };
+    for (const auto pipeline : retired) {
+        m_pipelineRegistry->Remove(pipeline);
+        m_scheduler->DeferDeletion(FrameScheduler::Queue::Graphics, [device = m_device, pipeline] {
+            vkDestroyPipeline(device, pipeline, nullptr);
+        });
+    }
+    m_reloadedMaterialPipelines = std::move(reloaded.materialPipelines);
+}
 
-    VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo{
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .logicOpEnable = VK_FALSE,
-            .logicOp = VK_LOGIC_OP_COPY,
-            .attachmentCount = 1,
-            .pAttachments = &colorBlendAttachmentState,
-            .blendConstants = {0.0f, 0.0f, 0.0f, 0.0f}
-    };
+void VulkanApplication::CreatePipelineCompiler() {
+    PROFILE_FUNCTION();
+    m_pipelineCompiler = std::make_unique<PipelineCompiler>(*m_pipelineRegistry, m_options.pipelineThreads);
+
+    // materials differ in the fragment shader's Brightness constant, which makes each level a pipeline of its own,
+    // and every other run of MATERIAL_BRIGHTNESS_LEVELS materials does not cull; with extended dynamic state the
+    // cull mode is set while recording and both runs share a pipeline, without it they double the pipelines.
+    // Beyond that the materials repeat a state and get the registry's existing pipeline
+    for (uint32_t i = 0; i < m_options.pipelinePermutations; ++i) {
+        const auto brightness = 1.0f - 0.5f * static_cast<float>(i % MATERIAL_BRIGHTNESS_LEVELS) / static_cast<float>(MATERIAL_BRIGHTNESS_LEVELS);
+        uint32_t brightnessBits;
+        std::memcpy(&brightnessBits, &brightness, sizeof(brightnessBits));
+
+        auto desc = SceneGraphicsPipelineDesc();
+        desc.fragmentConstants = {brightnessBits};
+        desc.cullMode = (i / MATERIAL_BRIGHTNESS_LEVELS) % 2 == 0 ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE;
+        m_materialCullModes.push_back(desc.cullMode);
+        // kept for the hot reloader, which builds them again from the new SPIR-V
+        m_materialDescs.push_back(desc);
+        m_materialPipelines.push_back(m_pipelineCompiler->Request(std::move(desc)));
+    }
+}
 
-    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .setLayoutCount = 0,
-            .pSetLayouts = nullptr,
-            .pushConstantRangeCount = 0,
-            .pPushConstantRanges = nullptr
-    };
+void VulkanApplication::ReportPipelineCompiler() const {
+    if (!m_pipelineCompiler) return;
 
-    if(vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS){
-        throw std::runtime_error("Failed to create pipeline layout!");
+    const auto stats = m_pipelineCompiler->GetStats();
+    std::cout << "Compiled " << stats.compiled << " of " << stats.requested << " pipeline permutations";
+    if (stats.failed > 0) {
+        std::cout << " (" << stats.failed << " failed)";
     }
+    std::cout << " on " << m_pipelineCompiler->GetThreadCount() << " threads in " << stats.wallMs << " ms, "
+              << stats.compileMs << " ms of compile time (" << (stats.wallMs > 0.0 ? stats.compileMs / stats.wallMs : 0.0)
+              << "x parallel)" << std::endl;
 
-    VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo{
-            .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .stageCount = 2,
-            .pStages = shaderStageCreateInfo,
-            .pVertexInputState = &vertexInputStateCreateInfo,
-            .pInputAssemblyState = &inputAssemblyStateCreateInfo,
-            .pTessellationState = nullptr,
-            .pViewportState = &viewportStateCreateInfo,
-            .pRasterizationState = &rasterizationStateCreateInfo,
-            .pMultisampleState = &multisampleStateCreateInfo,
-            .pDepthStencilState = nullptr,
-            .pColorBlendState = &colorBlendStateCreateInfo,
-            .pDynamicState = nullptr,
-            .layout = m_pipelineLayout,
-            .renderPass = m_renderPass,
-            .subpass = 0,
-            .basePipelineHandle = VK_NULL_HANDLE,
-            .basePipelineIndex = 0
-    };
+    const auto registryStats = m_pipelineRegistry->GetStats();
+    std::cout << "Pipeline registry: " << registryStats.pipelines << " pipelines and " << registryStats.layouts << " layouts, "
+              << registryStats.hits << " of " << registryStats.hits + registryStats.misses << " lookups reused an existing pipeline" << std::endl;
+}
+
+GraphicsPipelineDesc VulkanApplication::SceneGraphicsPipelineDesc() const {
+    // binding 0 and locations 0 and 1 of every scene shader: the float vertices of the triangle, or the packed
+    // ones of a cooked mesh, which the vertex fetch unpacks; the shaders only read xy and rgb either way
+    const auto packed = !m_options.meshPath.empty();
+    const VkVertexInputBindingDescription meshBinding{
+            .binding = 0,
+            .stride = static_cast<uint32_t>(packed ? sizeof(PackedVertex) : sizeof(Vertex)),
+            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX};
+    const VkVertexInputAttributeDescription positionAttribute{
+            .location = 0,
+            .binding = 0,
+            .format = packed ? VK_FORMAT_R16G16B16A16_SNORM : VK_FORMAT_R32G32_SFLOAT,
+            .offset = static_cast<uint32_t>(packed ? offsetof(PackedVertex, position) : offsetof(Vertex, position))};
+    const VkVertexInputAttributeDescription colorAttribute{
+            .location = 1,
+            .binding = 0,
+            .format = packed ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R32G32B32_SFLOAT,
+            .offset = static_cast<uint32_t>(packed ? offsetof(PackedVertex, color) : offsetof(Vertex, color))};
+
+    // the bindless vertex shader fetches the object transform itself, indexed by the instance
+    if (m_bindless) {
+        return {
+                .vertexShader = "vert_bindless.spv",
+                .fragmentShader = !m_options.texturePaths.empty() ? "frag_textured.spv" : "frag.spv",
+                .vertexBindings = {
+                        meshBinding},
+                .vertexAttributes = {
+                        positionAttribute,
+                        colorAttribute},
+                .extendedDynamicState = m_renderingSupport.setCullMode != nullptr,
+                .layout = m_pipelineLayout,
+                .colorFormats = {m_swapChainImageFormat},
+                .renderPass = m_renderPass,
+                .subpass = 0};
+    }
 
-    if(vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &graphicsPipelineCreateInfo, nullptr, &m_graphicsPipeline) != VK_SUCCESS){
-        throw std::runtime_error("Failed to create graphics pipeline!");
+    // transform and color of every instance come from this frame's instance buffer
+    if (m_options.instanced) {
+        return {
+                .vertexShader = "vert_instanced.spv",
+                .fragmentShader = "frag.spv",
+                .vertexBindings = {
+                        meshBinding,
+                        {.binding = 1, .stride = sizeof(InstanceData), .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE}},
+                .vertexAttributes = {
+                        positionAttribute,
+                        colorAttribute,
+                        {.location = 2, .binding = 1, .format = VK_FORMAT_R32G32B32A32_SFLOAT, .offset = offsetof(InstanceData, transform)},
+                        {.location = 3, .binding = 1, .format = VK_FORMAT_R32G32B32A32_SFLOAT, .offset = offsetof(InstanceData, color)}},
+                .extendedDynamicState = m_renderingSupport.setCullMode != nullptr,
+                .layout = m_pipelineLayout,
+                .colorFormats = {m_swapChainImageFormat},
+                .renderPass = m_renderPass,
+                .subpass = 0};
     }
 
-    vkDestroyShaderModule(m_device, fragShaderModule, nullptr);
-    vkDestroyShaderModule(m_device, vertShaderModule, nullptr);
+    return {
+            .vertexShader = "vert.spv",
+            .fragmentShader = "frag.spv",
+            // the object transform is fetched per instance, draws select their object with firstInstance
+            .vertexBindings = {
+                    meshBinding,
+                    {.binding = 1, .stride = sizeof(SceneObject), .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE}},
+            .vertexAttributes = {
+                    positionAttribute,
+                    colorAttribute,
+                    {.location = 2, .binding = 1, .format = VK_FORMAT_R32G32B32A32_SFLOAT, .offset = offsetof(SceneObject, transform)}},
+            .extendedDynamicState = m_renderingSupport.setCullMode != nullptr,
+            .layout = m_pipelineLayout,
+            .colorFormats = {m_swapChainImageFormat},
+            .renderPass = m_renderPass,
+            .subpass = 0};
 }
 
 void VulkanApplication::CreateFramebuffer() {
+    PROFILE_FUNCTION();
+    // dynamic rendering renders to the image views, so a resize only recreates those
+    if (m_options.dynamicRendering) return;
+
     m_swapChainFramebuffer.resize(m_swapChainImageViews.size());
 
     for(size_t i = 0; i < m_swapChainImageViews.size(); ++i){
@@ -574,78 +1436,737 @@ void VulkanApplication::CreateFramebuffer() {
 }
 
 void VulkanApplication::CreateCommandPool() {
+    PROFILE_FUNCTION();
     QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(m_physicalDevice);
 
+    const auto workerCount = m_options.recordThreads != 0 ? m_options.recordThreads : std::max(1u, std::thread::hardware_concurrency());
+    m_recordThreadPool = std::make_unique<ThreadPool>(workerCount);
+
+    // everything is re-recorded every frame, so each frame in flight and each recording worker owns a
+    // transient pool that is reset as a whole once the frame's slot has completed on the graphics timeline
     VkCommandPoolCreateInfo commandPoolCreateInfo{
             .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
             .pNext = nullptr,
-            .flags = 0,
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
             .queueFamilyIndex = queueFamilyIndices.graphicsFamily.value()
     };
 
-    if(vkCreateCommandPool(m_device, &commandPoolCreateInfo, nullptr, &m_commandPool) != VK_SUCCESS){
-        throw std::runtime_error("Failed to create command pool!");
+    m_frameCommands.resize(m_framesInFlight);
+    for(auto &frameCommands : m_frameCommands){
+        frameCommands.workerCommandPools.resize(workerCount);
+
+        if(vkCreateCommandPool(m_device, &commandPoolCreateInfo, nullptr, &frameCommands.commandPool) != VK_SUCCESS){
+            throw std::runtime_error("Failed to create command pool!");
+        }
+
+        for(auto &workerCommandPool : frameCommands.workerCommandPools){
+            if(vkCreateCommandPool(m_device, &commandPoolCreateInfo, nullptr, &workerCommandPool) != VK_SUCCESS){
+                throw std::runtime_error("Failed to create command pool!");
+            }
+        }
     }
 }
 
 void VulkanApplication::CreateCommandBuffer() {
-    m_commandBuffer.resize(m_swapChainFramebuffer.size());
+    PROFILE_FUNCTION();
+    for(auto &frameCommands : m_frameCommands){
+        VkCommandBufferAllocateInfo commandBufferAllocateInfo{
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .pNext = nullptr,
+                .commandPool = frameCommands.commandPool,
+                .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                .commandBufferCount = 1
+        };
+
+        if(vkAllocateCommandBuffers(m_device, &commandBufferAllocateInfo, &frameCommands.commandBuffer) != VK_SUCCESS){
+            throw std::runtime_error("Failed to allocate command buffer!");
+        }
+
+        frameCommands.workerCommandBuffers.resize(frameCommands.workerCommandPools.size());
+        for(size_t i = 0; i < frameCommands.workerCommandPools.size(); ++i){
+            commandBufferAllocateInfo.commandPool = frameCommands.workerCommandPools[i];
+            commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+            if(vkAllocateCommandBuffers(m_device, &commandBufferAllocateInfo, &frameCommands.workerCommandBuffers[i]) != VK_SUCCESS){
+                throw std::runtime_error("Failed to allocate secondary command buffer!");
+            }
+        }
+    }
+
+    // the GPU-driven path writes its draws on the device instead
+    if (m_gpuCulling) return;
+
+    // one instanced draw per material, the materials cover consecutive ranges of instances
+    if (m_instances) {
+        const auto groupCount = std::min<size_t>(std::max<size_t>(m_materialPipelines.size(), 1), m_options.drawCount);
+        m_drawCommands.resize(groupCount);
+        for (size_t i = 0; i < groupCount; ++i) {
+            const auto firstInstance = static_cast<uint32_t>(i * m_options.drawCount / groupCount);
+            m_drawCommands[i] = {
+                    .indexCount = m_indexCount,
+                    .instanceCount = static_cast<uint32_t>((i + 1) * m_options.drawCount / groupCount) - firstInstance,
+                    .firstIndex = 0,
+                    .vertexOffset = 0,
+                    .firstInstance = firstInstance};
+        }
+        return;
+    }
+
+    m_drawCommands.resize(m_options.drawCount);
+    for (uint32_t i = 0; i < m_options.drawCount; ++i) {
+        m_drawCommands[i] = {
+                .indexCount = m_indexCount,
+                .instanceCount = 1,
+                .firstIndex = 0,
+                .vertexOffset = 0,
+                .firstInstance = i};
+    }
+}
+
+void VulkanApplication::CreateMeshBuffers() {
+    PROFILE_FUNCTION();
+    if (!m_options.meshPath.empty()) {
+        LoadMesh();
+        return;
+    }
+
+    m_meshRadius = TriangleRadius;
+    const auto vertexSize = static_cast<VkDeviceSize>(sizeof(TriangleVertices[0]) * TriangleVertices.size());
+    const auto indexSize = static_cast<VkDeviceSize>(sizeof(TriangleIndices[0]) * TriangleIndices.size());
+
+    m_vertexBuffer = m_allocator->CreateBuffer(vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                               MemoryUsage::GpuOnly, m_vertexAllocation);
+    m_indexBuffer = m_allocator->CreateBuffer(indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                              MemoryUsage::GpuOnly, m_indexAllocation);
+    m_indexCount = static_cast<uint32_t>(TriangleIndices.size());
+
+    // nothing waits here, the first frame picks the uploads up through the semaphores handed out by Flush()
+    m_uploader->UploadBuffer(m_vertexBuffer, 0, TriangleVertices.data(), vertexSize,
+                             VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    m_uploader->UploadBuffer(m_indexBuffer, 0, TriangleIndices.data(), indexSize,
+                             VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+}
+
+// the cooked arrays already have the layout the buffers take, they go from the mapped file straight into the
+// staging ring without being parsed or copied on the way
+void VulkanApplication::LoadMesh() {
+    const auto start = std::chrono::steady_clock::now();
+    const MappedFile file(m_options.meshPath);
+    const auto header = validateMesh(file.GetData(), file.GetSize(), m_options.meshPath);
+
+    const auto vertexSize = static_cast<VkDeviceSize>(header.vertexCount) * header.vertexStride;
+    const auto indexSize = static_cast<VkDeviceSize>(header.indexCount) * header.indexSize;
+    m_vertexBuffer = m_allocator->CreateBuffer(std::max<VkDeviceSize>(vertexSize, 1), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                               MemoryUsage::GpuOnly, m_vertexAllocation);
+    m_indexBuffer = m_allocator->CreateBuffer(std::max<VkDeviceSize>(indexSize, 1), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                              MemoryUsage::GpuOnly, m_indexAllocation);
+    m_indexCount = header.indexCount;
+    m_indexType = header.indexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+    m_uploader->UploadBuffer(m_vertexBuffer, 0, file.GetData() + header.vertexOffset, vertexSize,
+                             VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    m_uploader->UploadBuffer(m_indexBuffer, 0, file.GetData() + header.indexOffset, indexSize,
+                             VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+
+    // the packed positions span [-1, 1], the triangle [-0.5, 0.5]
+    m_meshScale = 0.5f;
+    m_meshRadius = header.radius;
+
+    std::cout << "Loaded mesh " << m_options.meshPath << " with " << header.vertexCount << " vertices and " << header.indexCount / 3
+              << " triangles (" << vertexSize + indexSize << " bytes, " << header.indexSize * 8 << "-bit indices) in "
+              << MillisecondsSince(start) << " ms" << std::endl;
+}
+
+void VulkanApplication::CreateSceneObjects() {
+    PROFILE_FUNCTION();
+    // one object keeps the classic centered triangle, more are scattered over four times the visible area
+    // so that a good part of them is outside of the view
+    std::vector<SceneObject> objects(m_options.drawCount);
+
+    uint32_t seed = 1;
+    const auto random = [&seed] {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<float>(seed >> 8) / static_cast<float>(1u << 24);
+    };
 
-    VkCommandBufferAllocateInfo commandBufferAllocateInfo{
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+    for (auto &object : objects) {
+        const auto scale = (objects.size() == 1 ? 1.0f : 0.02f + 0.08f * random()) * m_meshScale;
+        const auto x = objects.size() == 1 ? 0.0f : random() * 4.0f - 2.0f;
+        const auto y = objects.size() == 1 ? 0.0f : random() * 4.0f - 2.0f;
+
+        object = {
+                .sphere = {x, y, 0.0f, m_meshRadius * scale},
+                .transform = {x, y, scale, 0.0f}};
+    }
+
+    const auto objectSize = static_cast<VkDeviceSize>(sizeof(SceneObject) * std::max<size_t>(objects.size(), 1));
+    m_objectBuffer = m_allocator->CreateBuffer(objectSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                               MemoryUsage::GpuOnly, m_objectAllocation);
+    m_uploader->UploadBuffer(m_objectBuffer, 0, objects.data(), sizeof(SceneObject) * objects.size(),
+                             VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+    if (m_bindless) {
+        m_objectBufferHandle = m_bindless->AddStorageBuffer(m_objectBuffer);
+    }
+
+    // object i samples texture i % count, see shader/shader_textured.frag
+    m_textureScales.assign(m_textures.size(), 0.0f);
+    for (size_t i = 0; i < objects.size() && !m_textures.empty(); ++i) {
+        auto &scale = m_textureScales[i % m_textures.size()];
+        scale = std::max(scale, objects[i].transform[2]);
+    }
+
+    if (m_options.instanced) {
+        m_instances = std::make_unique<InstanceBatch>(objects.size());
+        for (size_t i = 0; i < objects.size(); ++i) {
+            const float color[3] = {0.5f + 0.5f * random(), 0.5f + 0.5f * random(), 0.5f + 0.5f * random()};
+            m_instances->Set(i, objects[i].transform[0], objects[i].transform[1], objects[i].transform[2], color);
+        }
+
+        // written by the CPU every frame and read once by the vertex fetch, so host visible memory is used directly
+        m_instanceBuffers.resize(m_framesInFlight);
+        m_instanceAllocations.resize(m_framesInFlight);
+        for (size_t i = 0; i < m_framesInFlight; ++i) {
+            m_instanceBuffers[i] = m_allocator->CreateBuffer(sizeof(InstanceData) * std::max<size_t>(objects.size(), 1), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                                             MemoryUsage::CpuToGpu, m_instanceAllocations[i]);
+        }
+
+        std::cout << "Instanced rendering of " << objects.size() << " objects, per instance data updated with "
+                  << (InstanceBatch::IsVectorized() ? "SSE" : "scalar code") << std::endl;
+    }
+
+    // the view covers [-1, 1] unless a batch job moves the camera
+    SetCamera(1.0f, 0.0f, 0.0f);
+}
+
+void VulkanApplication::CreateTextureStreamer() {
+    PROFILE_FUNCTION();
+    const auto decodeThreads = m_options.decodeThreads != 0 ? m_options.decodeThreads : std::max(1u, std::thread::hardware_concurrency());
+    m_textureStreamer = std::make_unique<TextureStreamer>(m_physicalDevice, m_device, *m_allocator, *m_scheduler, *m_uploader, *m_bindless,
+                                                          static_cast<VkDeviceSize>(m_options.textureBudget) * 1024 * 1024, decodeThreads);
+    for (const auto &path : m_options.texturePaths) {
+        m_textures.push_back(m_textureStreamer->Load(path));
+    }
+
+    std::cout << "Streaming " << m_textures.size() << " textures within " << m_options.textureBudget << " MiB, mip tails of "
+              << m_textureStreamer->GetStats().residentBytes / 1024 << " KiB resident" << std::endl;
+}
+
+// the finest level each texture needs: one texel per pixel for its largest object at the current zoom, so the
+// camera zooming in asks for detail and zooming out lets it go
+void VulkanApplication::RequestTextureLevels() {
+    const auto extent = m_swapChainExtent;
+    for (size_t i = 0; i < m_textures.size(); ++i) {
+        // the triangle's texture coordinates span one unit of object space, the view spans two in NDC
+        const auto footprint = m_textureScales[i] * std::abs(m_viewProjection[0]) * static_cast<float>(std::max(extent.width, extent.height)) / 2.0f;
+        if (footprint <= 0.0f) continue;
+
+        const auto textureExtent = m_textureStreamer->GetExtent(m_textures[i]);
+        const auto texels = static_cast<float>(std::max(textureExtent.width, textureExtent.height));
+        const auto level = std::clamp(std::floor(std::log2(texels / footprint)), 0.0f,
+                                      static_cast<float>(m_textureStreamer->GetLevelCount(m_textures[i]) - 1));
+        m_textureStreamer->Request(m_textures[i], static_cast<uint32_t>(level));
+    }
+    m_textureStreamer->Update(m_frameNumber);
+}
+
+void VulkanApplication::SetCamera(const float zoom, const float offsetX, const float offsetY) {
+    // column-major, the scene is 2D so the camera only scales and translates
+    const float viewProjection[16] = {
+            zoom, 0.0f, 0.0f, 0.0f,
+            0.0f, zoom, 0.0f, 0.0f,
+            0.0f, 0.0f, 1.0f, 0.0f,
+            offsetX, offsetY, 0.0f, 1.0f};
+    std::copy(std::begin(viewProjection), std::end(viewProjection), m_viewProjection);
+    ExtractFrustumPlanes(m_viewProjection, m_frustumPlanes);
+}
+
+void VulkanApplication::CreateGpuCulling() {
+    PROFILE_FUNCTION();
+    m_gpuCulling = std::make_unique<GpuCulling>(m_device, *m_allocator, *m_shaderModules, m_pipelineCache, m_objectBuffer,
+                                                m_options.drawCount, m_indexCount, m_frameCommands.size(), m_drawSupport);
+
+    std::cout << "GPU culling " << m_options.drawCount << " objects, drawing with "
+              << (m_drawSupport.drawIndexedIndirectCount ? "vkCmdDrawIndexedIndirectCount" : m_drawSupport.multiDrawIndirect ? "multi draw indirect" : "one indirect draw per object")
+              << std::endl;
+}
+
+void VulkanApplication::CreatePostProcessor() {
+    PROFILE_FUNCTION();
+    const auto indices = FindQueueFamilies(m_physicalDevice);
+    const auto graphicsFamily = indices.graphicsFamily.value();
+
+    m_postProcessor = std::make_unique<PostProcessor>(m_device, *m_allocator, *m_shaderModules, m_pipelineCache,
+                                                      m_options.asyncCompute ? indices.asyncComputeFamily.value() : graphicsFamily, graphicsFamily,
+                                                      m_swapChainImages, m_swapChainImageFormat, m_swapChainExtent, PostProcessor::Settings{});
+}
+
+void VulkanApplication::CreateRenderGraphs() {
+    PROFILE_FUNCTION();
+    m_renderGraphs.resize(m_framesInFlight);
+    for (auto &renderGraph : m_renderGraphs) {
+        renderGraph = std::make_unique<RenderGraph>(m_device, *m_allocator, m_renderingSupport.pipelineBarrier2);
+    }
+}
+
+void VulkanApplication::UpdateInstances(const size_t frame) {
+    PROFILE_FUNCTION();
+    // deterministic per frame, so that headless dumps are reproducible
+    const auto angle = 0.002f * static_cast<float>(m_frameNumber);
+    const auto brightness = 0.75f + 0.25f * std::cos(5.0f * angle);
+
+    // the frame's slot has completed, nothing reads its instance buffer; the workers write disjoint ranges
+    // that are a multiple of the SIMD width, so only the last one has a scalar tail
+    auto *const destination = static_cast<InstanceData *>(m_instanceAllocations[frame].mapped);
+    const auto count = m_instances->GetCount();
+    const auto taskCount = std::max<size_t>(m_recordThreadPool->GetThreadCount(), 1);
+    const auto taskSize = ((count + taskCount - 1) / taskCount + InstanceBatch::Lanes - 1) / InstanceBatch::Lanes * InstanceBatch::Lanes;
+
+    std::vector<std::future<void>> updates;
+    for (size_t first = 0; first < count; first += taskSize) {
+        const auto instanceCount = std::min(taskSize, count - first);
+        updates.push_back(m_recordThreadPool->Submit([this, angle, brightness, first, instanceCount, destination] {
+            m_instances->Update(angle, brightness, first, instanceCount, destination + first);
+        }));
+    }
+    for (auto &update : updates) {
+        update.get();
+    }
+}
+
+void VulkanApplication::RecordCommandBuffer(const size_t frame, const uint32_t imageIndex, const StagingUploader::PendingUploads &uploads) {
+    PROFILE_FUNCTION();
+    auto &frameCommands = m_frameCommands[frame];
+
+    // split the scene into chunks that are big enough to be worth a secondary command buffer
+    const auto workerCount = frameCommands.workerCommandBuffers.size();
+    const auto drawCount = m_drawCommands.size();
+    const auto chunkCount = m_gpuCulling ? 1 : std::clamp<size_t>((drawCount + MIN_DRAWS_PER_CHUNK - 1) / MIN_DRAWS_PER_CHUNK, 1, workerCount);
+    const auto chunkSize = (drawCount + chunkCount - 1) / chunkCount;
+
+    // materials whose pipeline is still compiling are drawn with the fallback
+    m_framePipelines.assign(std::max<size_t>(m_materialPipelines.size(), 1), m_graphicsPipeline);
+    auto materialsReady = true;
+    for (size_t i = 0; i < m_materialPipelines.size(); ++i) {
+        const auto pipeline = m_reloadedMaterialPipelines.empty() ? m_pipelineCompiler->Get(m_materialPipelines[i]) : m_reloadedMaterialPipelines[i];
+        if (pipeline != VK_NULL_HANDLE) {
+            m_framePipelines[i] = pipeline;
+        } else {
+            materialsReady = false;
+        }
+    }
+    if (m_pipelineCompiler && materialsReady && !m_materialPipelinesReady) {
+        m_materialPipelinesReady = true;
+        std::cout << "Material pipelines ready at frame " << m_frameNumber << ", the fallback pipeline was used until then" << std::endl;
+    }
+
+    if (m_instances) {
+        UpdateInstances(frame);
+    }
+
+    // written before the workers start, they only bind it
+    FrameUniforms frameUniforms{};
+    std::copy(std::begin(m_viewProjection), std::end(m_viewProjection), frameUniforms.viewProjection);
+    for (size_t i = 0; i < m_textures.size(); ++i) {
+        frameUniforms.textures[i] = m_textureStreamer->GetHandle(m_textures[i]);
+    }
+    frameUniforms.textureCount = static_cast<uint32_t>(m_textures.size());
+    frameUniforms.textureSampler = m_textureStreamer ? m_textureStreamer->GetSampler() : 0;
+    m_frameUniformOffset = m_frameAllocator->Push(frameUniforms).offset;
+
+    std::vector<std::future<void>> chunkRecordings;
+    chunkRecordings.reserve(chunkCount);
+    for(size_t chunk = 0; chunk < chunkCount; ++chunk){
+        const auto firstDraw = std::min(chunk * chunkSize, drawCount);
+        const auto chunkDrawCount = std::min(chunkSize, drawCount - firstDraw);
+
+        chunkRecordings.push_back(m_recordThreadPool->Submit([this, frame, imageIndex, chunk, firstDraw, chunkDrawCount] {
+            RecordSceneChunk(frame, chunk, imageIndex, firstDraw, chunkDrawCount);
+        }));
+    }
+
+    // the primary command buffer is recorded on this thread while the workers fill the secondaries
+    if(vkResetCommandPool(m_device, frameCommands.commandPool, 0) != VK_SUCCESS){
+        throw std::runtime_error("Failed to reset command pool!");
+    }
+
+    const auto commandBuffer = frameCommands.commandBuffer;
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = nullptr,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = nullptr
+    };
+
+    if(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS){
+        throw std::runtime_error("Failed to begin recording command buffer!");
+    }
+
+    if(m_profiler){
+        m_profiler->BeginFrame(commandBuffer, frame);
+    }
+
+    if(!uploads.acquireBarriers.empty() || !uploads.imageAcquireBarriers.empty()){
+        vkCmdPipelineBarrier(commandBuffer, uploads.dstStageMask, uploads.dstStageMask, 0,
+                             0, nullptr, static_cast<uint32_t>(uploads.acquireBarriers.size()), uploads.acquireBarriers.data(),
+                             static_cast<uint32_t>(uploads.imageAcquireBarriers.size()), uploads.imageAcquireBarriers.data());
+    }
+
+    if(m_gpuCulling){
+        const auto cullingPass = m_profiler ? m_profiler->BeginPass(commandBuffer, "culling") : 0;
+        m_gpuCulling->RecordCulling(commandBuffer, frame, m_frustumPlanes);
+        if(m_profiler){
+            m_profiler->EndPass(commandBuffer, cullingPass);
+        }
+    }
+
+    if(!m_renderGraphs.empty()){
+        RecordFrameGraph(frame, imageIndex, commandBuffer, chunkRecordings);
+    } else {
+        const auto scenePass = m_profiler ? m_profiler->BeginPass(commandBuffer, "scene", true) : 0;
+
+        if(m_options.dynamicRendering){
+            // the old contents are cleared anyway, and the wait on the acquire semaphore is at the color attachment stage
+            TransitionColorImage(commandBuffer, m_swapChainImages[imageIndex], VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+
+            BeginSceneRendering(commandBuffer, m_swapChainImageViews[imageIndex]);
+        } else {
+            VkClearValue clearValue = {0.0f, 0.0f, 0.0f, 1.0f};
+            VkRenderPassBeginInfo renderPassBeginInfo{
+                    .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+                    .pNext = nullptr,
+                    .renderPass = m_renderPass,
+                    .framebuffer = m_swapChainFramebuffer[imageIndex],
+                    .renderArea = {
+                            .offset = {0, 0, },
+                            .extent = m_swapChainExtent
+                    },
+                    .clearValueCount = 1,
+                    .pClearValues = &clearValue
+            };
+
+            vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        }
+
+        for(auto &chunkRecording : chunkRecordings){
+            chunkRecording.get();
+        }
+        vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(chunkCount), frameCommands.workerCommandBuffers.data());
+
+        if(m_options.dynamicRendering){
+            m_renderingSupport.endRendering(commandBuffer);
+
+            // same as the render pass's final layout, plus the readback dependency in headless mode
+            if(m_options.headless){
+                TransitionColorImage(commandBuffer, m_swapChainImages[imageIndex], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+            } else {
+                TransitionColorImage(commandBuffer, m_swapChainImages[imageIndex], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                                     VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+            }
+        } else {
+            vkCmdEndRenderPass(commandBuffer);
+        }
+        if(m_profiler){
+            m_profiler->EndPass(commandBuffer, scenePass);
+        }
+
+        // the post pass reads the frame on its own queue and does the readback there
+        if(!m_postProcessor && !m_readbackBuffers.empty()){
+            const auto readbackPass = m_profiler ? m_profiler->BeginPass(commandBuffer, "readback") : 0;
+
+            VkBufferImageCopy region{
+                    .bufferOffset = 0,
+                    .bufferRowLength = 0,
+                    .bufferImageHeight = 0,
+                    .imageSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+                    .imageOffset = {0, 0, 0},
+                    .imageExtent = {m_swapChainExtent.width, m_swapChainExtent.height, 1}
+            };
+
+            vkCmdCopyImageToBuffer(commandBuffer, m_swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_readbackBuffers[imageIndex], 1, &region);
+
+            VkBufferMemoryBarrier hostReadBarrier{
+                    .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                    .pNext = nullptr,
+                    .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                    .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .buffer = m_readbackBuffers[imageIndex],
+                    .offset = 0,
+                    .size = VK_WHOLE_SIZE
+            };
+
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                                 0, nullptr, 1, &hostReadBarrier, 0, nullptr);
+
+            if(m_profiler){
+                m_profiler->EndPass(commandBuffer, readbackPass);
+            }
+        }
+    }
+
+    if(m_postProcessor){
+        m_postProcessor->RecordRelease(commandBuffer, frame);
+    }
+
+    if(m_profiler){
+        m_profiler->EndFrame(commandBuffer);
+    }
+
+    if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS){
+        throw std::runtime_error("Failed to record command buffer!");
+    }
+}
+
+void VulkanApplication::RecordFrameGraph(const size_t frame, const uint32_t imageIndex, VkCommandBuffer commandBuffer,
+                                         std::vector<std::future<void>> &chunkRecordings) {
+    PROFILE_FUNCTION();
+    using Usage = RenderGraph::Usage;
+
+    auto &graph = *m_renderGraphs[frame];
+    graph.Reset();
+
+    // the acquire semaphore is waited for at the stages of whichever pass writes the image first; headless frames
+    // are left for the readback or the post pass, as the render pass would leave them
+    const auto backbuffer = graph.ImportImage(
+            "backbuffer", m_swapChainImages[imageIndex], m_swapChainImageViews[imageIndex],
+            {.layout = VK_IMAGE_LAYOUT_UNDEFINED, .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT, .accessMask = VK_ACCESS_2_NONE},
+            m_options.headless ? RenderGraph::State{.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, .stageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT, .accessMask = VK_ACCESS_2_TRANSFER_READ_BIT}
+                               : RenderGraph::State{.layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, .stageMask = VK_PIPELINE_STAGE_2_NONE, .accessMask = VK_ACCESS_2_NONE});
+
+    const RenderGraph::ImageDesc imageDesc{.format = m_swapChainImageFormat, .extent = m_swapChainExtent};
+    const auto sceneTarget = m_options.graphPasses == 0 ? backbuffer : graph.CreateImage("scene", imageDesc);
+
+    graph.AddPass("scene", [sceneTarget](RenderGraph::PassBuilder &builder) {
+        builder.Write(sceneTarget, Usage::ColorAttachment);
+    }, [this, frame, sceneTarget, &graph, &chunkRecordings](VkCommandBuffer commandBuffer) {
+        const auto scenePass = m_profiler ? m_profiler->BeginPass(commandBuffer, "scene", true) : 0;
+        BeginSceneRendering(commandBuffer, graph.GetImageView(sceneTarget));
+
+        for(auto &chunkRecording : chunkRecordings){
+            chunkRecording.get();
+        }
+        vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(chunkRecordings.size()), m_frameCommands[frame].workerCommandBuffers.data());
+
+        m_renderingSupport.endRendering(commandBuffer);
+        if(m_profiler){
+            m_profiler->EndPass(commandBuffer, scenePass);
+        }
+    });
+
+    // every copy takes the place of a post-processing pass, its input is dead afterwards and its memory free for the next image
+    auto previous = sceneTarget;
+    for (uint32_t i = 0; i < m_options.graphPasses; ++i) {
+        const auto name = "copy " + std::to_string(i);
+        const auto target = i + 1 == m_options.graphPasses ? backbuffer : graph.CreateImage(name, imageDesc);
+
+        graph.AddPass(name, [previous, target](RenderGraph::PassBuilder &builder) {
+            builder.Read(previous, Usage::TransferSrc);
+            builder.Write(target, Usage::TransferDst);
+        }, [this, previous, target, &graph](VkCommandBuffer commandBuffer) {
+            VkImageCopy region{
+                    .srcSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+                    .srcOffset = {0, 0, 0},
+                    .dstSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+                    .dstOffset = {0, 0, 0},
+                    .extent = {m_swapChainExtent.width, m_swapChainExtent.height, 1}
+            };
+
+            vkCmdCopyImage(commandBuffer, graph.GetImage(previous), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           graph.GetImage(target), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        });
+        previous = target;
+    }
+
+    // the post pass reads the frame on its own queue and does the readback there
+    if (!m_postProcessor && !m_readbackBuffers.empty()) {
+        const auto readback = graph.ImportBuffer("readback", m_readbackBuffers[imageIndex], {},
+                                                 {.layout = VK_IMAGE_LAYOUT_UNDEFINED, .stageMask = VK_PIPELINE_STAGE_2_HOST_BIT, .accessMask = VK_ACCESS_2_HOST_READ_BIT});
+
+        graph.AddPass("readback", [backbuffer, readback](RenderGraph::PassBuilder &builder) {
+            builder.Read(backbuffer, Usage::TransferSrc);
+            builder.Write(readback, Usage::TransferDst);
+        }, [this, backbuffer, readback, &graph](VkCommandBuffer commandBuffer) {
+            const auto readbackPass = m_profiler ? m_profiler->BeginPass(commandBuffer, "readback") : 0;
+
+            VkBufferImageCopy region{
+                    .bufferOffset = 0,
+                    .bufferRowLength = 0,
+                    .bufferImageHeight = 0,
+                    .imageSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+                    .imageOffset = {0, 0, 0},
+                    .imageExtent = {m_swapChainExtent.width, m_swapChainExtent.height, 1}
+            };
+
+            vkCmdCopyImageToBuffer(commandBuffer, graph.GetImage(backbuffer), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, graph.GetBuffer(readback), 1, &region);
+
+            if(m_profiler){
+                m_profiler->EndPass(commandBuffer, readbackPass);
+            }
+        });
+    }
+
+    graph.Compile();
+    graph.Execute(commandBuffer);
+}
+
+void VulkanApplication::BeginSceneRendering(VkCommandBuffer commandBuffer, VkImageView imageView) const {
+    VkClearValue clearValue = {0.0f, 0.0f, 0.0f, 1.0f};
+
+    VkRenderingAttachmentInfo colorAttachment{
+            .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+            .pNext = nullptr,
+            .imageView = imageView,
+            .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .resolveMode = VK_RESOLVE_MODE_NONE,
+            .resolveImageView = VK_NULL_HANDLE,
+            .resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+            .clearValue = clearValue
+    };
+
+    VkRenderingInfo renderingInfo{
+            .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
             .pNext = nullptr,
-            .commandPool = m_commandPool,
-            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-            .commandBufferCount = static_cast<uint32_t>(m_commandBuffer.size())
+            .flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT,
+            .renderArea = {
+                    .offset = {0, 0},
+                    .extent = m_swapChainExtent
+            },
+            .layerCount = 1,
+            .viewMask = 0,
+            .colorAttachmentCount = 1,
+            .pColorAttachments = &colorAttachment,
+            .pDepthAttachment = nullptr,
+            .pStencilAttachment = nullptr
     };
 
-    if(vkAllocateCommandBuffers(m_device, &commandBufferAllocateInfo, m_commandBuffer.data()) != VK_SUCCESS){
-        throw std::runtime_error("Failed to allocate command buffer!");
+    m_renderingSupport.beginRendering(commandBuffer, &renderingInfo);
+}
+
+void VulkanApplication::RecordSceneChunk(const size_t frame, const size_t chunk, const uint32_t imageIndex, const size_t firstDraw, const size_t drawCount) {
+    PROFILE_FUNCTION();
+    const auto commandPool = m_frameCommands[frame].workerCommandPools[chunk];
+    const auto commandBuffer = m_frameCommands[frame].workerCommandBuffers[chunk];
+
+    if(vkResetCommandPool(m_device, commandPool, 0) != VK_SUCCESS){
+        throw std::runtime_error("Failed to reset command pool!");
     }
 
-    for(size_t i = 0; i < m_commandBuffer.size(); ++i){
-        VkCommandBufferBeginInfo commandBufferBeginInfo{
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    // with dynamic rendering the secondaries only learn the attachment formats, there is nothing to look up by image
+    VkCommandBufferInheritanceRenderingInfo inheritanceRenderingInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
             .pNext = nullptr,
             .flags = 0,
-            .pInheritanceInfo = nullptr
-        };
+            .viewMask = 0,
+            .colorAttachmentCount = 1,
+            .pColorAttachmentFormats = &m_swapChainImageFormat,
+            .depthAttachmentFormat = VK_FORMAT_UNDEFINED,
+            .stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
+            .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+    };
+
+    VkCommandBufferInheritanceInfo inheritanceInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+            .pNext = m_options.dynamicRendering ? &inheritanceRenderingInfo : nullptr,
+            .renderPass = m_renderPass,
+            .subpass = 0,
+            .framebuffer = m_options.dynamicRendering ? VK_NULL_HANDLE : m_swapChainFramebuffer[imageIndex],
+            .occlusionQueryEnable = VK_FALSE,
+            .queryFlags = 0,
+            .pipelineStatistics = m_profiler ? m_profiler->GetInheritedStatistics() : 0
+    };
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .pNext = nullptr,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+            .pInheritanceInfo = &inheritanceInfo
+    };
 
-        if(vkBeginCommandBuffer(m_commandBuffer[i], &commandBufferBeginInfo) != VK_SUCCESS){
-            throw std::runtime_error("Failed to begin recording command buffer!");
+    if(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS){
+        throw std::runtime_error("Failed to begin recording secondary command buffer!");
+    }
+
+    const auto bindMaterial = [this, commandBuffer](const size_t material) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_framePipelines[material]);
+        // the fallback pipeline takes the cull mode as dynamic state too, so it draws a compiling material correctly
+        if(m_renderingSupport.setCullMode != nullptr){
+            m_renderingSupport.setCullMode(commandBuffer, material < m_materialCullModes.size() ? m_materialCullModes[material] : static_cast<VkCullModeFlags>(VK_CULL_MODE_BACK_BIT));
+            m_renderingSupport.setFrontFace(commandBuffer, VK_FRONT_FACE_CLOCKWISE);
         }
+    };
 
-        VkClearValue clearValue = {0.0f, 0.0f, 0.0f, 1.0f};
+    // pipeline and dynamic state are not inherited from the primary command buffer, the indirect draws all use the first material
+    auto material = m_gpuCulling ? 0 : firstDraw * m_framePipelines.size() / std::max<size_t>(m_drawCommands.size(), 1);
+    bindMaterial(material);
+
+    // every material pipeline shares the layout, so the sets and the handle stay bound for the whole chunk;
+    // the storage binding of the frame set is unused by the scene and stays at the region's start
+    const uint32_t frameOffsets[] = {m_frameUniformOffset, 0};
+    const auto frameSet = m_frameAllocator->GetSet();
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &frameSet, 2, frameOffsets);
+    if(m_bindless){
+        const ScenePushConstants pushConstants{.objectBuffer = m_objectBufferHandle};
+        m_bindless->Bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 1);
+        vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushConstants), &pushConstants);
+    }
 
-        VkRenderPassBeginInfo renderPassBeginInfo{
-                .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-                .pNext = nullptr,
-                .renderPass = m_renderPass,
-                .framebuffer = m_swapChainFramebuffer[i],
-                .renderArea = {
-                        .offset = {0, 0, },
-                        .extent = m_swapChainExtent
-                },
-                .clearValueCount = 1,
-                .pClearValues = &clearValue
-        };
+    VkViewport viewport{
+            .x = 0.0f,
+            .y = 0.0f,
+            .width = static_cast<float>(m_swapChainExtent.width),
+            .height = static_cast<float>(m_swapChainExtent.height),
+            .minDepth = 0.0f,
+            .maxDepth = 1.0f};
 
-        vkCmdBeginRenderPass(m_commandBuffer[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(m_commandBuffer[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
-        vkCmdDraw(m_commandBuffer[i], 3, 1, 0, 0);
-        vkCmdEndRenderPass(m_commandBuffer[i]);
+    VkRect2D scissor{
+            .offset = {0, 0},
+            .extent = m_swapChainExtent};
 
-        if(vkEndCommandBuffer(m_commandBuffer[i]) != VK_SUCCESS){
-            throw std::runtime_error("Failed to record command buffer!");
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    VkBuffer vertexBuffers[] = {m_vertexBuffer, m_instances ? m_instanceBuffers[frame] : m_objectBuffer};
+    VkDeviceSize vertexOffsets[] = {0, 0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, m_bindless ? 1 : 2, vertexBuffers, vertexOffsets);
+    vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, m_indexType);
+
+    if(m_gpuCulling){
+        m_gpuCulling->RecordDraws(commandBuffer, frame);
+    }
+
+    for(size_t i = firstDraw; i < firstDraw + drawCount; ++i){
+        // materials cover consecutive ranges of draws, so the pipeline changes once per material at most
+        const auto drawMaterial = i * m_framePipelines.size() / m_drawCommands.size();
+        if(drawMaterial != material){
+            material = drawMaterial;
+            bindMaterial(material);
         }
+
+        const auto &draw = m_drawCommands[i];
+        vkCmdDrawIndexed(commandBuffer, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+    }
+
+    if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS){
+        throw std::runtime_error("Failed to record secondary command buffer!");
     }
 }
 
 void VulkanApplication::CreateSyncObjects() {
-    m_imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    m_renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    m_inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-    m_imagesInFlight.resize(m_swapChainImages.size(), VK_NULL_HANDLE);
+    PROFILE_FUNCTION();
+    // the frame slots themselves are tracked on the scheduler's graphics timeline
+    m_imageAvailableSemaphores.resize(m_framesInFlight);
+    m_renderFinishedSemaphores.resize(m_framesInFlight);
+    m_imagesInFlight.resize(m_swapChainImages.size(), 0);
 
     VkSemaphoreCreateInfo semaphoreCreateInfo{
             .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
@@ -653,79 +2174,481 @@ void VulkanApplication::CreateSyncObjects() {
             .flags = 0
     };
 
-    VkFenceCreateInfo fenceCreateInfo{
-            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = VK_FENCE_CREATE_SIGNALED_BIT
-    };
-
-    for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i){
+    for(size_t i = 0; i < m_framesInFlight; ++i){
         if(
                 vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &m_imageAvailableSemaphores[i]) != VK_SUCCESS ||
-                vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS ||
-                vkCreateFence(m_device, &fenceCreateInfo, nullptr, &m_inFlightFences[i]) != VK_SUCCESS
+                vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS
                 ){
             throw std::runtime_error("Failed to create synchronization objects for a frame!");
         }
     }
 }
 
+void VulkanApplication::CreateReadbackBuffers() {
+    PROFILE_FUNCTION();
+    if (!m_options.readback) return;
+
+    const VkDeviceSize frameSize = static_cast<VkDeviceSize>(m_swapChainExtent.width) * m_swapChainExtent.height * 4;
+
+    m_readbackBuffers.resize(m_swapChainImages.size());
+    m_readbackAllocations.resize(m_swapChainImages.size());
+
+    // the allocator keeps host visible memory persistently mapped, the graphics timeline tells when the contents are valid
+    for (size_t i = 0; i < m_readbackBuffers.size(); ++i) {
+        m_readbackBuffers[i] = m_allocator->CreateBuffer(frameSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::GpuToCpu, m_readbackAllocations[i]);
+    }
+}
+
 void VulkanApplication::DrawFrame() {
-    vkWaitForFences(m_device, 1, &m_inFlightFences[m_currentFrame], VK_TRUE, UINT64_MAX);
+    PROFILE_FUNCTION();
+
+    const auto frameStart = std::chrono::steady_clock::now();
+
+    MeasureFrameLatency();
+    {
+        // also runs the deferred deletions the graphics timeline has passed
+        PROFILE_SCOPE("WaitForFrameSlot");
+        m_scheduler->BeginFrame(m_currentFrame);
+    }
+    MeasureFrameLatency();
+
+    // pipelines rebuilt by the hot reloader replace the current ones between frames, recording never waits for them
+    std::unique_ptr<ReloadedPipelines> reloaded;
+    {
+        std::lock_guard<std::mutex> lock(m_reloadMutex);
+        reloaded = std::move(m_reloadedPipelines);
+    }
+    if (reloaded) {
+        TakeOverReloadedPipelines(*reloaded);
+    }
+    m_frameAllocator->BeginFrame(m_currentFrame);
+    if (m_profiler) {
+        m_profiler->CollectFrame(m_currentFrame);
+    }
 
     uint32_t imageIndex;
-    vkAcquireNextImageKHR(m_device, m_swapChain, UINT64_MAX, m_imageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE, &imageIndex);
+    if (m_options.headless) {
+        // every frame in flight owns one offscreen image, there is nothing to acquire
+        imageIndex = static_cast<uint32_t>(m_currentFrame);
+    } else {
+        PROFILE_SCOPE("AcquireNextImage");
+        const auto acquireResult = vkAcquireNextImageKHR(m_device, m_swapChain, UINT64_MAX, m_imageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE, &imageIndex);
+
+        // nothing was submitted for this slot, so simply try again with the new swap chain next time
+        if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR) {
+            RecreateSwapChain();
+            return;
+        }
 
-    if(m_imagesInFlight[imageIndex] != VK_NULL_HANDLE){
-        vkWaitForFences(m_device, 1, &m_imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+        if (acquireResult != VK_SUCCESS && acquireResult != VK_SUBOPTIMAL_KHR) {
+            throw std::runtime_error("Failed to acquire swap chain image!");
+        }
     }
-    m_imagesInFlight[imageIndex] = m_inFlightFences[m_currentFrame];
 
-    VkSemaphore waitSemaphores[] = {m_imageAvailableSemaphores[m_currentFrame]};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    VkSemaphore signalSemaphores[] = {m_renderFinishedSemaphores[m_currentFrame]};
+    {
+        PROFILE_SCOPE("WaitImageInFlight");
+        m_scheduler->Wait(FrameScheduler::Queue::Graphics, m_imagesInFlight[imageIndex]);
+    }
 
-    VkSubmitInfo submitInfo{
-            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .pNext = nullptr,
-            .waitSemaphoreCount = 1,
-            .pWaitSemaphores = waitSemaphores,
-            .pWaitDstStageMask = waitStages,
-            .commandBufferCount = 1,
-            .pCommandBuffers = &m_commandBuffer[imageIndex],
-            .signalSemaphoreCount = 1,
-            .pSignalSemaphores = signalSemaphores
-    };
+    // everything that can block is behind us, input sampled now is as fresh as this frame can get
+    if (m_options.latencyPolicy == LatencyPolicy::LowLatency && !m_options.headless) {
+        glfwPollEvents();
+        m_lastInputTime = std::chrono::steady_clock::now();
+    }
+
+    // levels swapped in here are uploaded with this frame's flush, and its uniforms get the new handles
+    if (m_textureStreamer) {
+        PROFILE_SCOPE("StreamTextures");
+        RequestTextureLevels();
+    }
+
+    // uploads staged since the last frame are submitted now and this frame waits for them on the GPU
+    auto uploads = [this] {
+        PROFILE_SCOPE("FlushUploads");
+        return m_uploader->Flush();
+    }();
+
+    const auto recordStart = std::chrono::steady_clock::now();
+    RecordCommandBuffer(m_currentFrame, imageIndex, uploads);
+    m_recordTimeTotalMs += MillisecondsSince(recordStart);
+    if (m_profiler) {
+        m_profiler->AddCpuEvent("record", recordStart, std::chrono::steady_clock::now());
+    }
+
+    // the frame waits for the uploads on the transfer timeline where their data is first used, which chains
+    // into the acquire barriers, and signals the next value of the graphics timeline
+    const auto renderFinishedSemaphore = m_renderFinishedSemaphores[m_currentFrame];
+    FrameScheduler::Submission submission{
+            .commandBuffers = {m_frameCommands[m_currentFrame].commandBuffer},
+            .timelineWaits = {{.queue = FrameScheduler::Queue::Transfer, .value = uploads.transferValue, .stageMask = uploads.dstStageMask}}};
+    if (!m_options.headless) {
+        submission.binaryWaitSemaphores.push_back(m_imageAvailableSemaphores[m_currentFrame]);
+        // the render graph may write the image with a copy first
+        submission.binaryWaitStages.push_back(m_renderGraphs.empty() ? VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+                                                                     : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT);
+        submission.binarySignalSemaphores.push_back(renderFinishedSemaphore);
+    }
+
+    {
+        PROFILE_SCOPE("QueueSubmit");
+        m_imagesInFlight[imageIndex] = m_scheduler->SubmitFrame(m_currentFrame, FrameScheduler::Queue::Graphics, m_graphicsQueue, submission);
+    }
 
-    vkResetFences(m_device, 1, &m_inFlightFences[m_currentFrame]);
+    // only waits for this frame's graphics work, the next frame's is free to run alongside it on an async compute queue
+    if (m_postProcessor) {
+        PROFILE_SCOPE("PostProcessSubmit");
+        const auto readbackBuffer = m_readbackBuffers.empty() ? VK_NULL_HANDLE : m_readbackBuffers[imageIndex];
+        m_scheduler->SubmitFrame(m_currentFrame, FrameScheduler::Queue::Compute, m_computeQueue, {
+                .commandBuffers = {m_postProcessor->Record(m_currentFrame, readbackBuffer)},
+                .timelineWaits = {{.queue = FrameScheduler::Queue::Graphics, .value = m_imagesInFlight[imageIndex], .stageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT}}});
+    }
 
-    if(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_inFlightFences[m_currentFrame]) != VK_SUCCESS){
-        throw std::runtime_error("Failed to submit draw command buffer!");
+    if (m_profiler) {
+        m_profiler->AddCpuEvent("frame", frameStart, std::chrono::steady_clock::now());
     }
 
+    m_frameInputTimes[m_currentFrame] = m_lastInputTime;
+
+    ++m_frameNumber;
+    m_currentFrame = (m_currentFrame + 1) % m_framesInFlight;
+
+    if (m_options.headless) return;
+
     VkSwapchainKHR swapChains[] = {m_swapChain};
 
     VkPresentInfoKHR presentInfo{
             .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
             .pNext = nullptr,
             .waitSemaphoreCount = 1,
-            .pWaitSemaphores = signalSemaphores,
+            .pWaitSemaphores = &renderFinishedSemaphore,
             .swapchainCount = 1,
             .pSwapchains = swapChains,
             .pImageIndices = &imageIndex,
             .pResults = nullptr
     };
 
-    vkQueuePresentKHR(m_presentQueue, &presentInfo);
+    const auto presentResult = [this, &presentInfo] {
+        PROFILE_SCOPE("QueuePresent");
+        return vkQueuePresentKHR(m_presentQueue, &presentInfo);
+    }();
+
+    if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR || m_framebufferResized) {
+        RecreateSwapChain();
+    } else if (presentResult != VK_SUCCESS) {
+        throw std::runtime_error("Failed to present swap chain image!");
+    }
+}
+
+void VulkanApplication::RunHeadless() {
+    const auto start = std::chrono::steady_clock::now();
+
+    // a faster GPU takes more of the shared frames
+    uint32_t frameCount = 0;
+    while (m_options.sharedFrames != nullptr ? m_options.sharedFrames->fetch_sub(1) > 0 : frameCount < m_options.frameCount) {
+        // there is no input without a window, the latency is taken from the start of the frame instead
+        m_lastInputTime = std::chrono::steady_clock::now();
+        DrawFrame();
+        ++frameCount;
+    }
+
+    vkDeviceWaitIdle(m_device);
+    MeasureFrameLatency();
+
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // the applications on other GPUs finish around the same time, their reports are not interleaved
+    static std::mutex reportMutex;
+    const std::lock_guard lock(reportMutex);
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &deviceProperties);
+    std::cout << "Rendered " << frameCount << " frames on " << deviceProperties.deviceName << " in " << seconds << " s ("
+              << (seconds > 0.0 ? frameCount / seconds : 0.0) << " frames/s)" << std::endl;
+    if (m_frameNumber > 0) {
+        std::cout << "CPU recording time per frame: " << m_recordTimeTotalMs / static_cast<double>(m_frameNumber) << " ms ("
+                  << m_drawCommands.size() << " draws on " << m_recordThreadPool->GetThreadCount() << " threads)" << std::endl;
+    }
+    ReportLatency();
+    ReportFrameScheduler();
+    ReportPostProcessor();
+    ReportRenderGraph();
+    ReportTextureStreamer();
+    ReportFrameAllocator();
+    ReportPipelineCompiler();
+    ReportGpuProfile();
+    WriteCpuTrace();
+    m_allocator->PrintStats(std::cout);
+
+    if (!m_options.dumpPath.empty() && frameCount > 0) {
+        DumpFrame((m_currentFrame + m_framesInFlight - 1) % m_framesInFlight);
+    }
+}
+
+std::vector<VulkanApplication::BatchJob> VulkanApplication::LoadBatchJobs() const {
+    std::ifstream file(m_options.batchPath);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open batch job list " + m_options.batchPath + "!");
+    }
+
+    std::vector<BatchJob> jobs;
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(file, line); ++lineNumber) {
+        std::istringstream fields(line);
+        BatchJob job;
+        // blank lines and comments
+        if (!(fields >> job.outputPath) || job.outputPath[0] == '#') continue;
+
+        // a field that is left out keeps its default
+        float value = 0.0f;
+        for (auto *field : {&job.zoom, &job.offset[0], &job.offset[1]}) {
+            if (!(fields >> value)) break;
+            *field = value;
+        }
+        if (fields.fail() && !fields.eof()) {
+            throw std::runtime_error("Failed to parse line " + std::to_string(lineNumber) + " of batch job list " + m_options.batchPath + "!");
+        }
+        jobs.push_back(std::move(job));
+    }
+    return jobs;
+}
+
+void VulkanApplication::RunBatch() {
+    const auto jobs = LoadBatchJobs();
+    std::atomic<int64_t> encodeNs{0};
+
+    // separate from the recording workers, whose tasks a frame waits for
+    const auto encodeThreads = m_options.encodeThreads != 0 ? m_options.encodeThreads : std::max(1u, std::thread::hardware_concurrency());
+    ThreadPool encoders(encodeThreads);
+
+    // job rendered in each frame slot whose image has not gone to the encoders yet, and the encoding reading the
+    // slot's readback buffer; the buffer is only written again once both are done
+    std::vector<std::optional<size_t>> renderedJobs(m_framesInFlight);
+    std::vector<std::future<void>> encodings(m_framesInFlight);
+    double encodeWaitMs = 0.0;
+
+    // encodes straight from the persistently mapped memory, without copying the pixels out first
+    const auto encode = [&](const size_t slot) {
+        const auto &job = jobs[*renderedJobs[slot]];
+        const auto *const pixels = static_cast<const uint8_t *>(m_readbackAllocations[slot].mapped);
+        encodings[slot] = encoders.Submit([&job, pixels, &encodeNs, extent = m_swapChainExtent] {
+            const auto encodeStart = std::chrono::steady_clock::now();
+            ImageEncoder::Write(job.outputPath, pixels, extent.width, extent.height);
+            encodeNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - encodeStart).count();
+        });
+        renderedJobs[slot].reset();
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+
+    size_t imageCount = 0;
+    for (size_t nextJob = 0;; ++nextJob) {
+        const auto index = m_options.sharedJobs != nullptr ? m_options.sharedJobs->fetch_add(1) : nextJob;
+        if (index >= jobs.size()) break;
+
+        const auto slot = m_currentFrame;
+        if (renderedJobs[slot]) {
+            // the GPU has had frames in flight's worth of time to finish it, this rarely blocks
+            m_scheduler->BeginFrame(slot);
+            encode(slot);
+        }
+        if (encodings[slot].valid()) {
+            const auto waitStart = std::chrono::steady_clock::now();
+            encodings[slot].get();
+            encodeWaitMs += MillisecondsSince(waitStart);
+        }
+
+        SetCamera(jobs[index].zoom, jobs[index].offset[0], jobs[index].offset[1]);
+        m_lastInputTime = std::chrono::steady_clock::now();
+        DrawFrame();
+        renderedJobs[slot] = index;
+        ++imageCount;
+
+        // frames the GPU has finished in the meantime go to the encoders now rather than when their slot comes around
+        for (size_t i = 0; i < m_framesInFlight; ++i) {
+            if (renderedJobs[i] && m_scheduler->IsFrameComplete(i)) {
+                encode(i);
+            }
+        }
+    }
+
+    vkDeviceWaitIdle(m_device);
+    for (size_t i = 0; i < m_framesInFlight; ++i) {
+        if (renderedJobs[i]) {
+            encode(i);
+        }
+    }
+    for (auto &encoding : encodings) {
+        if (encoding.valid()) {
+            encoding.get();
+        }
+    }
+    MeasureFrameLatency();
+
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    static std::mutex reportMutex;
+    const std::lock_guard lock(reportMutex);
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &deviceProperties);
+    std::cout << "Batch: " << imageCount << " images on " << deviceProperties.deviceName << " in " << seconds << " s ("
+              << (seconds > 0.0 ? imageCount / seconds : 0.0) << " images/s), " << m_framesInFlight << " offscreen targets" << std::endl;
+    if (imageCount > 0) {
+        std::cout << "Encoding: " << encodeNs.load() / 1e6 / static_cast<double>(imageCount) << " ms per image on " << encodeThreads
+                  << " threads, the render loop waited " << encodeWaitMs << " ms for them in total" << std::endl;
+    }
+    ReportLatency();
+    ReportFrameScheduler();
+    ReportPostProcessor();
+    ReportRenderGraph();
+    ReportTextureStreamer();
+    ReportFrameAllocator();
+    ReportPipelineCompiler();
+    ReportGpuProfile();
+    WriteCpuTrace();
+    m_allocator->PrintStats(std::cout);
+}
+
+void VulkanApplication::CreateGpuProfiler() {
+    PROFILE_FUNCTION();
+    const auto indices = FindQueueFamilies(m_physicalDevice);
+
+    m_profiler = std::make_unique<GpuProfiler>(m_physicalDevice, m_device, indices.graphicsFamily.value(), m_framesInFlight,
+                                               m_enabledFeatures.pipelineStatisticsQuery, m_enabledFeatures.inheritedQueries);
+}
+
+void VulkanApplication::ReportGpuProfile() {
+    if (!m_profiler) return;
+
+    // the device is idle, so the frames still waiting for their slot to come around can be read now
+    for (size_t i = 0; i < m_framesInFlight; ++i) {
+        m_profiler->CollectFrame(i);
+    }
+
+    m_profiler->PrintStats(std::cout);
+
+    if (!m_options.gpuTracePath.empty()) {
+        m_profiler->WriteChromeTrace(m_options.gpuTracePath);
+        std::cout << "Wrote GPU trace to " << m_options.gpuTracePath << std::endl;
+    }
+}
 
-    m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+void VulkanApplication::MeasureFrameLatency() {
+    // a frame is only seen complete when the graphics timeline is looked at, which makes the sample exact when
+    // the CPU is blocked on its slot and late by at most one CPU frame when it is not
+    for (size_t i = 0; i < m_framesInFlight; ++i) {
+        auto &inputTime = m_frameInputTimes[i];
+        if (!inputTime || !m_scheduler->IsFrameComplete(i)) continue;
+
+        const auto latencyMs = MillisecondsSince(*inputTime);
+        m_latencySamples[m_latencySampleCount % m_latencySamples.size()] = latencyMs;
+        ++m_latencySampleCount;
+        m_latencyTotalMs += latencyMs;
+        inputTime.reset();
+    }
 }
 
-std::vector<const char *> VulkanApplication::GetRequiredExtensions() {
-    uint32_t extensionsCount = 0;
-    const auto extensions = glfwGetRequiredInstanceExtensions(&extensionsCount);
+void VulkanApplication::ReportLatency() const {
+    std::cout << "Latency policy " << LatencyPolicyName(m_options.latencyPolicy) << ": " << m_framesInFlight << " frames in flight";
+    if (!m_options.headless) {
+        std::cout << ", " << PresentModeName(m_presentMode) << " with " << m_swapChainImages.size() << " swap chain images";
+    }
+    std::cout << std::endl;
+
+    if (m_latencySampleCount == 0) return;
+
+    std::vector<double> samples(m_latencySamples.begin(),
+                                m_latencySamples.begin() + static_cast<std::ptrdiff_t>(std::min(m_latencySampleCount, m_latencySamples.size())));
+    std::sort(samples.begin(), samples.end());
+
+    // until the frame has finished rendering and is queued for the presentation engine
+    std::cout << (m_options.headless ? "Frame start" : "Input") << " to present latency: avg "
+              << m_latencyTotalMs / static_cast<double>(m_latencySampleCount) << " ms, p99 "
+              << samples[std::min(samples.size() - 1, samples.size() * 99 / 100)] << " ms over "
+              << m_latencySampleCount << " frames" << std::endl;
+}
 
-    std::vector<const char *> extensionsName(extensions, extensions + extensionsCount);
+void VulkanApplication::ReportFrameAllocator() const {
+    const auto stats = m_frameAllocator->GetStats();
+    std::cout << "Frame allocator: peak " << stats.peakBytes << " of " << stats.frameSize << " bytes per frame, "
+              << stats.allocations << " allocations aligned to " << m_frameAllocator->GetAlignment() << " bytes" << std::endl;
+}
+
+void VulkanApplication::ReportFrameScheduler() const {
+    const auto stats = m_scheduler->GetStats();
+    std::cout << "Frame scheduler: graphics timeline at " << m_scheduler->GetCompletedValue(FrameScheduler::Queue::Graphics)
+              << ", transfer timeline at " << m_scheduler->GetCompletedValue(FrameScheduler::Queue::Transfer)
+              << ", compute timeline at " << m_scheduler->GetCompletedValue(FrameScheduler::Queue::Compute) << ", "
+              << stats.blockedFrames << " of " << stats.frames << " frames waited for their slot, "
+              << stats.deletions << " deferred deletions (" << stats.pendingDeletions << " pending)" << std::endl;
+}
+
+void VulkanApplication::ReportPostProcessor() const {
+    if (!m_postProcessor) return;
+
+    // compare the frames/s above with a run of --post-process-on-graphics for what the overlap saves
+    const auto &settings = m_postProcessor->GetSettings();
+    std::cout << "Post-processing (exposure " << settings.exposure << ", blur radius " << settings.blurRadius << ") on "
+              << (m_postProcessor->IsAsync() ? "the async compute queue of family " : "the graphics queue of family ")
+              << m_postProcessor->GetFamily() << std::endl;
+}
+
+void VulkanApplication::ReportRenderGraph() const {
+    if (m_renderGraphs.empty()) return;
+
+    // every frame builds the same graph, the last one compiled stands for all of them
+    const auto &graph = *m_renderGraphs[(m_currentFrame + m_framesInFlight - 1) % m_framesInFlight];
+    const auto stats = graph.GetStats();
+    std::cout << "Render graph: " << stats.passes << " passes (" << stats.culledPasses << " culled), "
+              << stats.barriers << " barriers in " << stats.barrierBatches << " "
+              << (graph.UsesSynchronization2() ? "vkCmdPipelineBarrier2" : "vkCmdPipelineBarrier") << " calls instead of "
+              << stats.naiveBarriers << " (one per access), " << stats.transientImages << " transient images of "
+              << stats.transientBytes << " bytes placed in " << stats.allocatedBytes << " bytes" << std::endl;
+}
+
+void VulkanApplication::ReportTextureStreamer() const {
+    if (!m_textureStreamer) return;
+
+    const auto stats = m_textureStreamer->GetStats();
+    std::cout << "Texture streaming: " << stats.textures << " textures, " << stats.residentBytes / (1024 * 1024) << " MiB resident (peak "
+              << stats.peakResidentBytes / (1024 * 1024) << " MiB of a " << stats.budget / (1024 * 1024) << " MiB budget), "
+              << stats.uploadedBytes / (1024 * 1024) << " MiB uploaded, " << stats.upgrades << " upgrades, " << stats.evictions
+              << " evictions, " << stats.budgetLimited << " upgrades limited by the budget" << std::endl;
+    for (size_t i = 0; i < m_textures.size(); ++i) {
+        const auto extent = m_textureStreamer->GetExtent(m_textures[i]);
+        const auto level = m_textureStreamer->GetResidentLevel(m_textures[i]);
+        std::cout << "    " << m_options.texturePaths[i] << ": " << extent.width << "x" << extent.height << ", level " << level
+                  << " of " << m_textureStreamer->GetLevelCount(m_textures[i]) << " resident ("
+                  << std::max(extent.width >> level, 1u) << "x" << std::max(extent.height >> level, 1u) << ")" << std::endl;
+    }
+}
+
+void VulkanApplication::WriteCpuTrace() const {
+    if (m_options.cpuTracePath.empty()) return;
+
+    if (!CpuProfiler::IsCompiledIn()) {
+        std::cerr << "Built without VULKANLEARNING_PROFILE, the CPU trace has no zones" << std::endl;
+    }
+
+    CpuProfiler::WriteChromeTrace(m_options.cpuTracePath);
+    std::cout << "Wrote CPU trace to " << m_options.cpuTracePath << std::endl;
+}
+
+void VulkanApplication::DumpFrame(const size_t frame) const {
+    // the offscreen images are RGBA8, as the encoder expects
+    ImageEncoder::Write(m_options.dumpPath, static_cast<const uint8_t *>(m_readbackAllocations[frame].mapped),
+                        m_swapChainExtent.width, m_swapChainExtent.height);
+}
+
+std::vector<const char *> VulkanApplication::GetRequiredExtensions() const {
+    std::vector<const char *> extensionsName;
+
+    if (!m_options.headless) {
+        uint32_t extensionsCount = 0;
+        const auto extensions = glfwGetRequiredInstanceExtensions(&extensionsCount);
+
+        extensionsName.assign(extensions, extensions + extensionsCount);
+    }
 
     if (EnableValidationLayers) {
         extensionsName.emplace_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -734,6 +2657,12 @@ std::vector<const char *> VulkanApplication::GetRequiredExtensions() {
     return extensionsName;
 }
 
+std::vector<const char *> VulkanApplication::GetRequiredDeviceExtensions() const {
+    if (m_options.headless) return {};
+
+    return DeviceExtensions;
+}
+
 bool VulkanApplication::CheckValidationLayerSupport() {
     uint32_t layerCount;
     vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
@@ -752,7 +2681,19 @@ bool VulkanApplication::CheckValidationLayerSupport() {
     return false;
 }
 
-bool VulkanApplication::CheckDeviceExtensionSupport(VkPhysicalDevice device) {
+bool VulkanApplication::HasDeviceExtension(VkPhysicalDevice device, const char *extensionName) {
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    return std::any_of(availableExtensions.begin(), availableExtensions.end(), [extensionName](const auto &extension) {
+        return std::strcmp(extension.extensionName, extensionName) == 0;
+    });
+}
+
+bool VulkanApplication::CheckDeviceExtensionSupport(VkPhysicalDevice device) const {
     uint32_t extensionCount;
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
 
@@ -760,7 +2701,8 @@ bool VulkanApplication::CheckDeviceExtensionSupport(VkPhysicalDevice device) {
 
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-    std::set<std::string> requiredExtensions(DeviceExtensions.begin(), DeviceExtensions.end());
+    const auto deviceExtensions = GetRequiredDeviceExtensions();
+    std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
 
     for (const auto &extension : availableExtensions) {
         requiredExtensions.erase(extension.extensionName);
@@ -783,20 +2725,50 @@ VulkanApplication::QueueFamilyIndices VulkanApplication::FindQueueFamilies(VkPhy
             indices.graphicsFamily = i;
         }
 
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
+        if (m_surface != VK_NULL_HANDLE) {
+            VkBool32 presentSupport = false;
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
 
-        if (presentSupport) {
-            indices.presentFamily = i;
+            if (presentSupport) {
+                indices.presentFamily = i;
+            }
         }
 
-        if (indices.IsComplete()) {
+        if (indices.IsComplete(!m_options.headless)) {
             break;
         }
 
         ++i;
     }
 
+    for (uint32_t family = 0; family < queueFamilyCount; ++family) {
+        const auto flags = queueFamilies[family].queueFlags;
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+            indices.asyncComputeFamily = family;
+            break;
+        }
+    }
+
+    if (indices.graphicsFamily.has_value() && (queueFamilies[indices.graphicsFamily.value()].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+        indices.computeFamily = indices.graphicsFamily;
+    } else {
+        for (uint32_t family = 0; family < queueFamilyCount; ++family) {
+            if (queueFamilies[family].queueFlags & VK_QUEUE_COMPUTE_BIT) {
+                indices.computeFamily = family;
+                break;
+            }
+        }
+    }
+
+    // families without graphics or compute are usually backed by dedicated copy engines
+    for (uint32_t family = 0; family < queueFamilyCount; ++family) {
+        const auto flags = queueFamilies[family].queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+            indices.transferFamily = family;
+            break;
+        }
+    }
+
     return indices;
 }
 
@@ -837,16 +2809,48 @@ VkSurfaceFormatKHR VulkanApplication::ChooseSwapSurfaceFormat(const std::vector<
     return availableFormats[0];
 }
 
-VkPresentModeKHR VulkanApplication::ChooseSwapChainMode(const std::vector<VkPresentModeKHR> &availablePresentModes) {
-    for (const auto &availablePresentMode : availablePresentModes) {
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-            return availablePresentMode;
+VkPresentModeKHR VulkanApplication::ChooseSwapChainMode(const std::vector<VkPresentModeKHR> &availablePresentModes, const LatencyPolicy policy) {
+    // in order of preference, FIFO is the one mode every implementation supports
+    std::vector<VkPresentModeKHR> preferredModes;
+    switch (policy) {
+        case LatencyPolicy::LowLatency:
+            preferredModes = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR};
+            break;
+        case LatencyPolicy::Throughput:
+            preferredModes = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR};
+            break;
+        case LatencyPolicy::PowerSaving:
+            break;
+        default:
+            preferredModes = {VK_PRESENT_MODE_MAILBOX_KHR};
+            break;
+    }
+
+    for (const auto preferredMode : preferredModes) {
+        if (std::find(availablePresentModes.begin(), availablePresentModes.end(), preferredMode) != availablePresentModes.end()) {
+            return preferredMode;
         }
     }
 
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
+uint32_t VulkanApplication::ChooseSwapImageCount(const VkSurfaceCapabilitiesKHR &capabilities) const {
+    auto imageCount = capabilities.minImageCount + 1;
+    if (m_options.latencyPolicy == LatencyPolicy::LowLatency) {
+        // every extra image is a frame that can queue up in front of the display
+        imageCount = capabilities.minImageCount;
+    } else if (m_options.latencyPolicy == LatencyPolicy::Throughput) {
+        // one image for each frame in flight plus the one being scanned out, so acquire never waits for the GPU
+        imageCount = std::max(imageCount, static_cast<uint32_t>(m_framesInFlight) + 1);
+    }
+
+    if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
+        imageCount = capabilities.maxImageCount;
+    }
+    return imageCount;
+}
+
 VkExtent2D VulkanApplication::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities) const {
     if (capabilities.currentExtent.width != UINT32_MAX) {
         return capabilities.currentExtent;
@@ -861,10 +2865,101 @@ bool VulkanApplication::IsDeviceSuitable(VkPhysicalDevice device) const {
     const auto indices = FindQueueFamilies(device);
 
 
-    if (indices.IsComplete() && CheckDeviceExtensionSupport(device)) {
+    if (indices.IsComplete(!m_options.headless) && CheckDeviceExtensionSupport(device) && SupportsTimelineSemaphores(device)) {
+        if (m_options.headless) return true;
+
         const auto swapChainSupport = QuerySwapChainSupport(device);
         return !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
     }
 
     return false;
 }
+
+VulkanApplication::DeviceCandidate VulkanApplication::RateDevice(VkPhysicalDevice device) const {
+    DeviceCandidate candidate{.device = device};
+
+    // 1.1 is in core on every suitable device, timeline semaphores need it
+    VkPhysicalDeviceIDProperties idProperties{};
+    idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties2{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+            .pNext = &idProperties,
+            .properties = {}};
+    vkGetPhysicalDeviceProperties2(device, &properties2);
+    candidate.properties = properties2.properties;
+
+    static constexpr char Digits[] = "0123456789abcdef";
+    for (const auto byte : idProperties.deviceUUID) {
+        candidate.uuid.push_back(Digits[byte >> 4]);
+        candidate.uuid.push_back(Digits[byte & 0xf]);
+    }
+
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+        if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            candidate.localMemory += memoryProperties.memoryHeaps[i].size;
+        }
+    }
+
+    const auto indices = FindQueueFamilies(device);
+    candidate.transferQueue = indices.transferFamily.has_value();
+    candidate.asyncComputeQueue = indices.asyncComputeFamily.has_value();
+
+    // the device type decides, then the queues that let uploads and compute run alongside graphics, then the memory;
+    // the device local heap of an integrated GPU is system memory, which the type already ranks lower
+    uint64_t typeRank = 0;
+    switch (candidate.properties.deviceType) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: typeRank = 4; break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: typeRank = 3; break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: typeRank = 2; break;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU: typeRank = 1; break;
+        default: break;
+    }
+    const uint64_t queueRank = (candidate.transferQueue ? 1 : 0) + (candidate.asyncComputeQueue ? 1 : 0);
+    const uint64_t memoryMiB = std::min<uint64_t>(candidate.localMemory >> 20, (uint64_t{1} << 48) - 1);
+    candidate.score = typeRank << 56 | queueRank << 48 | memoryMiB;
+
+    return candidate;
+}
+
+bool VulkanApplication::MatchesDevice(const DeviceCandidate &candidate, const size_t rank, const std::string &device) {
+    // a number is a place in the ranking, never part of a name
+    if (std::all_of(device.begin(), device.end(), [](const char c) { return c >= '0' && c <= '9'; })) {
+        return std::stoul(device) == rank;
+    }
+
+    // the UUID may be written with dashes and in upper case
+    std::string uuid;
+    for (const auto c : device) {
+        if (c == '-') continue;
+        uuid.push_back(c >= 'A' && c <= 'F' ? static_cast<char>(c - 'A' + 'a') : c);
+    }
+    if (uuid == candidate.uuid) return true;
+
+    return std::strstr(candidate.properties.deviceName, device.c_str()) != nullptr;
+}
+
+bool VulkanApplication::SupportsTimelineSemaphores(VkPhysicalDevice device) const {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device, &properties);
+    const auto apiVersion = std::min(m_instanceApiVersion, properties.apiVersion);
+
+    // the extension needs get_physical_device_properties2, which 1.1 has in core
+    if (apiVersion < VK_API_VERSION_1_1 ||
+        (apiVersion < VK_API_VERSION_1_2 && !HasDeviceExtension(device, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))) {
+        return false;
+    }
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+            .pNext = nullptr,
+            .timelineSemaphore = VK_FALSE};
+    VkPhysicalDeviceFeatures2 features2{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &timelineSemaphoreFeatures,
+            .features = {}};
+    vkGetPhysicalDeviceFeatures2(device, &features2);
+
+    return timelineSemaphoreFeatures.timelineSemaphore == VK_TRUE;
+}
@@ -11,39 +11,250 @@ GLFW_INCLUDE_VULKAN
 #include <iostream>
 #include <optional>
 #include <set>
+#include <unordered_set>
 #include <algorithm>
 #include <cstring>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <future>
+#include <mutex>
 
 #include "../tools/LoadShader.h"
+#include "../tools/MeshFormat.h"
+#include "../tools/ThreadPool.h"
+#include "VulkanAllocator.h"
+#include "StagingUploader.h"
+#include "FrameAllocator.h"
+#include "InstanceBatch.h"
+#include "GpuCulling.h"
+#include "PostProcessor.h"
+#include "RenderGraph.h"
+#include "ImageEncoder.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+#include "ShaderModuleCache.h"
+#include "ShaderHotReloader.h"
+#include "PipelineRegistry.h"
+#include "PipelineCompiler.h"
+#include "BindlessTable.h"
+#include "TextureStreamer.h"
+
+// how many frames the CPU may run ahead of the display and how they are presented
+enum class LatencyPolicy
+{
+	// MAILBOX when available, 2 frames in flight
+	Balanced,
+	// IMMEDIATE or FIFO_RELAXED, 1 frame in flight, the fewest swap chain images, input sampled late
+	LowLatency,
+	// MAILBOX or IMMEDIATE, 3 frames in flight and one swap chain image more than that
+	Throughput,
+	// FIFO, the display paces the frames
+	PowerSaving
+};
+
+struct ApplicationOptions
+{
+	// render into offscreen images instead of a window surface and swap chain
+	bool headless = false;
+	// number of frames rendered by Run() in headless mode
+	uint32_t frameCount = 1000;
+	// copy every rendered frame back to host visible memory
+	bool readback = false;
+	// write the last read back frame to this file as a binary PPM
+	std::string dumpPath;
+	// pipeline cache persisted between runs, empty disables it
+	std::string pipelineCachePath = "pipeline_cache.bin";
+	// number of draws in the scene, recorded every frame
+	uint32_t drawCount = 1;
+	// threads recording secondary command buffers, 0 uses every hardware thread
+	uint32_t recordThreads = 0;
+	// cull and emit the draws in a compute pass instead of recording one draw per object
+	bool gpuCulling = false;
+	// per pass GPU timings and pipeline statistics, always on in headless mode
+	bool gpuProfile = false;
+	// write the profiled CPU and GPU spans to this file in Chrome trace format
+	std::string gpuTracePath;
+	// write the CPU zones of the render loop to this file in Chrome trace format, needs VULKANLEARNING_PROFILE
+	std::string cpuTracePath;
+	LatencyPolicy latencyPolicy = LatencyPolicy::Balanced;
+	// overrides the frames in flight of the latency policy, 0 keeps the policy's value
+	uint32_t framesInFlight = 0;
+	// recompile the GLSL sources when they change and swap the graphics pipeline while running
+	bool hotReload = false;
+	// material pipelines compiled in the background at startup, drawn with the fallback pipeline until ready
+	uint32_t pipelinePermutations = 0;
+	// threads compiling them, 0 uses every hardware thread
+	uint32_t pipelineThreads = 0;
+	// begin rendering on the image views directly instead of through a VkRenderPass and VkFramebuffers, and take
+	// cull mode and front face as dynamic state where the device allows it; needs Vulkan 1.3 or VK_KHR_dynamic_rendering
+	bool dynamicRendering = false;
+	// read the object transforms through a bindless descriptor table instead of a per instance vertex binding,
+	// needs descriptor indexing (Vulkan 1.2 or VK_EXT_descriptor_indexing)
+	bool bindless = false;
+	// draw the objects as a few instanced draws, one per material, with per instance data animated on the CPU
+	// every frame and streamed through an instance rate vertex binding
+	bool instanced = false;
+	// tonemap and blur every headless frame in a compute pass, on a dedicated compute queue family when the device
+	// has one so that it overlaps the next frame's graphics work
+	bool postProcess = false;
+	// false keeps the post-processing on the graphics queue, for comparing the frame times
+	bool asyncCompute = true;
+	// describe the frame as a render graph that places the barriers and transient images itself, implies dynamic rendering
+	bool renderGraph = false;
+	// copy passes the graph chains between the scene and the final image, standing in for a longer frame
+	uint32_t graphPasses = 0;
+	// GPU to render on: part of its name, its device UUID as printed at startup or its place in the ranking;
+	// empty takes the best ranked one
+	std::string device;
+	// frames shared with the applications rendering on other GPUs, each takes one at a time until none are left;
+	// replaces frameCount in headless mode when set
+	std::atomic<int64_t>* sharedFrames = nullptr;
+	// render every job of this list into its own image file and exit, implies headless and readback; one job per
+	// line: output path (.png, .ppm or raw RGBA), then optionally zoom and x and y offset of the camera
+	std::string batchPath;
+	// threads encoding the batch images while the GPU renders the next ones, 0 uses every hardware thread
+	uint32_t encodeThreads = 0;
+	// index of the next batch job, shared with the applications rendering on other GPUs
+	std::atomic<size_t>* sharedJobs = nullptr;
+	// KTX2 textures streamed in by mip level as the camera needs them, object i samples texture i % count; implies
+	// bindless, at most MAX_SCENE_TEXTURES
+	std::vector<std::string> texturePaths;
+	// video memory the streamed textures may take, in MiB
+	uint32_t textureBudget = 256;
+	// threads decoding texture levels, 0 uses every hardware thread
+	uint32_t decodeThreads = 0;
+	// mesh cooked by tools/MeshCooker.cpp drawn for every object instead of the built-in triangle
+	std::string meshPath;
+};
+
+struct Vertex
+{
+	float position[2];
+	float color[3];
+};
+
+// std430 layout shared by the culling shader and the per instance vertex binding
+struct SceneObject
+{
+	// xyz center, w radius
+	float sphere[4];
+	// xy offset, z scale
+	float transform[4];
+};
+
+// streamed textures the scene can sample, the array size in FrameUniforms and shader/shader_textured.frag
+constexpr uint32_t MAX_SCENE_TEXTURES = 16;
+
+// std140 block at set 0, binding 0 of the scene shaders, written to the frame allocator every frame
+struct FrameUniforms
+{
+	// column-major
+	float viewProjection[16];
+	// bindless handles of the streamed textures at this frame's residency, uvec4[4] in std140
+	uint32_t textures[MAX_SCENE_TEXTURES];
+	uint32_t textureCount;
+	uint32_t textureSampler;
+	uint32_t padding[2];
+};
 
 class VulkanApplication
 {
 public:
-	VulkanApplication(uint32_t width, uint32_t height);
+	VulkanApplication(uint32_t width, uint32_t height, ApplicationOptions options = {});
 
 	~VulkanApplication();
 
 	void InitInstance();
 	void Run();
 
+	// GPUs that can run this application, valid after InitInstance()
+	[[nodiscard]] size_t GetSuitableDeviceCount() const { return m_suitableDeviceCount; }
+
 private:
 	struct QueueFamilyIndices
 	{
 		std::optional<uint32_t> graphicsFamily;
 		std::optional<uint32_t> presentFamily;
+		// a transfer-only family if the device has one, uploads go through the graphics family otherwise
+		std::optional<uint32_t> transferFamily;
+		// the graphics family whenever it supports compute, so that culling needs no queue hand-off
+		std::optional<uint32_t> computeFamily;
+		// a compute family without graphics, work submitted to it can run alongside the graphics queue
+		std::optional<uint32_t> asyncComputeFamily;
 
-		[[nodiscard]] constexpr bool IsComplete() const
+		[[nodiscard]] constexpr bool IsComplete(bool requirePresent) const
 		{
-			return graphicsFamily.has_value() && presentFamily.has_value();
+			return graphicsFamily.has_value() && (!requirePresent || presentFamily.has_value());
 		}
 	};
 
+	// a suitable GPU and what PickPhysicalDevice() ranks it by
+	struct DeviceCandidate
+	{
+		VkPhysicalDevice device{};
+		VkPhysicalDeviceProperties properties{};
+		// VkPhysicalDeviceIDProperties::deviceUUID as 32 hex digits
+		std::string uuid;
+		VkDeviceSize localMemory = 0;
+		bool transferQueue = false;
+		bool asyncComputeQueue = false;
+		// physical devices in its device group, including itself
+		uint32_t groupSize = 1;
+		uint64_t score = 0;
+	};
+
 	struct SwapChainSupportDetails
 	{
 		VkSurfaceCapabilitiesKHR capabilities{};
 		std::vector<VkSurfaceFormatKHR> formats;
 		std::vector<VkPresentModeKHR> presentModes;
 	};
+
+	struct BatchJob
+	{
+		std::string outputPath;
+		// the camera scales the scene by zoom and then moves it by offset, in normalized device coordinates
+		float zoom = 1.0f;
+		float offset[2]{};
+	};
+
+	// built by the hot reloader's thread from the fresh SPIR-V
+	struct ReloadedPipelines
+	{
+		VkPipeline graphicsPipeline{};
+		// one per material, owned by the registry; VK_NULL_HANDLE where the build failed
+		std::vector<VkPipeline> materialPipelines;
+		// material pipelines of earlier reloads that DrawFrame() never took over
+		std::vector<VkPipeline> supersededPipelines;
+	};
+
+	struct FrameCommands
+	{
+		VkCommandPool commandPool{};
+		VkCommandBuffer commandBuffer{};
+		// one pool and secondary command buffer per recording worker
+		std::vector<VkCommandPool> workerCommandPools;
+		std::vector<VkCommandBuffer> workerCommandBuffers;
+	};
+
+	// command entry points of dynamic rendering, extended dynamic state and synchronization2, core or extension alike
+	struct RenderingSupport
+	{
+		PFN_vkCmdBeginRenderingKHR beginRendering = nullptr;
+		PFN_vkCmdEndRenderingKHR endRendering = nullptr;
+		// null without extended dynamic state, the pipelines bake cull mode and front face then
+		PFN_vkCmdSetCullModeEXT setCullMode = nullptr;
+		PFN_vkCmdSetFrontFaceEXT setFrontFace = nullptr;
+		// null without synchronization2, the render graph records vkCmdPipelineBarrier then
+		PFN_vkCmdPipelineBarrier2KHR pipelineBarrier2 = nullptr;
+	};
 	
 	void CreateInstance();
 	static void PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
@@ -51,40 +262,102 @@ private:
 	void CreateSurface();
 	void PickPhysicalDevice();
 	void CreateLogicalDevice();
+	void CreateFrameScheduler();
+	void CreateStagingUploader();
+	void CreateFrameAllocator();
+	void CreatePipelineCache();
+	void SavePipelineCache() const;
+	[[nodiscard]] std::vector<char> LoadPipelineCacheData() const;
+	[[nodiscard]] bool IsPipelineCacheCompatible(const std::vector<char>& data) const;
 	void CreateSwapChain();
+	void RecreateSwapChain();
+	static void FramebufferResizeCallback(GLFWwindow* window, int width, int height);
+	void CreateOffscreenImages();
 	void CreateImageViews();
     void CreateRenderPass();
+	void CreateBindlessTable();
 	void CreateGraphicsPipeline();
+	[[nodiscard]] GraphicsPipelineDesc SceneGraphicsPipelineDesc() const;
+	void CreatePipelineCompiler();
+	void ReportPipelineCompiler() const;
+	void CreateShaderHotReloader();
+	void ReloadGraphicsPipeline();
+	void TakeOverReloadedPipelines(ReloadedPipelines& reloaded);
     void CreateFramebuffer();
     void CreateCommandPool();
     void CreateCommandBuffer();
+    void CreateMeshBuffers();
+    void LoadMesh();
+    void CreateSceneObjects();
+    void CreateGpuCulling();
+    void CreatePostProcessor();
+    void CreateRenderGraphs();
+    void CreateTextureStreamer();
+    void RequestTextureLevels();
+    void UpdateInstances(size_t frame);
+    void RecordCommandBuffer(size_t frame, uint32_t imageIndex, const StagingUploader::PendingUploads& uploads);
+    void RecordSceneChunk(size_t frame, size_t chunk, uint32_t imageIndex, size_t firstDraw, size_t drawCount);
+    void RecordFrameGraph(size_t frame, uint32_t imageIndex, VkCommandBuffer commandBuffer, std::vector<std::future<void>>& chunkRecordings);
+    void BeginSceneRendering(VkCommandBuffer commandBuffer, VkImageView imageView) const;
     void CreateSyncObjects();
+    void CreateReadbackBuffers();
+    void CreateGpuProfiler();
 
     void DrawFrame();
+    void RunHeadless();
+    [[nodiscard]] std::vector<BatchJob> LoadBatchJobs() const;
+    void SetCamera(float zoom, float offsetX, float offsetY);
+    void RunBatch();
+    void ReportGpuProfile();
+    void WriteCpuTrace() const;
+    void MeasureFrameLatency();
+    void ReportLatency() const;
+    void ReportFrameAllocator() const;
+    void ReportFrameScheduler() const;
+    void ReportPostProcessor() const;
+    void ReportRenderGraph() const;
+    void ReportTextureStreamer() const;
+    void DumpFrame(size_t frame) const;
 	
-	static std::vector<const char*> GetRequiredExtensions();
+	[[nodiscard]] std::vector<const char*> GetRequiredExtensions() const;
+	[[nodiscard]] std::vector<const char*> GetRequiredDeviceExtensions() const;
 	[[nodiscard]] static bool CheckValidationLayerSupport();
-	[[nodiscard]] static bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
+	[[nodiscard]] bool CheckDeviceExtensionSupport(VkPhysicalDevice device) const;
+	[[nodiscard]] static bool HasDeviceExtension(VkPhysicalDevice device, const char* extensionName);
 	QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device) const;
 	SwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice device) const;
 	static VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
-	static VkPresentModeKHR ChooseSwapChainMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
+	static VkPresentModeKHR ChooseSwapChainMode(const std::vector<VkPresentModeKHR>& availablePresentModes, LatencyPolicy policy);
+	[[nodiscard]] uint32_t ChooseSwapImageCount(const VkSurfaceCapabilitiesKHR& capabilities) const;
 	[[nodiscard]] VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) const;
 	[[nodiscard]] bool IsDeviceSuitable(VkPhysicalDevice device) const;
+	[[nodiscard]] DeviceCandidate RateDevice(VkPhysicalDevice device) const;
+	[[nodiscard]] static bool MatchesDevice(const DeviceCandidate& candidate, size_t rank, const std::string& device);
+	[[nodiscard]] bool SupportsTimelineSemaphores(VkPhysicalDevice device) const;
 
 	uint32_t m_width;
 	uint32_t m_height;
-	GLFWwindow* m_pWindow;
+	ApplicationOptions m_options;
+	GLFWwindow* m_pWindow = nullptr;
 	
 	VkInstance m_instance{};
+	uint32_t m_instanceApiVersion = VK_API_VERSION_1_0;
 	VkDebugUtilsMessengerEXT m_debugUtilsMessenger{};
 	VkSurfaceKHR m_surface{};
 	
 	VkPhysicalDevice m_physicalDevice{};
+	size_t m_suitableDeviceCount = 0;
 	VkDevice m_device{};
+	VkPhysicalDeviceFeatures m_enabledFeatures{};
+	std::unique_ptr<VulkanAllocator> m_allocator;
+	std::unique_ptr<ShaderModuleCache> m_shaderModules;
+	std::unique_ptr<BindlessTable> m_bindless;
 	
 	VkQueue m_graphicsQueue{};
 	VkQueue m_presentQueue{};
+	VkQueue m_transferQueue{};
+	// the async compute queue when post-processing runs on one, the graphics queue otherwise
+	VkQueue m_computeQueue{};
 
 	VkSwapchainKHR m_swapChain{};
 	std::vector<VkImage> m_swapChainImages;
@@ -93,18 +366,99 @@ private:
 	std::vector<VkImageView> m_swapChainImageViews;
     std::vector<VkFramebuffer> m_swapChainFramebuffer;
 
+    VkPipelineCache m_pipelineCache{};
+    bool m_pipelineCacheWarm = false;
+
+    // null with dynamic rendering, which has no framebuffers either
     VkRenderPass m_renderPass{};
+    RenderingSupport m_renderingSupport;
+    // owns every pipeline layout and the material pipelines
+    std::unique_ptr<PipelineRegistry> m_pipelineRegistry;
     VkPipelineLayout m_pipelineLayout{};
     VkPipeline m_graphicsPipeline{};
+    std::unique_ptr<ShaderHotReloader> m_shaderHotReloader;
+    // built by the hot reloader's thread, DrawFrame() takes them over between frames
+    std::mutex m_reloadMutex;
+    std::unique_ptr<ReloadedPipelines> m_reloadedPipelines;
+    std::unique_ptr<PipelineCompiler> m_pipelineCompiler;
+    std::vector<GraphicsPipelineDesc> m_materialDescs;
+    std::vector<PipelineCompiler::Handle> m_materialPipelines;
+    // replace the compiler's pipelines once the shaders have been reloaded
+    std::vector<VkPipeline> m_reloadedMaterialPipelines;
+    // pipeline of every material for the frame being recorded, m_graphicsPipeline for the ones still compiling
+    std::vector<VkPipeline> m_framePipelines;
+    // set while recording when the pipelines take it as dynamic state, baked into them otherwise
+    std::vector<VkCullModeFlags> m_materialCullModes;
+    bool m_materialPipelinesReady = false;
 
-    VkCommandPool m_commandPool{};
-    std::vector<VkCommandBuffer> m_commandBuffer;
+    std::vector<FrameCommands> m_frameCommands;
+    std::unique_ptr<ThreadPool> m_recordThreadPool;
+    std::vector<VkDrawIndexedIndirectCommand> m_drawCommands;
+    double m_recordTimeTotalMs = 0.0;
 
+    // frame slots, uploads and deferred deletions all key off its timelines
+    std::unique_ptr<FrameScheduler> m_scheduler;
+    // binary, swap chain acquire and present take no timeline semaphores
     std::vector<VkSemaphore> m_imageAvailableSemaphores;
     std::vector<VkSemaphore> m_renderFinishedSemaphores;
-    std::vector<VkFence> m_inFlightFences;
-    std::vector<VkFence> m_imagesInFlight;
+    // graphics timeline value of the last frame that rendered to each swap chain image
+    std::vector<uint64_t> m_imagesInFlight;
+    // decided by the latency policy, every per frame vector is sized by it
+    size_t m_framesInFlight = 0;
     size_t m_currentFrame = 0;
+    // number of frames submitted so far
+    uint64_t m_frameNumber = 0;
+
+    VkPresentModeKHR m_presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    // when the input a frame was recorded with had been sampled, cleared once the frame is seen complete
+    std::vector<std::optional<std::chrono::steady_clock::time_point>> m_frameInputTimes;
+    std::chrono::steady_clock::time_point m_lastInputTime;
+    // the most recent latency samples in milliseconds, for the percentiles
+    std::vector<double> m_latencySamples;
+    size_t m_latencySampleCount = 0;
+    double m_latencyTotalMs = 0.0;
+
+    bool m_framebufferResized = false;
+
+    std::unique_ptr<StagingUploader> m_uploader;
+    std::unique_ptr<FrameAllocator> m_frameAllocator;
+    // dynamic offset of this frame's FrameUniforms
+    uint32_t m_frameUniformOffset = 0;
+    VkBuffer m_vertexBuffer{};
+    VulkanAllocation m_vertexAllocation;
+    VkBuffer m_indexBuffer{};
+    VulkanAllocation m_indexAllocation;
+    uint32_t m_indexCount = 0;
+    VkIndexType m_indexType = VK_INDEX_TYPE_UINT16;
+    // bounding sphere radius in the mesh's vertex units, and the object scale that gives it the triangle's size
+    float m_meshRadius = 0.0f;
+    float m_meshScale = 1.0f;
+    VkBuffer m_objectBuffer{};
+    VulkanAllocation m_objectAllocation;
+    BindlessTable::Handle m_objectBufferHandle = BindlessTable::InvalidHandle;
+    // instanced path only, one persistently mapped instance buffer per frame in flight
+    std::unique_ptr<InstanceBatch> m_instances;
+    std::vector<VkBuffer> m_instanceBuffers;
+    std::vector<VulkanAllocation> m_instanceAllocations;
+
+    std::unique_ptr<GpuCulling> m_gpuCulling;
+    std::unique_ptr<PostProcessor> m_postProcessor;
+    // one per frame in flight, each keeps the transient images of its frames
+    std::vector<std::unique_ptr<RenderGraph>> m_renderGraphs;
+    std::unique_ptr<TextureStreamer> m_textureStreamer;
+    std::vector<TextureStreamer::TextureId> m_textures;
+    // largest scale among the objects sampling each texture, what its requested mip level goes by
+    std::vector<float> m_textureScales;
+    GpuCulling::DrawSupport m_drawSupport;
+    float m_viewProjection[16]{};
+    float m_frustumPlanes[6][4]{};
+
+    // headless mode owns its render targets instead of borrowing them from a swap chain
+    std::vector<VulkanAllocation> m_offscreenImageAllocations;
+    std::vector<VkBuffer> m_readbackBuffers;
+    std::vector<VulkanAllocation> m_readbackAllocations;
+
+    std::unique_ptr<GpuProfiler> m_profiler;
 };
 
 #endif
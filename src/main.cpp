@@ -1,10 +1,236 @@
 #include "VulkanApplication.h"
 
-int main()
+#include <limits>
+
+namespace {
+    void PrintUsage(const char *program) {
+        std::cerr << "Usage: " << program << " [--headless] [--frames <count>] [--readback] [--dump <file.ppm>]"
+                  << " [--pipeline-cache <file> | --no-pipeline-cache]"
+                  << " [--draws <count>] [--record-threads <count>] [--gpu-culling]"
+                  << " [--gpu-profile] [--gpu-trace <file.json>] [--cpu-trace <file.json>]"
+                  << " [--latency-policy balanced|low-latency|throughput|power-saving] [--frames-in-flight <count>]"
+                  << " [--hot-reload] [--pipeline-permutations <count>] [--pipeline-threads <count>]"
+                  << " [--dynamic-rendering] [--bindless] [--instanced] [--post-process] [--post-process-on-graphics]"
+                  << " [--render-graph] [--graph-passes <count>]"
+                  << " [--device <name|uuid|rank> | --devices <count>]"
+                  << " [--batch <jobs.txt>] [--encode-threads <count>]"
+                  << " [--texture <file.ktx2>]... [--texture-budget <MiB>] [--decode-threads <count>]"
+                  << " [--mesh <file.mesh>]" << std::endl;
+    }
+
+    // std::stoul takes "-1" and wraps around, and would truncate anything past 32 bits silently
+    uint32_t ParseCount(const std::string &text) {
+        size_t end = 0;
+        const auto value = std::stoull(text, &end);
+        if (end != text.size() || text.find('-') != std::string::npos) {
+            throw std::invalid_argument(text);
+        }
+        if (value > std::numeric_limits<uint32_t>::max()) {
+            throw std::out_of_range(text);
+        }
+        return static_cast<uint32_t>(value);
+    }
+
+    // frame.ppm becomes frame.1.ppm on the second GPU
+    std::string WithDeviceSuffix(const std::string &path, const size_t device) {
+        if (path.empty() || device == 0) return path;
+
+        const auto separator = path.find_last_of("/\\");
+        const auto dot = path.find_last_of('.');
+        if (dot == std::string::npos || (separator != std::string::npos && dot < separator)) {
+            return path + "." + std::to_string(device);
+        }
+        return path.substr(0, dot) + "." + std::to_string(device) + path.substr(dot);
+    }
+
+    // one application per GPU, 0 GPUs takes all of them; they share the frames of the batch and take them one at a
+    // time, so that every GPU keeps busy until the batch is done
+    int RunOnDevices(ApplicationOptions options, const uint32_t deviceCount) {
+        std::atomic<int64_t> frames{options.frameCount};
+        options.sharedFrames = &frames;
+        std::atomic<size_t> nextJob{0};
+        options.sharedJobs = &nextJob;
+
+        std::vector<std::unique_ptr<VulkanApplication>> applications;
+        try {
+            // the first one takes the best ranked GPU and finds out how many there are
+            applications.push_back(std::make_unique<VulkanApplication>(800, 600, options));
+            applications.front()->InitInstance();
+
+            const auto available = applications.front()->GetSuitableDeviceCount();
+            if (deviceCount > available) {
+                std::cerr << "Only " << available << " suitable GPUs, rendering on all of them" << std::endl;
+            }
+            const auto count = deviceCount == 0 ? available : std::min<size_t>(deviceCount, available);
+
+            for (size_t i = 1; i < count; ++i) {
+                auto deviceOptions = options;
+                deviceOptions.device = std::to_string(i);
+                // a pipeline cache only fits the device that wrote it
+                deviceOptions.pipelineCachePath = WithDeviceSuffix(options.pipelineCachePath, i);
+                deviceOptions.dumpPath = WithDeviceSuffix(options.dumpPath, i);
+                deviceOptions.gpuTracePath = WithDeviceSuffix(options.gpuTracePath, i);
+                // the CPU zones of every thread are in the first one's trace
+                deviceOptions.cpuTracePath.clear();
+
+                applications.push_back(std::make_unique<VulkanApplication>(800, 600, deviceOptions));
+                applications.back()->InitInstance();
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+
+        std::atomic<bool> failed{false};
+        std::vector<std::thread> threads;
+        threads.reserve(applications.size());
+        for (auto &application : applications) {
+            threads.emplace_back([&application, &failed] {
+                try {
+                    application->Run();
+                }
+                catch (const std::exception& e) {
+                    std::cerr << e.what() << std::endl;
+                    failed = true;
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!options.batchPath.empty()) {
+            std::cout << "Rendered the batch on " << applications.size() << " GPUs in " << seconds << " s" << std::endl;
+        } else {
+            std::cout << "Rendered " << options.frameCount << " frames on " << applications.size() << " GPUs in " << seconds << " s ("
+                      << (seconds > 0.0 ? options.frameCount / seconds : 0.0) << " frames/s)" << std::endl;
+        }
+
+        return failed ? EXIT_FAILURE : 0;
+    }
+}
+
+int main(int argc, char *argv[])
 {
-    VulkanApplication app(800, 600);
+    ApplicationOptions options;
+    uint32_t deviceCount = 1;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string argument = argv[i];
+
+            if (argument == "--headless") {
+                options.headless = true;
+            } else if (argument == "--frames" && i + 1 < argc) {
+                options.frameCount = ParseCount(argv[++i]);
+            } else if (argument == "--readback") {
+                options.readback = true;
+            } else if (argument == "--dump" && i + 1 < argc) {
+                options.dumpPath = argv[++i];
+            } else if (argument == "--pipeline-cache" && i + 1 < argc) {
+                options.pipelineCachePath = argv[++i];
+            } else if (argument == "--no-pipeline-cache") {
+                options.pipelineCachePath.clear();
+            } else if (argument == "--draws" && i + 1 < argc) {
+                options.drawCount = ParseCount(argv[++i]);
+            } else if (argument == "--record-threads" && i + 1 < argc) {
+                options.recordThreads = ParseCount(argv[++i]);
+            } else if (argument == "--gpu-culling") {
+                options.gpuCulling = true;
+            } else if (argument == "--gpu-profile") {
+                options.gpuProfile = true;
+            } else if (argument == "--gpu-trace" && i + 1 < argc) {
+                options.gpuProfile = true;
+                options.gpuTracePath = argv[++i];
+            } else if (argument == "--cpu-trace" && i + 1 < argc) {
+                options.cpuTracePath = argv[++i];
+            } else if (argument == "--latency-policy" && i + 1 < argc) {
+                const std::string policy = argv[++i];
+                if (policy == "balanced") {
+                    options.latencyPolicy = LatencyPolicy::Balanced;
+                } else if (policy == "low-latency") {
+                    options.latencyPolicy = LatencyPolicy::LowLatency;
+                } else if (policy == "throughput") {
+                    options.latencyPolicy = LatencyPolicy::Throughput;
+                } else if (policy == "power-saving") {
+                    options.latencyPolicy = LatencyPolicy::PowerSaving;
+                } else {
+                    PrintUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+            } else if (argument == "--frames-in-flight" && i + 1 < argc) {
+                options.framesInFlight = ParseCount(argv[++i]);
+            } else if (argument == "--hot-reload") {
+                options.hotReload = true;
+            } else if (argument == "--pipeline-permutations" && i + 1 < argc) {
+                options.pipelinePermutations = ParseCount(argv[++i]);
+            } else if (argument == "--pipeline-threads" && i + 1 < argc) {
+                options.pipelineThreads = ParseCount(argv[++i]);
+            } else if (argument == "--dynamic-rendering") {
+                options.dynamicRendering = true;
+            } else if (argument == "--bindless") {
+                options.bindless = true;
+            } else if (argument == "--instanced") {
+                options.instanced = true;
+            } else if (argument == "--post-process") {
+                options.postProcess = true;
+            } else if (argument == "--post-process-on-graphics") {
+                options.postProcess = true;
+                options.asyncCompute = false;
+            } else if (argument == "--render-graph") {
+                options.renderGraph = true;
+            } else if (argument == "--graph-passes" && i + 1 < argc) {
+                options.graphPasses = ParseCount(argv[++i]);
+            } else if (argument == "--device" && i + 1 < argc) {
+                options.device = argv[++i];
+            } else if (argument == "--devices" && i + 1 < argc) {
+                deviceCount = ParseCount(argv[++i]);
+            } else if (argument == "--batch" && i + 1 < argc) {
+                options.batchPath = argv[++i];
+            } else if (argument == "--encode-threads" && i + 1 < argc) {
+                options.encodeThreads = ParseCount(argv[++i]);
+            } else if (argument == "--texture" && i + 1 < argc) {
+                options.texturePaths.emplace_back(argv[++i]);
+            } else if (argument == "--texture-budget" && i + 1 < argc) {
+                options.textureBudget = ParseCount(argv[++i]);
+            } else if (argument == "--decode-threads" && i + 1 < argc) {
+                options.decodeThreads = ParseCount(argv[++i]);
+            } else if (argument == "--mesh" && i + 1 < argc) {
+                options.meshPath = argv[++i];
+            } else {
+                PrintUsage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    catch (const std::invalid_argument &) {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    catch (const std::out_of_range &) {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (options.framesInFlight > FrameScheduler::MaxFramesInFlight) {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (deviceCount != 1) {
+        // a window is shown by one GPU, and the devices are picked by rank
+        if ((!options.headless && options.batchPath.empty()) || !options.device.empty()) {
+            PrintUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        return RunOnDevices(options, deviceCount);
+    }
+
     try 
     {
+        VulkanApplication app(800, 600, options);
         app.InitInstance();
         app.Run();
     }
@@ -1,34 +1,95 @@
 #ifndef VULKANLEARNING_LOADSHADER_H
 #define VULKANLEARNING_LOADSHADER_H
 
-#include <vector>
-#include <fstream>
+#include <string>
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
 
-std::vector<char> loadSpv(std::string filename){
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-    if(!file.is_open()){
-        throw std::runtime_error("Failed to open file!");
+constexpr uint32_t SpirvMagic = 0x07230203;
+
+// read-only mapping of a whole file, the pages come straight from the page cache without a copy
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string& filename) {
+        const int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open file " + filename + "!");
+        }
+
+        struct stat status{};
+        if (fstat(fd, &status) != 0) {
+            close(fd);
+            throw std::runtime_error("Failed to stat file " + filename + "!");
+        }
+
+        m_size = static_cast<size_t>(status.st_size);
+        if (m_size > 0) {
+            m_data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        // the mapping keeps the file alive on its own
+        close(fd);
+
+        if (m_data == MAP_FAILED) {
+            m_data = nullptr;
+            throw std::runtime_error("Failed to map file " + filename + "!");
+        }
+    }
+
+    ~MappedFile() {
+        if (m_data != nullptr) {
+            munmap(m_data, m_size);
+        }
     }
 
-    auto fileSize = static_cast<size_t>(file.tellg());
-    std::vector<char> buffer(fileSize);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
 
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
+    MappedFile(MappedFile&& other) noexcept
+            : m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)) {}
 
-    file.close();
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+        return *this;
+    }
+
+    [[nodiscard]] const std::byte* GetData() const { return static_cast<const std::byte*>(m_data); }
+    [[nodiscard]] size_t GetSize() const { return m_size; }
 
-    return buffer;
+private:
+    void* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+// Vulkan consumes SPIR-V as host endian 32-bit words, so the code has to be word aligned and start with the magic number
+inline void validateSpirv(const void* code, size_t size, const std::string& name){
+    if(size < 5 * sizeof(uint32_t) || size % sizeof(uint32_t) != 0){
+        throw std::runtime_error("SPIR-V " + name + " is too short or not a whole number of words!");
+    }
+    if(reinterpret_cast<uintptr_t>(code) % alignof(uint32_t) != 0){
+        throw std::runtime_error("SPIR-V " + name + " is not 4-byte aligned!");
+    }
+    if(*static_cast<const uint32_t*>(code) != SpirvMagic){
+        throw std::runtime_error("SPIR-V " + name + " has a wrong magic number, it may be corrupt or of the other endianness!");
+    }
 }
 
-VkShaderModule createShaderModule(VkDevice device, std::vector<char> code){
+inline VkShaderModule createShaderModule(VkDevice device, const uint32_t* code, size_t size){
     VkShaderModuleCreateInfo createInfo{
         .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
         .pNext = nullptr,
         .flags = 0,
-        .codeSize = code.size(),
-        .pCode = reinterpret_cast<const uint32_t*>(code.data())
+        .codeSize = size,
+        .pCode = code
     };
 
     VkShaderModule shaderModule;
@@ -39,8 +100,12 @@ VkShaderModule createShaderModule(VkDevice device, std::vector<char> code){
     return shaderModule;
 }
 
-VkShaderModule createShaderModuleFromFile(VkDevice device, std::string filename){
-    return createShaderModule(device, loadSpv(filename));
+// the driver parses the mapped pages directly, nothing is copied on the way
+inline VkShaderModule createShaderModuleFromFile(VkDevice device, const std::string& filename){
+    const MappedFile file(filename);
+    validateSpirv(file.GetData(), file.GetSize(), filename);
+
+    return createShaderModule(device, reinterpret_cast<const uint32_t*>(file.GetData()), file.GetSize());
 }
 
 #endif //VULKANLEARNING_LOADSHADER_H
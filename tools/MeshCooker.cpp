@@ -0,0 +1,488 @@
+// Offline mesh cooker, a program of its own:
+//   g++ -std=c++20 -O2 tools/MeshCooker.cpp -o mesh_cooker
+//   ./mesh_cooker model.obj model.mesh
+// Reads a Wavefront OBJ, packs and deduplicates the vertices, orders the triangles for the post-transform vertex
+// cache and then, cluster by cluster, for less overdraw, orders the vertices by first use and writes the format of
+// MeshFormat.h.
+#include "MeshFormat.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    // what the cache optimization assumes, and the FIFO the statistics are measured with
+    constexpr uint32_t CacheSize = 32;
+    constexpr uint32_t MeasuredCacheSize = 16;
+
+    struct Float3
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+    };
+
+    Float3 operator-(const Float3 &a, const Float3 &b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+    Float3 operator+(const Float3 &a, const Float3 &b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+    Float3 operator*(const Float3 &a, const float s) { return {a.x * s, a.y * s, a.z * s}; }
+    float Dot(const Float3 &a, const Float3 &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    Float3 Cross(const Float3 &a, const Float3 &b) { return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x}; }
+    float Length(const Float3 &a) { return std::sqrt(Dot(a, a)); }
+
+    struct ObjMesh
+    {
+        std::vector<Float3> positions;
+        std::vector<Float3> colors;
+        std::vector<Float3> normals;
+        // per corner of every triangle, normal index -1 when the face has none
+        std::vector<std::array<int, 2>> corners;
+    };
+
+    // "3", "3/1", "3//2" or "3/1/2", negative indices count back from the last element read so far
+    std::array<int, 2> ParseCorner(const std::string &token, const ObjMesh &mesh) {
+        const auto resolve = [](const std::string &text, size_t count) {
+            const auto index = std::stoi(text);
+            const auto resolved = index < 0 ? static_cast<int>(count) + index : index - 1;
+            if (resolved < 0 || resolved >= static_cast<int>(count)) {
+                throw std::runtime_error("Face index " + text + " is out of range!");
+            }
+            return resolved;
+        };
+
+        const auto firstSlash = token.find('/');
+        const auto position = resolve(token.substr(0, firstSlash), mesh.positions.size());
+        auto normal = -1;
+        if (firstSlash != std::string::npos) {
+            const auto secondSlash = token.find('/', firstSlash + 1);
+            if (secondSlash != std::string::npos && secondSlash + 1 < token.size()) {
+                normal = resolve(token.substr(secondSlash + 1), mesh.normals.size());
+            }
+        }
+        return {position, normal};
+    }
+
+    ObjMesh LoadObj(const std::string &path) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open file " + path + "!");
+        }
+
+        ObjMesh mesh;
+        std::string line;
+        std::vector<std::array<int, 2>> face;
+        while (std::getline(file, line)) {
+            std::istringstream stream(line);
+            std::string keyword;
+            stream >> keyword;
+
+            if (keyword == "v") {
+                Float3 position;
+                Float3 color{-1.0f, -1.0f, -1.0f};
+                stream >> position.x >> position.y >> position.z;
+                // the common vertex color extension, "v x y z r g b"
+                if (!(stream >> color.x >> color.y >> color.z)) {
+                    color = {-1.0f, -1.0f, -1.0f};
+                }
+                mesh.positions.push_back(position);
+                mesh.colors.push_back(color);
+            } else if (keyword == "vn") {
+                Float3 normal;
+                stream >> normal.x >> normal.y >> normal.z;
+                mesh.normals.push_back(normal);
+            } else if (keyword == "f") {
+                face.clear();
+                for (std::string token; stream >> token;) {
+                    face.push_back(ParseCorner(token, mesh));
+                }
+                // polygons are fanned out from their first corner
+                for (size_t i = 2; i < face.size(); ++i) {
+                    mesh.corners.push_back(face[0]);
+                    mesh.corners.push_back(face[i - 1]);
+                    mesh.corners.push_back(face[i]);
+                }
+            }
+        }
+
+        if (mesh.corners.empty()) {
+            throw std::runtime_error("Mesh " + path + " has no faces!");
+        }
+        return mesh;
+    }
+
+    int16_t PackSnorm(const float value) {
+        return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+    }
+
+    uint8_t PackUnorm(const float value) {
+        return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+    }
+
+    // projects the unit sphere onto an octahedron and unfolds it into the [-1, 1] square
+    std::array<int16_t, 2> PackOctahedral(Float3 normal) {
+        const auto length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        if (length == 0.0f) return {0, 0};
+
+        normal = normal * (1.0f / length);
+        auto x = normal.x;
+        auto y = normal.y;
+        if (normal.z < 0.0f) {
+            x = (1.0f - std::abs(normal.y)) * (normal.x >= 0.0f ? 1.0f : -1.0f);
+            y = (1.0f - std::abs(normal.x)) * (normal.y >= 0.0f ? 1.0f : -1.0f);
+        }
+        return {PackSnorm(x), PackSnorm(y)};
+    }
+
+    struct PackedMesh
+    {
+        std::vector<PackedVertex> vertices;
+        std::vector<uint32_t> indices;
+        float center[3]{};
+        float scale = 1.0f;
+    };
+
+    // quantizes every corner and merges corners that end up with the same bits
+    PackedMesh PackVertices(const ObjMesh &mesh) {
+        PackedMesh packed;
+
+        Float3 min{INFINITY, INFINITY, INFINITY};
+        Float3 max{-INFINITY, -INFINITY, -INFINITY};
+        for (const auto &corner : mesh.corners) {
+            const auto &p = mesh.positions[corner[0]];
+            min = {std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z)};
+            max = {std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z)};
+        }
+        const auto center = (min + max) * 0.5f;
+        const auto halfExtent = (max - min) * 0.5f;
+        const auto scale = std::max({halfExtent.x, halfExtent.y, halfExtent.z});
+        packed.center[0] = center.x;
+        packed.center[1] = center.y;
+        packed.center[2] = center.z;
+        packed.scale = scale > 0.0f ? scale : 1.0f;
+
+        // faces without normals get the area weighted average of the faces around their position
+        std::vector<Float3> faceNormals(mesh.positions.size());
+        for (size_t i = 0; i < mesh.corners.size(); i += 3) {
+            const auto &a = mesh.positions[mesh.corners[i][0]];
+            const auto &b = mesh.positions[mesh.corners[i + 1][0]];
+            const auto &c = mesh.positions[mesh.corners[i + 2][0]];
+            const auto normal = Cross(b - a, c - a);
+            for (size_t k = 0; k < 3; ++k) {
+                auto &sum = faceNormals[mesh.corners[i + k][0]];
+                sum = sum + normal;
+            }
+        }
+
+        std::unordered_map<std::string, uint32_t> unique;
+        packed.indices.reserve(mesh.corners.size());
+        for (const auto &corner : mesh.corners) {
+            const auto position = (mesh.positions[corner[0]] - center) * (1.0f / packed.scale);
+            auto normal = corner[1] >= 0 ? mesh.normals[corner[1]] : faceNormals[corner[0]];
+            if (const auto length = Length(normal); length > 0.0f) {
+                normal = normal * (1.0f / length);
+            }
+            // without vertex colors the normal is shown, as there is no lighting
+            auto color = mesh.colors[corner[0]];
+            if (color.x < 0.0f) {
+                color = normal * 0.5f + Float3{0.5f, 0.5f, 0.5f};
+            }
+
+            const auto octahedral = PackOctahedral(normal);
+            const PackedVertex vertex{
+                    .position = {PackSnorm(position.x), PackSnorm(position.y), PackSnorm(position.z), 32767},
+                    .normal = {octahedral[0], octahedral[1]},
+                    .color = {PackUnorm(color.x), PackUnorm(color.y), PackUnorm(color.z), 255}};
+
+            const std::string key(reinterpret_cast<const char *>(&vertex), sizeof(vertex));
+            const auto [it, inserted] = unique.try_emplace(key, static_cast<uint32_t>(packed.vertices.size()));
+            if (inserted) {
+                packed.vertices.push_back(vertex);
+            }
+            packed.indices.push_back(it->second);
+        }
+        return packed;
+    }
+
+    // vertices transformed per triangle with a FIFO cache of cacheSize entries, 0.5 is the best a mesh can get
+    float AverageCacheMissRatio(const std::vector<uint32_t> &indices, const size_t vertexCount, const uint32_t cacheSize) {
+        std::vector<uint32_t> insertedAt(vertexCount, 0);
+        uint32_t clock = 0;
+        size_t misses = 0;
+        for (const auto index : indices) {
+            if (insertedAt[index] == 0 || clock - insertedAt[index] >= cacheSize) {
+                insertedAt[index] = ++clock;
+                ++misses;
+            }
+        }
+        return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+    }
+
+    float VertexScore(const int cachePosition, const uint32_t remainingTriangles) {
+        if (remainingTriangles == 0) return -1.0f;
+
+        auto score = 0.0f;
+        if (cachePosition >= 0) {
+            // the last triangle's vertices score the same, whichever order they came in
+            score = cachePosition < 3 ? 0.75f
+                                      : std::pow(1.0f - static_cast<float>(cachePosition - 3) / static_cast<float>(CacheSize - 3), 1.5f);
+        }
+        // vertices with few triangles left are finished first, so they leave the cache for good
+        return score + 2.0f * std::pow(static_cast<float>(remainingTriangles), -0.5f);
+    }
+
+    // Forsyth's linear-speed vertex cache optimization: greedily emits the triangle whose vertices score highest
+    // against a simulated LRU cache
+    std::vector<uint32_t> OptimizeVertexCache(const std::vector<uint32_t> &indices, const size_t vertexCount) {
+        const auto triangleCount = indices.size() / 3;
+
+        std::vector<uint32_t> triangleOffsets(vertexCount + 1, 0);
+        for (const auto index : indices) {
+            ++triangleOffsets[index + 1];
+        }
+        std::partial_sum(triangleOffsets.begin(), triangleOffsets.end(), triangleOffsets.begin());
+        std::vector<uint32_t> vertexTriangles(indices.size());
+        std::vector<uint32_t> remaining(vertexCount, 0);
+        for (size_t i = 0; i < indices.size(); ++i) {
+            const auto vertex = indices[i];
+            vertexTriangles[triangleOffsets[vertex] + remaining[vertex]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        std::vector<int> cachePositions(vertexCount, -1);
+        std::vector<float> vertexScores(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v) {
+            vertexScores[v] = VertexScore(-1, remaining[v]);
+        }
+        std::vector<float> triangleScores(triangleCount);
+        for (size_t t = 0; t < triangleCount; ++t) {
+            triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+        }
+        std::vector<bool> emitted(triangleCount, false);
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        std::vector<uint32_t> cache;
+        std::vector<uint32_t> nextCache;
+        size_t scanCursor = 0;
+
+        auto best = static_cast<size_t>(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+        while (true) {
+            emitted[best] = true;
+            nextCache.clear();
+            for (size_t k = 0; k < 3; ++k) {
+                const auto vertex = indices[best * 3 + k];
+                result.push_back(vertex);
+                nextCache.push_back(vertex);
+
+                // the emitted triangle leaves the vertex's list of remaining ones
+                const auto first = vertexTriangles.begin() + triangleOffsets[vertex];
+                const auto last = first + remaining[vertex];
+                std::iter_swap(std::find(first, last, static_cast<uint32_t>(best)), last - 1);
+                --remaining[vertex];
+            }
+            for (const auto vertex : cache) {
+                if (std::find(nextCache.begin(), nextCache.end(), vertex) == nextCache.end()) {
+                    nextCache.push_back(vertex);
+                }
+            }
+
+            // vertices pushed out of the cache lose their cache score, the ones in it get a new one
+            for (size_t i = 0; i < nextCache.size(); ++i) {
+                const auto vertex = nextCache[i];
+                cachePositions[vertex] = i < CacheSize ? static_cast<int>(i) : -1;
+                vertexScores[vertex] = VertexScore(cachePositions[vertex], remaining[vertex]);
+            }
+            if (nextCache.size() > CacheSize) {
+                nextCache.resize(CacheSize);
+            }
+            std::swap(cache, nextCache);
+
+            // only the triangles of cached vertices changed score, the best of them comes next
+            auto bestScore = -1.0f;
+            for (const auto vertex : cache) {
+                for (auto i = triangleOffsets[vertex]; i < triangleOffsets[vertex] + remaining[vertex]; ++i) {
+                    const auto triangle = vertexTriangles[i];
+                    triangleScores[triangle] = vertexScores[indices[triangle * 3]] + vertexScores[indices[triangle * 3 + 1]] +
+                                               vertexScores[indices[triangle * 3 + 2]];
+                    if (triangleScores[triangle] > bestScore) {
+                        bestScore = triangleScores[triangle];
+                        best = triangle;
+                    }
+                }
+            }
+
+            // nothing adjacent is left, the walk restarts at the next triangle not emitted yet
+            if (bestScore < 0.0f) {
+                while (scanCursor < triangleCount && emitted[scanCursor]) {
+                    ++scanCursor;
+                }
+                if (scanCursor == triangleCount) break;
+                best = scanCursor;
+            }
+        }
+        return result;
+    }
+
+    // Splits the cache ordered triangles into clusters where the cache starts over, a triangle none of whose
+    // vertices are cached, and draws the clusters facing away from the mesh's center first: those are the likeliest
+    // to occlude the rest. Reordering at those points costs the cache nothing.
+    std::vector<uint32_t> OptimizeOverdraw(const std::vector<uint32_t> &indices, const std::vector<PackedVertex> &vertices) {
+        const auto position = [&vertices](uint32_t index) {
+            const auto &p = vertices[index].position;
+            return Float3{static_cast<float>(p[0]), static_cast<float>(p[1]), static_cast<float>(p[2])} * (1.0f / 32767.0f);
+        };
+
+        std::vector<size_t> clusterStarts;
+        std::vector<uint32_t> insertedAt(vertices.size(), 0);
+        uint32_t clock = 0;
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            auto misses = 0;
+            for (size_t k = 0; k < 3; ++k) {
+                const auto index = indices[i + k];
+                if (insertedAt[index] == 0 || clock - insertedAt[index] >= CacheSize) {
+                    insertedAt[index] = ++clock;
+                    ++misses;
+                }
+            }
+            if (misses == 3 || clusterStarts.empty()) {
+                clusterStarts.push_back(i);
+            }
+        }
+        clusterStarts.push_back(indices.size());
+
+        Float3 meshCentroid;
+        auto meshArea = 0.0f;
+        std::vector<Float3> clusterCentroids(clusterStarts.size() - 1);
+        std::vector<Float3> clusterNormals(clusterStarts.size() - 1);
+        for (size_t c = 0; c + 1 < clusterStarts.size(); ++c) {
+            auto clusterArea = 0.0f;
+            for (auto i = clusterStarts[c]; i < clusterStarts[c + 1]; i += 3) {
+                const auto a = position(indices[i]);
+                const auto b = position(indices[i + 1]);
+                const auto c3 = position(indices[i + 2]);
+                const auto cross = Cross(b - a, c3 - a);
+                const auto area = Length(cross);
+                const auto centroid = (a + b + c3) * (1.0f / 3.0f);
+
+                clusterCentroids[c] = clusterCentroids[c] + centroid * area;
+                clusterNormals[c] = clusterNormals[c] + cross;
+                clusterArea += area;
+            }
+            meshCentroid = meshCentroid + clusterCentroids[c];
+            meshArea += clusterArea;
+            if (clusterArea > 0.0f) {
+                clusterCentroids[c] = clusterCentroids[c] * (1.0f / clusterArea);
+            }
+        }
+        if (meshArea > 0.0f) {
+            meshCentroid = meshCentroid * (1.0f / meshArea);
+        }
+
+        std::vector<float> keys(clusterCentroids.size());
+        for (size_t c = 0; c < keys.size(); ++c) {
+            const auto length = Length(clusterNormals[c]);
+            keys[c] = length > 0.0f ? Dot(clusterCentroids[c] - meshCentroid, clusterNormals[c] * (1.0f / length)) : 0.0f;
+        }
+        std::vector<size_t> order(keys.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        for (const auto c : order) {
+            result.insert(result.end(), indices.begin() + static_cast<std::ptrdiff_t>(clusterStarts[c]),
+                          indices.begin() + static_cast<std::ptrdiff_t>(clusterStarts[c + 1]));
+        }
+        return result;
+    }
+
+    // numbers the vertices in the order the index buffer first uses them, so that vertex fetches walk forward
+    void OptimizeVertexFetch(PackedMesh &mesh) {
+        std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+        std::vector<PackedVertex> vertices;
+        vertices.reserve(mesh.vertices.size());
+        for (auto &index : mesh.indices) {
+            if (remap[index] == UINT32_MAX) {
+                remap[index] = static_cast<uint32_t>(vertices.size());
+                vertices.push_back(mesh.vertices[index]);
+            }
+            index = remap[index];
+        }
+        mesh.vertices = std::move(vertices);
+    }
+
+    void WriteMesh(const std::string &path, const PackedMesh &mesh) {
+        const auto indexSize = mesh.vertices.size() <= 65536 ? 2u : 4u;
+
+        MeshHeader header{};
+        header.magic = MeshMagic;
+        header.version = MeshVersion;
+        header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+        header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+        header.vertexStride = sizeof(PackedVertex);
+        header.indexSize = indexSize;
+        header.vertexOffset = alignMeshOffset(sizeof(MeshHeader));
+        header.indexOffset = alignMeshOffset(header.vertexOffset + mesh.vertices.size() * sizeof(PackedVertex));
+        std::copy(std::begin(mesh.center), std::end(mesh.center), header.center);
+        header.scale = mesh.scale;
+        for (const auto &vertex : mesh.vertices) {
+            const auto p = Float3{static_cast<float>(vertex.position[0]), static_cast<float>(vertex.position[1]),
+                                  static_cast<float>(vertex.position[2])} * (1.0f / 32767.0f);
+            header.radius = std::max(header.radius, Length(p));
+        }
+
+        std::vector<char> bytes(header.indexOffset + mesh.indices.size() * indexSize, 0);
+        std::memcpy(bytes.data(), &header, sizeof(header));
+        std::memcpy(bytes.data() + header.vertexOffset, mesh.vertices.data(), mesh.vertices.size() * sizeof(PackedVertex));
+        for (size_t i = 0; i < mesh.indices.size(); ++i) {
+            if (indexSize == 2) {
+                const auto index = static_cast<uint16_t>(mesh.indices[i]);
+                std::memcpy(bytes.data() + header.indexOffset + i * 2, &index, 2);
+            } else {
+                std::memcpy(bytes.data() + header.indexOffset + i * 4, &mesh.indices[i], 4);
+            }
+        }
+
+        std::ofstream file(path, std::ios::binary);
+        if (!file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()))) {
+            throw std::runtime_error("Failed to write mesh " + path + "!");
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <input.obj> <output.mesh>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        const auto obj = LoadObj(argv[1]);
+        auto mesh = PackVertices(obj);
+        const auto inputAcmr = AverageCacheMissRatio(mesh.indices, mesh.vertices.size(), MeasuredCacheSize);
+
+        mesh.indices = OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+        const auto cacheAcmr = AverageCacheMissRatio(mesh.indices, mesh.vertices.size(), MeasuredCacheSize);
+        mesh.indices = OptimizeOverdraw(mesh.indices, mesh.vertices);
+        OptimizeVertexFetch(mesh);
+        WriteMesh(argv[2], mesh);
+
+        // what the same triangles take unindexed as the renderer's float vertices, 20 bytes each
+        const auto floatBytes = obj.corners.size() * 20;
+        const auto cookedBytes = mesh.vertices.size() * sizeof(PackedVertex) + mesh.indices.size() * (mesh.vertices.size() <= 65536 ? 2 : 4);
+        std::cout << "Cooked " << mesh.indices.size() / 3 << " triangles, " << obj.corners.size() << " corners into " << mesh.vertices.size()
+                  << " vertices; ACMR (FIFO of " << MeasuredCacheSize << ") " << inputAcmr << " -> " << cacheAcmr << " -> "
+                  << AverageCacheMissRatio(mesh.indices, mesh.vertices.size(), MeasuredCacheSize) << " after the overdraw order; "
+                  << cookedBytes << " bytes of vertices and indices instead of " << floatBytes << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
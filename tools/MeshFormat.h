@@ -0,0 +1,92 @@
+#ifndef VULKANLEARNING_MESHFORMAT_H
+#define VULKANLEARNING_MESHFORMAT_H
+
+#include <string>
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// Cooked mesh written by tools/MeshCooker.cpp and mapped by the renderer, all little endian:
+//   header   MeshHeader
+//   vertices vertexCount PackedVertex, 16-byte aligned
+//   indices  indexCount uint16 or uint32, 16-byte aligned
+// Both arrays are laid out exactly as the vertex and index buffers take them, so the loader copies them from the
+// mapping into the staging ring without touching them.
+constexpr uint32_t MeshMagic = 0x4853454d;
+constexpr uint32_t MeshVersion = 1;
+
+// R16G16B16A16_SNORM position, R16G16_SNORM octahedral normal and R8G8B8A8_UNORM color
+struct PackedVertex {
+    // scaled into [-1, 1] around the center of the bounds, w is always 1
+    int16_t position[4];
+    int16_t normal[2];
+    uint8_t color[4];
+};
+static_assert(sizeof(PackedVertex) == 16, "packed vertices are 16 bytes");
+
+struct MeshHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t vertexStride;
+    // 2 or 4 bytes, 2 whenever the vertices fit
+    uint32_t indexSize;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    // the source position is position * scale + center
+    float center[3];
+    float scale;
+    // bounding sphere around the origin, in the [-1, 1] space of the packed positions
+    float radius;
+    uint32_t reserved;
+};
+static_assert(sizeof(MeshHeader) == 64, "the mesh header is 64 bytes");
+
+inline uint64_t alignMeshOffset(uint64_t offset){
+    return (offset + 15) / 16 * 16;
+}
+
+// checks the header, that both arrays lie inside the file and that every index names a vertex, returns a copy
+// of the header
+inline MeshHeader validateMesh(const std::byte* data, size_t size, const std::string& name){
+    MeshHeader header{};
+    if(size < sizeof(header)){
+        throw std::runtime_error("Mesh " + name + " is truncated!");
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    if(header.magic != MeshMagic || header.version != MeshVersion){
+        throw std::runtime_error("Mesh " + name + " has an unknown format, it may have been cooked by another version!");
+    }
+    if(header.vertexStride != sizeof(PackedVertex) || (header.indexSize != 2 && header.indexSize != 4) || header.indexCount % 3 != 0){
+        throw std::runtime_error("Mesh " + name + " has an unsupported layout!");
+    }
+
+    const auto vertexBytes = static_cast<uint64_t>(header.vertexCount) * header.vertexStride;
+    const auto indexBytes = static_cast<uint64_t>(header.indexCount) * header.indexSize;
+    if(header.vertexOffset > size || size - header.vertexOffset < vertexBytes ||
+       header.indexOffset > size || size - header.indexOffset < indexBytes){
+        throw std::runtime_error("Mesh " + name + " is truncated!");
+    }
+
+    // the device has no robust buffer access, an index past the vertices would fetch out of bounds
+    for(uint32_t i = 0; i < header.indexCount; ++i){
+        uint32_t index = 0;
+        if(header.indexSize == 2){
+            uint16_t index16;
+            std::memcpy(&index16, data + header.indexOffset + i * 2, sizeof(index16));
+            index = index16;
+        } else {
+            std::memcpy(&index, data + header.indexOffset + static_cast<uint64_t>(i) * 4, sizeof(index));
+        }
+        if(index >= header.vertexCount){
+            throw std::runtime_error("Mesh " + name + " has an index out of range!");
+        }
+    }
+
+    return header;
+}
+
+#endif //VULKANLEARNING_MESHFORMAT_H
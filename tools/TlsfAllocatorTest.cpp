@@ -0,0 +1,153 @@
+// Standalone test of the TLSF bookkeeping behind VulkanAllocator, no device needed:
+//   g++ -std=c++20 -O2 tools/TlsfAllocatorTest.cpp src/TlsfAllocator.cpp -o tlsf_test && ./tlsf_test
+#include "../src/TlsfAllocator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+    int Failures = 0;
+
+    void Check(const bool condition, const char *what) {
+        if (!condition) {
+            std::cerr << "FAILED: " << what << std::endl;
+            ++Failures;
+        }
+    }
+
+    struct Range
+    {
+        uint32_t node;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    bool Overlaps(const std::vector<Range> &ranges) {
+        auto sorted = ranges;
+        std::sort(sorted.begin(), sorted.end(), [](const Range &a, const Range &b) { return a.offset < b.offset; });
+        for (size_t i = 1; i < sorted.size(); ++i) {
+            if (sorted[i - 1].offset + sorted[i - 1].size > sorted[i].offset) return true;
+        }
+        return false;
+    }
+
+    void TestAlignment() {
+        TlsfAllocator allocator(1 << 20);
+        std::vector<Range> ranges;
+        for (uint64_t alignment = 1; alignment <= 4096; alignment *= 2) {
+            // an odd size first, so that the next offset is misaligned
+            for (const uint64_t size : {1ull, 3ull, 100ull, 777ull}) {
+                uint64_t offset;
+                const auto node = allocator.Allocate(size, alignment, offset);
+                Check(node != TlsfAllocator::InvalidNode, "aligned allocation succeeds");
+                Check(offset % alignment == 0, "offset is a multiple of the alignment");
+                Check(offset + size <= allocator.GetSize(), "allocation lies inside the range");
+                ranges.push_back({node, offset, size});
+            }
+        }
+        Check(!Overlaps(ranges), "aligned allocations do not overlap");
+
+        for (const auto &range : ranges) {
+            allocator.Free(range.node);
+        }
+        Check(allocator.IsEmpty(), "everything freed");
+        Check(allocator.GetLargestFreeRange() == allocator.GetSize(), "alignment padding merged back");
+    }
+
+    void TestSplitMerge() {
+        TlsfAllocator allocator(4096);
+        uint64_t a, b, c;
+        const auto nodeA = allocator.Allocate(1024, 1, a);
+        const auto nodeB = allocator.Allocate(1024, 1, b);
+        const auto nodeC = allocator.Allocate(1024, 1, c);
+        Check(nodeA != TlsfAllocator::InvalidNode && nodeB != TlsfAllocator::InvalidNode && nodeC != TlsfAllocator::InvalidNode,
+              "three allocations split the range");
+        Check(allocator.GetUsedSize() == 3072 && allocator.GetAllocationCount() == 3, "used size and count add up");
+
+        // a hole in the middle merges with neither neighbour, then with both
+        allocator.Free(nodeB);
+        Check(allocator.GetLargestFreeRange() == 1024, "the middle hole stays on its own");
+        allocator.Free(nodeA);
+        Check(allocator.GetLargestFreeRange() == 2048, "freeing the left neighbour merges with the hole");
+        allocator.Free(nodeC);
+        Check(allocator.IsEmpty() && allocator.GetUsedSize() == 0, "everything freed");
+        Check(allocator.GetLargestFreeRange() == 4096, "all ranges merged into one");
+
+        uint64_t offset;
+        const auto whole = allocator.Allocate(4096, 1, offset);
+        Check(whole != TlsfAllocator::InvalidNode && offset == 0, "the merged range holds the whole size again");
+        allocator.Free(whole);
+    }
+
+    void TestExhaustion() {
+        TlsfAllocator allocator(4096);
+        std::vector<uint32_t> nodes;
+        uint64_t offset;
+        for (auto node = allocator.Allocate(256, 1, offset); node != TlsfAllocator::InvalidNode; node = allocator.Allocate(256, 1, offset)) {
+            nodes.push_back(node);
+            if (nodes.size() > 16) break;
+        }
+        Check(nodes.size() == 16 && allocator.GetUsedSize() == 4096, "the range fills up exactly");
+        Check(allocator.GetLargestFreeRange() == 0, "nothing is left free");
+        Check(allocator.Allocate(1, 1, offset) == TlsfAllocator::InvalidNode, "an exhausted range refuses allocations");
+        Check(allocator.Allocate(8192, 1, offset) == TlsfAllocator::InvalidNode, "a request larger than the range fails");
+
+        allocator.Free(nodes.back());
+        nodes.pop_back();
+        const auto node = allocator.Allocate(128, 1, offset);
+        Check(node != TlsfAllocator::InvalidNode, "freed space is handed out again");
+        nodes.push_back(node);
+
+        for (const auto n : nodes) {
+            allocator.Free(n);
+        }
+        Check(allocator.IsEmpty() && allocator.GetLargestFreeRange() == 4096, "exhausted range recovers fully");
+    }
+
+    // random allocations and frees against a list of the live ranges
+    void TestRandom() {
+        TlsfAllocator allocator(1 << 24);
+        std::mt19937 random(1);
+        std::vector<Range> live;
+        for (int i = 0; i < 20000; ++i) {
+            if (live.empty() || random() % 3 != 0) {
+                const uint64_t size = 1 + random() % 65536;
+                const uint64_t alignment = 1ull << (random() % 13);
+                uint64_t offset;
+                const auto node = allocator.Allocate(size, alignment, offset);
+                if (node == TlsfAllocator::InvalidNode) continue;
+                Check(offset % alignment == 0 && offset + size <= allocator.GetSize(), "random allocation is aligned and inside");
+                live.push_back({node, offset, size});
+            } else {
+                const auto index = random() % live.size();
+                allocator.Free(live[index].node);
+                live[index] = live.back();
+                live.pop_back();
+            }
+        }
+        Check(!Overlaps(live), "random allocations do not overlap");
+        Check(allocator.GetAllocationCount() == live.size(), "allocation count matches");
+
+        for (const auto &range : live) {
+            allocator.Free(range.node);
+        }
+        Check(allocator.IsEmpty() && allocator.GetLargestFreeRange() == allocator.GetSize(), "random run merges back into one range");
+    }
+}
+
+int main() {
+    TestAlignment();
+    TestSplitMerge();
+    TestExhaustion();
+    TestRandom();
+
+    if (Failures > 0) {
+        std::cerr << Failures << " checks failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All TLSF allocator checks passed" << std::endl;
+    return EXIT_SUCCESS;
+}